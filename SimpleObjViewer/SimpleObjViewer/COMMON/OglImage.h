@@ -2,6 +2,10 @@
 
 #include "OglForMFC.h"
 #include "tqueue.h"
+#include "tmorphology.h"
+#include "tlabeling.h"
+#include "tvolume.h"
+#include "tsobel.h"
 
 
 enum OGL_IMAGE_CH
@@ -17,22 +21,6 @@ enum OGL_IMAGE_CH
 
 
 
-template<class T>
-void t_flipVolumeInZ(const int W, const int H, const int D, T* vol)
-{
-	const int WH = W*H;
-
-	T *tmp = new T[WH];
-
-	for (int z = 0; z < D / 2; ++z)
-	{
-		memcpy( tmp                 , &vol[ z       * WH ], sizeof( T ) * WH );
-		memcpy( &vol[ z       * WH ], &vol[ (D-1-z) * WH ], sizeof( T ) * WH );
-		memcpy( &vol[ (D-1-z) * WH ], tmp                 , sizeof( T ) * WH );
-	}
-	delete[] tmp;
-
-}
 
 
 
@@ -60,56 +48,55 @@ class OglImage3D
 {
 private:
 	GLuint m_oglName ;
-	EVec3i m_res     ;
 	bool   m_bUpdated;
-	GLubyte *m_vol;
+	TVolume<GLubyte> m_vol; //contiguous (no ghost / padding)
 
 public:
 
 
 	~OglImage3D()
 	{
-		if (m_vol) delete[] m_vol;
 	}
 
 
 	OglImage3D()
 	{
-		m_res = EVec3i(0,0,0);
-		m_vol = 0;
 		m_oglName = -1;
 		m_bUpdated = true;
 	}
 
-	OglImage3D(const OglImage3D &src)
+	//the texture on GPU is not shared/moved (it is regenerated at the next bindOgl)
+	OglImage3D(const OglImage3D &src) : m_vol(src.m_vol)
 	{
-		copy(src);
+		m_oglName = -1;
+		m_bUpdated = true;
+	}
+
+	OglImage3D(OglImage3D &&src) : m_vol(std::move(src.m_vol))
+	{
+		m_oglName = -1;
+		m_bUpdated = true;
+		src.m_bUpdated = true;
 	}
 
 	OglImage3D &operator=( const OglImage3D &src)
 	{
-		copy(src);
+		m_vol = src.m_vol;
+		m_bUpdated = true;
 		return *this;
 	}
 
-private:
-	void copy(const OglImage3D &src)
+	OglImage3D &operator=( OglImage3D &&src)
 	{
-		m_res = src.m_res;
-		if( src.m_vol )
-		{
-			int N = m_res[0] * m_res[1] * m_res[2];
-			m_vol = new GLubyte[N];
-			memcpy( m_vol, src.m_vol, sizeof( GLubyte ) * N );
-		}
+		m_vol = std::move(src.m_vol);
+		m_bUpdated = true;
+		src.m_bUpdated = true;
+		return *this;
 	}
 
-public:
 	void Allocate(const int W, const int H, const int D )
 	{
-		if (m_vol) delete[] m_vol;
-		m_res = EVec3i( W,H,D);
-		m_vol = new GLubyte[m_res[0] * m_res[1] * m_res[2]];
+		m_vol.Allocate( W, H, D );
 		m_bUpdated = true;
 	}
 
@@ -118,6 +105,26 @@ public:
 		Allocate( reso[0], reso[1], reso[2]); 
 	}
 
+	// copy a volume of any type (values are clamped to [0,255])
+	template<class T>
+	void Set(const TVolume<T> &v)
+	{
+		m_vol.Allocate( v.getRes() );
+		const int W = v.getW(), H = v.getH(), D = v.getD();
+#pragma omp parallel for 
+		for (int z = 0; z < D; ++z)
+			for (int y = 0; y < H; ++y)
+			{
+				const T *src = v.ptr(y, z);
+				GLubyte *dst = m_vol.ptr(y, z);
+				for (int x = 0; x < W; ++x) dst[x] = (GLubyte)( src[x] < 0 ? 0 : src[x] > 255 ? 255 : src[x] );
+			}
+		m_bUpdated = true;
+	}
+
+	TVolume<GLubyte>       &getVolume()       { return m_vol; }
+	const TVolume<GLubyte> &getVolume() const { return m_vol; }
+
 
 	
 
@@ -136,7 +143,7 @@ public:
 			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 			glGenTextures(1, &m_oglName);
 			glBindTexture(GL_TEXTURE_3D, m_oglName);
-			glTexImage3D (GL_TEXTURE_3D, 0, GL_LUMINANCE8, m_res[0], m_res[1], m_res[2], 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, m_vol );
+			glTexImage3D (GL_TEXTURE_3D, 0, GL_LUMINANCE8, getW(), getH(), getD(), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, m_vol.data() );
 		}
 		else
 		{
@@ -167,13 +174,13 @@ public:
 
 
 
-	// should be allocated & the size of v is samge as m_res
+	// should be allocated & the size of v is samge as the volume
 	void SetValue(const float* v, const float minV, const float maxV)
 	{
-		if ( m_vol == 0 ) return;
+		if ( m_vol.isEmpty() ) return;
 
 		float rate = 255.0f / (maxV - minV);
-		int N = m_res[0] * m_res[1] * m_res[2];
+		int N = (int)m_vol.getNum();
 
 #pragma omp parallel for 
 		for (int i = 0; i < N; ++i) m_vol[i] = (byte)max(0, min(255, (v[i] - minV) * rate));
@@ -183,12 +190,12 @@ public:
 
 	void SetValue(float** slices, const float minV, const float maxV)
 	{
-		if (m_vol == 0) return;
+		if (m_vol.isEmpty()) return;
 
 		float rate = 255.0f / (maxV - minV);
-		int WH = m_res[0] * m_res[1];
+		int WH = getW() * getH();
 		
-		for (int z = 0; z < m_res[2]; ++z)
+		for (int z = 0; z < getD(); ++z)
 		{
 			for (int i = 0; i < WH; ++i)
 			{
@@ -201,7 +208,7 @@ public:
 
 	void SetAllZero()
 	{
-		memset(m_vol, 0, sizeof(GLubyte) * m_res[0] * m_res[1] * m_res[2]);
+		m_vol.Fill(0);
 		m_bUpdated = true;
 	}
 
@@ -210,137 +217,118 @@ public:
 
 	inline GLubyte getV(const int x, const int y, const int z) const
 	{
-		return m_vol[ x + y * m_res[0] + z * m_res[0] * m_res[1] ];
+		return m_vol.at(x, y, z);
 	}
 
-	inline GLubyte setV(const int x, const int y, const int z, GLubyte v)
+	inline void setV(const int x, const int y, const int z, GLubyte v)
 	{
-		m_vol[x + y * m_res[0] + z * m_res[0] * m_res[1]] = v;
+		m_vol.at(x, y, z) = v;
 		m_bUpdated = true;
 	}
 
 	inline void setUpdated() { m_bUpdated = true; }
 
-	const int getW() { return m_res[0]; }
-	const int getH() { return m_res[1]; }
-	const int getD() { return m_res[2]; }
+	const int getW() const { return m_vol.getW(); }
+	const int getH() const { return m_vol.getH(); }
+	const int getD() const { return m_vol.getD(); }
 
 	void flipVolumeInZ() {
-		t_flipVolumeInZ<byte>( m_res[0],m_res[1],m_res[2], m_vol);
+		t_flipVolumeInZ<GLubyte>( m_vol );
+		m_bUpdated = true;
 	}
 };
 
 
 
 //voxel value 0:never change, 1:background, 255:foreground
+//(morphology is computed on the TVolume, see tmorphology.h)
 inline void t_morpho3D_erode(OglImage3D &v)
 {
-	const int W = v.getW();
-	const int H = v.getH();
-	const int D = v.getD();
-	const int WH = W*H, WHD = W*H*D;
-
-#pragma omp parallel for 
-	for (int z = 0; z < D; ++z)
-		for (int y = 0; y < H; ++y)
-			for (int x = 0; x < W; ++x)
-			{
-				int idx = x + y * W + z*WH;
-				if (v[idx] != 255) continue;
-
-				if (x == 0 || y == 0 || z == 0 || x == W - 1 || y == H - 1 || z == D - 1 ||
-					v[idx - 1] == 1 || v[idx - W] == 1 || v[idx - WH] == 1 ||
-					v[idx + 1] == 1 || v[idx + W] == 1 || v[idx + WH] == 1) v[idx] = 2;
-			}
-
-#pragma omp parallel for 
-	for (int i = 0; i < WHD; ++i) if (v[i] == 2) v[i] = 1;
+	t_morpho3D_erode( v.getVolume() );
+	v.setUpdated();
+}
 
+inline void t_morpho3D_dilate( OglImage3D &v )
+{
+	t_morpho3D_dilate( v.getVolume() );
 	v.setUpdated();
 }
 
+inline void t_morpho3D_erode(OglImage3D &v, const int r, const TMorphoSE se)
+{
+	t_morpho3D_erode( v.getVolume(), r, se );
+	v.setUpdated();
+}
 
+inline void t_morpho3D_dilate(OglImage3D &v, const int r, const TMorphoSE se)
+{
+	t_morpho3D_dilate( v.getVolume(), r, se );
+	v.setUpdated();
+}
 
-//voxel value 0:never cahnge, 1:background, 255:foreground
-inline void t_morpho3D_dilate( OglImage3D &v )
+inline void t_morpho3D_open(OglImage3D &v, const int r, const TMorphoSE se)
 {
-	const int W = v.getW();
-	const int H = v.getH();
-	const int D = v.getD();
-	const int WH = W*H, WHD = W*H*D;
+	t_morpho3D_open( v.getVolume(), r, se );
+	v.setUpdated();
+}
 
-#pragma omp parallel for 
-	for (int z = 0; z < D; ++z)
-		for (int y = 0; y < H; ++y)
-			for (int x = 0; x < W; ++x)
-			{
-				int idx = x + y * W + z*WH;
-				if (v[idx] != 1) continue;
+inline void t_morpho3D_close(OglImage3D &v, const int r, const TMorphoSE se)
+{
+	t_morpho3D_close( v.getVolume(), r, se );
+	v.setUpdated();
+}
 
-				if ( (x > 0  && v[idx - 1] == 255) || (y > 0  && v[idx - W] == 255) || (z > 0  && v[idx - WH] == 255) || 
-					 (x <W-1 && v[idx + 1] == 255) || (y <H-1 && v[idx + W] == 255) || (z <D-1 && v[idx + WH] == 255) ) v[idx] = 2;
-			}
 
-#pragma omp parallel for 
-	for (int i = 0; i < WHD; ++i) if (v[i] == 2) v[i] = 255;
 
+//voxel value 0: background, 255:foreground
+inline void t_morpho3D_FillHole(OglImage3D &v)
+{
+	t_morpho3D_FillHole( v.getVolume() );
 	v.setUpdated();
 }
 
 
 
+//voxel value 255:foreground, others:background
+//label : 0 for background, 1..N for components (connectivity 6, 18, or 26)
+inline int t_morpho3D_Labeling(OglImage3D &v, const int connectivity, int *label, vector<TComponent3D> &comps)
+{
+	return t_labeling3D( v.getW(), v.getH(), v.getD(), v.getVolume().data(), [](const GLubyte a){ return a == 255; }, connectivity, label, comps);
+}
 
-//voxel value 0: background, 255:foreground
-inline void t_morpho3D_FillHole(OglImage3D &v)
+
+
+//voxel value 255:foreground, others:background
+//foreground components other than the largest "keepLargestN" (<=0 : no limit)
+//or smaller than "minVoxNum" voxels are set to "bgValue"
+//return number of remaining components
+inline int t_morpho3D_RemoveIslands(OglImage3D &v, const int connectivity, const int keepLargestN, const int minVoxNum, const GLubyte bgValue = 0)
 {
 	const int W = v.getW();
 	const int H = v.getH();
 	const int D = v.getD();
-	const int WH = W*H, WHD = W*H*D;
-
-	//(x,y,z,x+y*W+z*WH)
-	TQueue<EVec4i> Q( WHD / 10);
+	const int WHD = W*H*D;
 
-	for (int x = 0; x < W; ++x) for (int y = 0; y < H; ++y)
-	{
-		if (v[x + y * W +  0  *WH] == 0)  Q.push_back(EVec4i(x, y, 0  , x + y * W +  0   *WH));
-		if (v[x + y * W +(D-1)*WH] == 0)  Q.push_back(EVec4i(x, y, D-1, x + y * W + (D-1)*WH));
-	}
-	for (int y = 0; y < H; ++y) for (int z = 0; z < D; ++z)
-	{
-		if (v[  0  + y * W + z*WH] == 0)  Q.push_back(EVec4i( 0 , y, z,   0   + y * W + z*WH));
-		if (v[(W-1)+ y * W + z*WH] == 0)  Q.push_back(EVec4i(W-1, y, z, (W-1) + y * W + z*WH));
-	}
-	for (int z = 0; z < D; ++z) for (int x = 0; x < W; ++x)
-	{
-		if (v[x +   0  * W + z*WH] == 0)  Q.push_back(EVec4i(x, 0  , z, x +   0  * W + z*WH));
-		if (v[x + (H-1)* W + z*WH] == 0)  Q.push_back(EVec4i(x, H-1, z, x + (H-1)* W + z*WH));
-	}
-	
-	for (int i = 0; i < Q.size(); ++i) v[Q[i][3]] = 2;
-	
+	int *label = new int[WHD];
+	vector<TComponent3D> comps;
+	t_morpho3D_Labeling( v, connectivity, label, comps);
+	const int N = t_labeling3D_Filter( W, H, D, label, comps, keepLargestN, minVoxNum);
 
+#pragma omp parallel for 
+	for (int i = 0; i < WHD; ++i) if (v[i] == 255 && label[i] == 0) v[i] = bgValue;
 
-	//region growing for background
-	while (!Q.empty())
-	{
-		const int x = Q.front()[0];
-		const int y = Q.front()[1];
-		const int z = Q.front()[2];
-		const int I = Q.front()[3];
-		Q.pop_front();
+	delete[] label;
+	v.setUpdated();
+	return N;
+}
 
-		if (x != 0     && !v[I - 1 ]) { v[I - 1 ] = 2;  Q.push_back(EVec4i(x - 1, y, z, I - 1 )); }
-		if (x != W - 1 && !v[I + 1 ]) { v[I + 1 ] = 2;  Q.push_back(EVec4i(x + 1, y, z, I + 1 )); }
-		if (y != 0     && !v[I - W ]) { v[I - W ] = 2;  Q.push_back(EVec4i(x, y - 1, z, I - W )); }
-		if (y != H - 1 && !v[I + W ]) { v[I + W ] = 2;  Q.push_back(EVec4i(x, y + 1, z, I + W )); }
-		if (z != 0     && !v[I - WH]) { v[I - WH] = 2;  Q.push_back(EVec4i(x, y, z - 1, I - WH)); }
-		if (z != D - 1 && !v[I + WH]) { v[I + WH] = 2;  Q.push_back(EVec4i(x, y, z + 1, I + WH)); }
-	}
 
-	for (int i = 0; i < WHD; ++i) v[i] = (v[i] == 2) ? 0 : 255;
 
-	v.setUpdated();
+//voxel value 255:inside, others:outside
+//sd : signed distance (negative inside) with voxel pitch, see tdistancetransform.h
+inline void t_morpho3D_SignedDistance(const OglImage3D &v, const EVec3f &pitch, TVolume<float> &sd)
+{
+	t_signedDistance3D( v.getVolume(), [](const GLubyte a){ return a == 255; }, pitch, sd);
 }
 
 
@@ -351,6 +339,7 @@ inline void t_morpho3D_FillHole(OglImage3D &v)
 
 
 
+
 //2D image 
 template <OGL_IMAGE_CH CH>
 class OglImage2D
@@ -737,64 +726,3 @@ typedef OglImage2D<CH_INTES> OGLImage2D1;
 
 
 
-
-
-template<class T>
-void t_sobel3D(const int W, const int H, const int D, const T* vol, T* res)
-{
-	const T sblX[3][3][3]={ { {-1,  0, +1},
-							  {-2,  0, +2},
-							  {-1,  0, +1} }, { {-2,  0,  2},
-												{-4,  0,  4},
-												{-2,  0,  2} }, { {-1,  0,  1},
-																  {-2,  0,  2}, 
-																  {-1,  0,  1}} };
-	static T sblY[3][3][3]={ {{-1, -2, -1},
-							  { 0,  0,  0},
-							  { 1,  2,  1}},   {{-2, -4, -2},
-												{ 0,  0,  0},
-												{ 2,  4,  2}},  {{-1, -2, -1},
-																{ 0,  0,  0},
-																{ 1,  2,  1}} };
-	static T sblZ[3][3][3]={ {{-1, -2, -1},
-							  {-2, -4, -2},
-							  {-1, -2, -1}},   {{ 0,  0,  0},
-								  				{ 0,  0,  0},
-												{ 0,  0,  0}}, {{ 1,  2,  1},
-																{ 2,  4,  2},
-																{ 1,  2,  1}} };
-
-	const int WH = W*H, WHD = WH*D;
-
-#pragma omp parallel for
-	for (int i = 0; i < WHD; ++i)
-	{
-		const int z = (i                 ) / WH;
-		const int y = (i - z * WH        ) / W ;
-		const int x = (i - z * WH - y * W);
-
-		T gx = 0, gy = 0, gz = 0;
-
-		for( int zz=-1; zz < 2; ++zz) if( 0<=z+zz && z+zz<D)
-		for( int yy=-1; yy < 2; ++yy) if( 0<=y+yy && y+yy<H)
-		for( int xx=-1; xx < 2; ++xx) if( 0<=x+xx && x+xx<W)
-		{
-			int I = i + xx + yy*W + zz*WH;
-			gx += sblX[zz+1][yy+1][xx+1] * vol[ I ];
-			gy += sblY[zz+1][yy+1][xx+1] * vol[ I ];
-			gz += sblZ[zz+1][yy+1][xx+1] * vol[ I ];
-		}
-
-		//for boundary voxels
-		if( x==0 || x==W-1) gx = 0; 
-		if( y==0 || y==H-1) gy = 0; 
-		if( z==0 || z==D-1) gz = 0; 
-		res[i] = (T)sqrt( (double)gx * gx + gy * gy + gz * gz) / 16.0f;
-
-		if( res[i] > 40000) fprintf( stderr, "%d %d %d\n",x,y,z);
-	}
-
-}
-
-
-
@@ -1,8 +1,11 @@
 #include "stdafx.h"
 
+#ifndef TMESH_NO_GL
 #include "OglForMFC.h"
+#endif
 #include "expmap.h"
 #include "tqueue.h"
+#include "tprofile.h"
 
 #include <map>
 
@@ -14,27 +17,15 @@ static Eigen::AngleAxisf calcRotV1toV2
 	const EVec3f &v2  //should be normalized
 )
 {
-	EVec3f axis = v1.cross( v2 ).normalized();
-	float theta = acos(v1.dot(v2));
-	return Eigen::AngleAxisf( theta, axis );
-}
-
+	EVec3f axis = v1.cross( v2 );
+	float  len  = axis.norm();
+	if( len < 1e-12f ) return Eigen::AngleAxisf( 0, EVec3f(1,0,0) ); //parallel (rotation by pi is never needed for neighboring normals)
 
-static void Trace(const EVec3f p)
-{
-fprintf( stderr, "%f %f %f\n", p[0], p[1], p[2]);
+	float theta = acos( max(-1.0f, min(1.0f, v1.dot(v2))) );
+	return Eigen::AngleAxisf( theta, axis / len );
 }
 
 
-static void Trace(const EVec2f p)
-{
-fprintf( stderr, "%f %f \n", p[0], p[1]);
-}
-
-
-
-
-
 //compute u_q in Tp
 static EVec2f calcPosInNormalCoord
 (
@@ -47,7 +38,9 @@ static EVec2f calcPosInNormalCoord
 {
 	EVec3f v   =  q - coordO;
 	float len  = v.norm();
-	EVec3f dir = (v - v.dot( coordN ) * coordN).normalized();
+	EVec3f dir = (v - v.dot( coordN ) * coordN);
+	if( dir.norm() < 1e-20f ) return EVec2f(0,0); //q == coordO (or along the normal)
+	dir.normalize();
 
 	v = len * dir; 
 
@@ -55,39 +48,160 @@ static EVec2f calcPosInNormalCoord
 }
 
 
-void expnentialMapping
+//TMesh seen through the accessors of TCompactMesh, so that one implementation of
+//the growth serves both representations
+class TMeshAccess
+{
+	const TMesh &m_mesh;
+public:
+	TMeshAccess(const TMesh &mesh) : m_mesh(mesh) {}
+
+	inline const EVec3f &getVert    (const int i) const { return m_mesh.m_vVerts[i]; }
+	inline const EVec3f &getNorm    (const int i) const { return m_mesh.m_vNorms[i]; }
+	inline const EVec3f &getPolyNorm(const int p) const { return m_mesh.m_pNorms[p]; }
+	inline const int    *getPoly    (const int p) const { return m_mesh.m_pPolys[p].idx; }
+	inline const int    *ringBegin  (const int i) const { return m_mesh.m_vRingVs[i].data(); }
+	inline const int    *ringEnd    (const int i) const { return m_mesh.m_vRingVs[i].data() + m_mesh.m_vRingVs[i].size(); }
+};
+
+
+
+//a chunk of a TChunkedMesh could not be read : the growth stops (the other meshes never fail)
+template<class MESH>
+static inline bool t_readFailed(const MESH &)             { return false; }
+static inline bool t_readFailed(const TChunkedMesh &mesh) { return mesh.isReadFailed(); }
+
+
+
+//growth state in a vector<ExpMapVtx> or an ExpMapPaged
+template<class MAP>
+class TExpMapVtxState
+{
+	MAP &m_map;
+public:
+	TExpMapVtxState(MAP &map) : m_map(map) {}
+
+	inline unsigned char flg (const int i) { return m_map[i].flg ; }
+	inline float         dist(const int i) { return m_map[i].dist; }
+	inline EVec2f        pos (const int i) { return m_map[i].pos ; }
+	inline void Fix(const int i) { m_map[i].flg = 2; }
+	inline void Set(const int i, unsigned char flg, int from, float d)              { m_map[i].Set(flg, from, d     ); }
+	inline void Set(const int i, unsigned char flg, int from, float d, EVec2f &pos) { m_map[i].Set(flg, from, d, pos); }
+};
+
+
+
+//growth state for TCompactMesh : float distance and flag per vertex (5 byte), with positions a slot index (+4 byte).
+//the float position is kept only for the vertices in Q, in slots that are reused once the vertex is fixed
+//(a fixed vertex gets its half float position in the result). the path (from) is not kept
+class TCompactState
+{
+	vector<float>         m_dist;
+	vector<unsigned char> m_flg ;
+	vector<int>           m_slot; //slot of m_qPos of a vertex in Q, -1 otherwise
+	vector<EVec2f>        m_qPos;
+	vector<int>           m_free; //released slots
+	ExpMapCompact        &m_res ;
+	const bool            m_bPos;
+
+public:
+	TCompactState(const int vSize, const bool bPos, ExpMapCompact &res) : m_dist(vSize, FLT_MAX), m_flg(vSize, 0), m_res(res), m_bPos(bPos)
+	{
+		if (m_bPos) m_slot.assign(vSize, -1);
+		m_res.m_pos.assign(2 * (size_t)vSize, 0); //half float 0
+		m_res.m_dist.clear();
+		m_res.m_dist.shrink_to_fit();
+	}
+
+	inline unsigned char flg (const int i) const { return m_flg [i]; }
+	inline float         dist(const int i) const { return m_dist[i]; }
+	inline EVec2f        pos (const int i) const { return m_qPos[m_slot[i]]; }
+
+	inline void Set(const int i, unsigned char flg, int, float d) { m_flg[i] = flg; m_dist[i] = d; }
+	inline void Set(const int i, unsigned char flg, int, float d, EVec2f &pos)
+	{
+		m_flg[i] = flg;
+		m_dist[i] = d;
+		int &s = m_slot[i];
+		if (s < 0)
+		{
+			if (m_free.empty()) { s = (int)m_qPos.size(); m_qPos.push_back(pos); return; }
+			s = m_free.back();
+			m_free.pop_back();
+		}
+		m_qPos[s] = pos;
+	}
+
+	inline void Fix(const int i)
+	{
+		m_flg[i] = 2;
+		if (!m_bPos) return;
+		const int s = m_slot[i];
+		m_res.m_pos[2 * i    ] = t_floatToHalf(m_qPos[s][0]);
+		m_res.m_pos[2 * i + 1] = t_floatToHalf(m_qPos[s][1]);
+		m_free.push_back(s);
+		m_slot[i] = -1;
+	}
+
+	//quantized distances into the result (as ExpMapCompact::Set), the working arrays are released
+	void Finish()
+	{
+		const int vSize = (int)m_dist.size();
+		float dMax = 0;
+		for (int i = 0; i < vSize; ++i) if (m_flg[i] == 2) dMax = max(dMax, m_dist[i]);
+		m_res.m_dStep = (dMax > 0) ? dMax / 65534.0f : 1.0f;
+		const float inv = 1.0f / m_res.m_dStep;
+
+		m_res.m_dist.resize(vSize);
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+			m_res.m_dist[i] = (m_flg[i] == 2) ? (unsigned short)min(65534.0f, floor(m_dist[i] * inv + 0.5f)) : (unsigned short)0xFFFF;
+
+		vector<float>        ().swap(m_dist);
+		vector<unsigned char>().swap(m_flg );
+		vector<int>          ().swap(m_slot);
+		vector<EVec2f>       ().swap(m_qPos);
+		vector<int>          ().swap(m_free);
+	}
+};
+
+
+
+
+//MESH  : TMeshAccess, TCompactMesh or TChunkedMesh
+//STATE : TExpMapVtxState or TCompactState, initialized (flg:0, dist:Inf, from:-2) by the caller
+//the growth stops when the distance of the next pivot exceeds maxDist, when cancel is canceled or when a chunk read failed
+template<class MESH, class STATE>
+static void t_expnentialMapping
 (
-	const TMesh  &mesh,
+	const MESH   &mesh,
 	const EVec3f &startP,
 	const int    &polyIdx,
-	vector<ExpMapVtx> &expMap
+	const float   maxDist,
+	STATE        &expMap,
+	const TCancelToken *cancel
 )
 {
-	fprintf( stderr, "start...   \n");
-
-	const EVec3f *verts = mesh.m_vVerts;
-	const TPoly  *polys = mesh.m_pPolys;
+	long long nPush = 0, nDecrease = 0, nSettled = 0;
 
 	//initialization (flg:0, dist:Inf, from:-2)
 	EVec3f Xdir(1,0,0);
-	const EVec3f baseN  = mesh.m_pNorms[polyIdx];
+	const EVec3f baseN  = mesh.getPolyNorm(polyIdx);
 	const EVec3f baseX  = (Xdir - Xdir.dot(baseN)*baseN).normalized(); //(verts[polys[polyIdx].idx[0]] - startP).normalized();
 	const EVec3f baseY  = Eigen::AngleAxisf((float)M_PI * 0.5f, baseN ) * baseX;
-	
-	expMap.clear();
-	expMap.resize(mesh.m_vSize);
 
 	multimap<float,int> Q; 
 	
 	for (int i = 0; i < 3; ++i)
 	{
-		int vIdx = polys[polyIdx].idx[i];
+		int vIdx = mesh.getPoly(polyIdx)[i];
 
-		EVec2f u2D = calcPosInNormalCoord( startP, baseN, baseX, baseY, verts[vIdx]);
+		EVec2f u2D = calcPosInNormalCoord( startP, baseN, baseX, baseY, mesh.getVert(vIdx));
 		float d = u2D.norm();
 
 		Q.insert( make_pair(d, vIdx) );
-		expMap[vIdx].Set( 1, -1, d, u2D);
+		++nPush;
+		expMap.Set( vIdx, 1, -1, d, u2D);
 	}
 
 
@@ -98,16 +212,25 @@ void expnentialMapping
 	{
 		//pivot vertex
 		int   pivI = Q.begin()->second;
+		if( expMap.dist(pivI) > maxDist ) break;
+		if( cancel && (nSettled & 4095) == 0 && cancel->isCanceled() ) break;
+		if( t_readFailed(mesh) ) break;
 		Q.erase( Q.begin () );
-
-		vector<int> &Nei = mesh.m_vRingVs[pivI];
-
-		EVec3f localO  =  verts[pivI];
-		EVec3f tmp     =  verts[Nei[0]] - localO;
-		EVec3f localN  =  mesh.m_vNorms[pivI];
+		++nSettled;
+		const float  pivD   = expMap.dist(pivI);
+		const EVec2f pivPos = expMap.pos (pivI);
+
+		//a ring whose chunk failed to read is an empty placeholder : stop before dereferencing it
+		const int *neiB = mesh.ringBegin(pivI), *neiE = mesh.ringEnd(pivI);
+		if( t_readFailed(mesh) ) break;
+		if( neiB == neiE ) { expMap.Fix(pivI); continue; }
+
+		EVec3f localO  =  mesh.getVert(pivI);
+		EVec3f tmp     =  mesh.getVert(*neiB) - localO;
+		EVec3f localN  =  mesh.getNorm(pivI);
 		EVec3f localX  =  (tmp - tmp.dot(localN) * localN ).normalized();
 		EVec3f localY  =  Eigen::AngleAxisf((float)M_PI * 0.5f, localN ) * localX;
-		expMap[pivI].flg = 2;
+		expMap.Fix(pivI);
 
 		//compute coordinate transformation
 		Eigen::AngleAxisf localToBase = calcRotV1toV2( localN, baseN);
@@ -116,48 +239,53 @@ void expnentialMapping
 		//EVec3f localY_rot = localToBase * localY;
 
 
-		float theta = acos(localX_rot.dot(baseX) );
+		float theta = acos( max(-1.0f, min(1.0f, localX_rot.dot(baseX))) );
 		if( localX_rot.cross( baseX ).dot( baseN ) < 0 ) theta *= -1;
 		Eigen::Rotation2Df R2d( -theta );
 
-		for (const auto& vi : Nei ) 
+		for (const int *nei = neiB; nei != neiE; ++nei)
 		{
-			if( expMap[vi].flg == 2 ) continue;
+			const int vi = *nei;
+			if( expMap.flg(vi) == 2 ) continue;
 
 			//Dijikstra@̋́Agraphedge length𗘗piԂ_͂ŏĂBj
-			float d = expMap[pivI].dist + (localO - verts[vi]).norm();
+			float d = pivD + (localO - mesh.getVert(vi)).norm();
 
 			//new coordinate on Tp
-			EVec2f u2D = expMap[pivI].pos + R2d * calcPosInNormalCoord( localO, localN, localX, localY, verts[vi]);
+			EVec2f u2D = pivPos + R2d * calcPosInNormalCoord( localO, localN, localX, localY, mesh.getVert(vi));
 		
 
-			if(      expMap[vi].flg == 1 && d < expMap[vi].dist )
+			if(      expMap.flg(vi) == 1 && d < expMap.dist(vi) )
 			{
 				//objects in multimap may share the same key 
 				multimap<float,int>::iterator it;
-				for( it = Q.find(expMap[vi].dist); it != Q.end(); ++it) if( it->second == vi ) break;
+				for( it = Q.find(expMap.dist(vi)); it != Q.end(); ++it) if( it->second == vi ) break;
 
 				if (it == Q.end())
 				{
-					fprintf( stderr, "never comes here");
-					expMap[vi].Set( 1, pivI, d, u2D);
+					TPROF_LOG("never comes here\n");
+					expMap.Set( vi, 1, pivI, d, u2D);
 				}
 				else
 				{
 					//remove and re-add this neighbor vtx from&to Q
 					Q.erase( it );
-					expMap[vi].Set( 1, pivI, d, u2D);
+					expMap.Set( vi, 1, pivI, d, u2D);
 					Q.insert( make_pair(d, vi) );
+					++nDecrease;
 				}
 			}
-			else if (expMap[vi].flg  == 0)
+			else if (expMap.flg(vi)  == 0)
 			{
-				expMap[vi].Set( 1, pivI, d, u2D);
+				expMap.Set( vi, 1, pivI, d, u2D);
 				Q.insert( make_pair(d, vi) );
+				++nPush;
 			}
 		}
 	}
-	fprintf( stderr, "done...\n");
+	TPROF_COUNT(PROF_HEAP_PUSH    , nPush    );
+	TPROF_COUNT(PROF_HEAP_DECREASE, nDecrease);
+	TPROF_COUNT(PROF_VERTS_SETTLED, nSettled );
 }
 
 
@@ -276,20 +404,39 @@ void expnentialMapping
 
 
 
-void DijikstraMapping
+void expMapFacesInRadius
 (
-	const TMesh  &mesh,
-	const EVec3f &startP,
-	const int    &polyIdx,
-	vector<ExpMapVtx> &expMap
+	const TMesh             &mesh  ,
+	const vector<ExpMapVtx> &expMap,
+	const float              radius,
+	vector<int>             &faces
 )
 {
-	fprintf( stderr, "start...\n");
+	faces.clear();
+	for (int i = 0; i < mesh.m_pSize; ++i)
+	{
+		const int *idx = mesh.m_pPolys[i].idx;
+		bool bIn = true;
+		for (int k = 0; k < 3 && bIn; ++k) bIn = expMap[idx[k]].flg == 2 && expMap[idx[k]].pos.norm() <= radius;
+		if (bIn) faces.push_back(i);
+	}
+}
 
-	const int vSize = mesh.m_vSize;
 
-	expMap.clear();
-	expMap.resize(vSize);
+
+
+template<class MESH, class STATE>
+static void t_DijikstraMapping
+(
+	const MESH   &mesh,
+	const EVec3f &startP,
+	const int    &polyIdx,
+	const float   maxDist,
+	STATE        &expMap,
+	const TCancelToken *cancel
+)
+{
+	long long nPush = 0, nDecrease = 0, nSettled = 0;
 
 	multimap<float,int> Q; //(dist from startP, vertex idx)
 
@@ -297,57 +444,71 @@ void DijikstraMapping
 
 	for (int i = 0; i < 3; ++i)
 	{
-		int vIdx = mesh.m_pPolys[polyIdx].idx[i];
+		int vIdx = mesh.getPoly(polyIdx)[i];
 
-		float d = (startP - mesh.m_vVerts[vIdx]).norm();
-		expMap[vIdx].Set( 1, -1, d);
+		float d = (startP - mesh.getVert(vIdx)).norm();
+		expMap.Set( vIdx, 1, -1, d);
 		Q.insert( make_pair(d, vIdx) );
+		++nPush;
 	}
 
 
 	while (!Q.empty())
 	{
 		int   pivI = Q.begin()->second;
+		if( expMap.dist(pivI) > maxDist ) break;
+		if( cancel && (nSettled & 4095) == 0 && cancel->isCanceled() ) break;
+		if( t_readFailed(mesh) ) break;
 		
 		//fix piv
 		Q.erase( Q.begin () );
-		expMap[pivI].flg = 2;
+		++nSettled;
+		const float pivD = expMap.dist(pivI);
+		expMap.Fix(pivI);
 
 
-		for (const auto& vi : mesh.m_vRingVs[pivI]) 
+		const EVec3f pivP = mesh.getVert(pivI);
+		const int *neiB = mesh.ringBegin(pivI), *neiE = mesh.ringEnd(pivI);
+		if( t_readFailed(mesh) ) break;
+		for (const int *nei = neiB; nei != neiE; ++nei)
 		{
-			if( expMap[vi].flg == 2 ) continue;
+			const int vi = *nei;
+			if( expMap.flg(vi) == 2 ) continue;
 
-			float d = (mesh.m_vVerts[vi] - mesh.m_vVerts[pivI]).norm() + expMap[pivI].dist;
+			float d = (mesh.getVert(vi) - pivP).norm() + pivD;
 
-			if(      expMap[vi].flg == 1 && d < expMap[vi].dist )
+			if(      expMap.flg(vi) == 1 && d < expMap.dist(vi) )
 			{
 				//objects in multimap may share the same key 
 				multimap<float,int>::iterator it;
-				for( it = Q.find(expMap[vi].dist); it != Q.end(); ++it) if( it->second == vi ) break;
+				for( it = Q.find(expMap.dist(vi)); it != Q.end(); ++it) if( it->second == vi ) break;
 
 				if (it == Q.end())
 				{
-					fprintf( stderr, "never comes here");
-					expMap[vi].Set( 1, pivI, d);
+					TPROF_LOG("never comes here\n");
+					expMap.Set( vi, 1, pivI, d);
 				}
 				else
 				{
 					//remove and re-add this neighbor vtx from&to Q
 					Q.erase( it );
-					expMap[vi].Set( 1, pivI, d);
+					expMap.Set( vi, 1, pivI, d);
 					Q.insert( make_pair(d, vi) );
+					++nDecrease;
 				}
 			}
-			else if (expMap[vi].flg  == 0)
+			else if (expMap.flg(vi)  == 0)
 			{
-				expMap[vi].Set( 1, pivI, d);
+				expMap.Set( vi, 1, pivI, d);
 				Q.insert( make_pair(d, vi) );
+				++nPush;
 			}
 		}
 	}
 
-	fprintf( stderr, "done...\n");
+	TPROF_COUNT(PROF_HEAP_PUSH    , nPush    );
+	TPROF_COUNT(PROF_HEAP_DECREASE, nDecrease);
+	TPROF_COUNT(PROF_VERTS_SETTLED, nSettled );
 
 }
 
@@ -384,4 +545,135 @@ void DijikstraMapping
 
 
 
-*/
\ No newline at end of file
+*/
+
+
+
+
+void DijikstraMapping
+(
+	const TMesh  &mesh,
+	const EVec3f &startP,
+	const int    &polyIdx,
+	const float   maxDist,
+	vector<ExpMapVtx> &expMap,
+	const TCancelToken *cancel
+)
+{
+	TPROF_SCOPE("DijikstraMapping");
+	expMap.clear();
+	expMap.resize(mesh.m_vSize);
+	TExpMapVtxState<vector<ExpMapVtx>> state(expMap);
+	t_DijikstraMapping( TMeshAccess(mesh), startP, polyIdx, maxDist, state, cancel);
+}
+
+void DijikstraMapping
+(
+	const TMesh  &mesh,
+	const EVec3f &startP,
+	const int    &polyIdx,
+	vector<ExpMapVtx> &expMap
+)
+{
+	DijikstraMapping( mesh, startP, polyIdx, FLT_MAX, expMap);
+}
+
+
+
+void expnentialMapping
+(
+	const TMesh  &mesh,
+	const EVec3f &startP,
+	const int    &polyIdx,
+	const float   maxDist,
+	vector<ExpMapVtx> &expMap,
+	const TCancelToken *cancel
+)
+{
+	TPROF_SCOPE("expnentialMapping");
+	expMap.clear();
+	expMap.resize(mesh.m_vSize);
+	TExpMapVtxState<vector<ExpMapVtx>> state(expMap);
+	t_expnentialMapping( TMeshAccess(mesh), startP, polyIdx, maxDist, state, cancel);
+}
+
+void expnentialMapping
+(
+	const TMesh  &mesh,
+	const EVec3f &startP,
+	const int    &polyIdx,
+	vector<ExpMapVtx> &expMap
+)
+{
+	expnentialMapping( mesh, startP, polyIdx, FLT_MAX, expMap);
+}
+
+
+
+void DijikstraMapping
+(
+	const TCompactMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	ExpMapCompact      &expMap
+)
+{
+	TPROF_SCOPE("DijikstraMapping(compact)");
+	TCompactState state(mesh.m_vSize, false, expMap);
+	t_DijikstraMapping( mesh, startP, polyIdx, FLT_MAX, state, 0);
+	state.Finish();
+}
+
+
+
+void expnentialMapping
+(
+	const TCompactMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	ExpMapCompact      &expMap
+)
+{
+	TPROF_SCOPE("expnentialMapping(compact)");
+	TCompactState state(mesh.m_vSize, true, expMap);
+	t_expnentialMapping( mesh, startP, polyIdx, FLT_MAX, state, 0);
+	state.Finish();
+}
+
+
+
+bool DijikstraMapping
+(
+	const TChunkedMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	ExpMapPaged        &expMap
+)
+{
+	TPROF_SCOPE("DijikstraMapping(chunked)");
+	mesh.resetReadError();
+	expMap.Init(mesh.m_vSize, mesh.m_chunkBits);
+	TExpMapVtxState<ExpMapPaged> state(expMap);
+	t_DijikstraMapping( mesh, startP, polyIdx, maxDist, state, 0);
+	return !mesh.isReadFailed();
+}
+
+
+
+bool expnentialMapping
+(
+	const TChunkedMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	ExpMapPaged        &expMap
+)
+{
+	TPROF_SCOPE("expnentialMapping(chunked)");
+	mesh.resetReadError();
+	expMap.Init(mesh.m_vSize, mesh.m_chunkBits);
+	TExpMapVtxState<ExpMapPaged> state(expMap);
+	t_expnentialMapping( mesh, startP, polyIdx, maxDist, state, 0);
+	return !mesh.isReadFailed();
+}
@@ -1,13 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include "tmesh.h"
+#include "tmeshcompact.h"
+#include "tmeshchunked.h"
 
 
 	
 class ExpMapVtx
 {
 public:
-	byte   flg   ; // 0:yet visited, 1:in Q, 2:fixed
+	unsigned char flg;  // 0:yet visited, 1:in Q, 2:fixed
 	int    from  ; // vertex inded from which the path comes from (-1:startP, -2,yet)
 	float  dist  ; // dist from start P
 	EVec2f pos   ; // position in 2D normal coordinate
@@ -20,14 +23,14 @@ public:
 		pos << 0,0;
 	}
 
-	void Set(byte _flg, int _from, float _dist)
+	void Set(unsigned char _flg, int _from, float _dist)
 	{
 		flg  = _flg;
 		from = _from;
 		dist = _dist;
 	}
 	
-	void Set(byte _flg, int _from, float _dist, EVec2f &_pos)
+	void Set(unsigned char _flg, int _from, float _dist, EVec2f &_pos)
 	{
 		flg    = _flg;
 		from   = _from;
@@ -39,6 +42,109 @@ public:
 
 
 
+//compact result (for TCompactMesh) : 16-bit distance and half float position per vertex (6 byte)
+//dist = m_dist[i] * m_dStep, m_dist[i] == 0xFFFF : not reached, the path (from) is not kept
+class ExpMapCompact
+{
+public:
+	float                  m_dStep;
+	vector<unsigned short> m_dist ;
+	vector<unsigned short> m_pos  ; //(u,v) half float, 2 per vertex
+
+	ExpMapCompact() { m_dStep = 0; }
+
+	inline bool   isReached(const int i) const { return m_dist[i] != 0xFFFF; }
+	inline float  getDist  (const int i) const { return m_dist[i] * m_dStep; }
+	inline EVec2f getPos   (const int i) const { return EVec2f(t_halfToFloat(m_pos[2 * i]), t_halfToFloat(m_pos[2 * i + 1])); }
+
+	void Set(const vector<ExpMapVtx> &expMap)
+	{
+		const int vSize = (int)expMap.size();
+		float dMax = 0;
+		for (int i = 0; i < vSize; ++i) if (expMap[i].flg == 2) dMax = max(dMax, expMap[i].dist);
+		m_dStep = (dMax > 0) ? dMax / 65534.0f : 1.0f;
+		const float inv = 1.0f / m_dStep;
+
+		m_dist.resize(vSize);
+		m_pos .resize(2 * (size_t)vSize);
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			const ExpMapVtx &v = expMap[i];
+			m_dist[i]        = (v.flg == 2) ? (unsigned short)min(65534.0f, floor(v.dist * inv + 0.5f)) : (unsigned short)0xFFFF;
+			m_pos[2 * i    ] = t_floatToHalf(v.flg == 2 ? v.pos[0] : 0.0f);
+			m_pos[2 * i + 1] = t_floatToHalf(v.flg == 2 ? v.pos[1] : 0.0f);
+		}
+	}
+};
+
+
+
+
+//cancellation of a running growth from another thread (checked every 4096 settled vertices),
+//a canceled growth leaves a partial result
+class TCancelToken
+{
+	std::atomic<bool> m_bCancel;
+public:
+	TCancelToken() : m_bCancel(false) {}
+	void Cancel()            { m_bCancel = true ; }
+	void Reset ()            { m_bCancel = false; }
+	bool isCanceled() const  { return m_bCancel; }
+};
+
+
+
+//result for TChunkedMesh : ExpMapVtx in blocks of 2^bits vertices, allocated on first access,
+//so the memory follows the reached region instead of the mesh size
+class ExpMapPaged
+{
+	int                m_bits ;
+	vector<ExpMapVtx*> m_blocks;
+
+	ExpMapPaged(const ExpMapPaged&);
+	ExpMapPaged& operator=(const ExpMapPaged&);
+
+public:
+	ExpMapPaged() { m_bits = 16; }
+	~ExpMapPaged() { clear(); }
+
+	void clear()
+	{
+		for (auto &b : m_blocks) { delete[] b; b = 0; }
+		m_blocks.clear();
+	}
+
+	void Init(const int vSize, const int bits)
+	{
+		clear();
+		m_bits = bits;
+		m_blocks.assign((vSize + (1 << bits) - 1) >> bits, 0);
+	}
+
+	inline ExpMapVtx &operator[](const int i)
+	{
+		ExpMapVtx *&b = m_blocks[i >> m_bits];
+		if (!b) b = new ExpMapVtx[(size_t)1 << m_bits];
+		return b[i & ((1 << m_bits) - 1)];
+	}
+
+	//0 if no vertex of the block was touched
+	const ExpMapVtx *getBlock(const int b) const { return m_blocks[b]; }
+	int  getBlockNum () const { return (int)m_blocks.size(); }
+	int  getBlockBits() const { return m_bits; }
+
+	size_t getMemorySize() const
+	{
+		size_t n = 0;
+		for (const auto &b : m_blocks) if (b) n += sizeof(ExpMapVtx) << m_bits;
+		return n;
+	}
+};
+
+
+
+
 /* ----------------------------------
 const TMesh    &mesh    // surface mesh model
 const EVec3f   &startP  // center point of exponential map
@@ -68,3 +174,83 @@ void expnentialMapping
 	vector<ExpMapVtx> &expMap
 
 );
+
+
+
+//the growth stops when the next vertex is farther than maxDist (only the vertices within maxDist get flg == 2)
+//or when cancel is canceled
+void DijikstraMapping
+(
+	const TMesh        &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	vector<ExpMapVtx>  &expMap ,
+	const TCancelToken *cancel = 0
+);
+
+void expnentialMapping
+(
+	const TMesh        &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	vector<ExpMapVtx>  &expMap ,
+	const TCancelToken *cancel = 0
+);
+
+
+
+//faces whose three vertices are fixed and within the geodesic radius |pos| <= radius
+//(e.g. the region to refine with TMesh::subdivideFaces before a decal is mapped)
+void expMapFacesInRadius
+(
+	const TMesh             &mesh  ,
+	const vector<ExpMapVtx> &expMap,
+	const float              radius,
+	vector<int>             &faces
+);
+
+
+
+
+//the same algorithms on the compact mesh, the result is stored compactly
+//(working memory : a float distance and a flag per vertex, float positions only for the front)
+void DijikstraMapping
+(
+	const TCompactMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	ExpMapCompact      &expMap
+);
+
+void expnentialMapping
+(
+	const TCompactMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	ExpMapCompact      &expMap
+);
+
+
+
+//out-of-core versions : the growth stops at the geodesic distance maxDist, so only the chunks
+//within maxDist (plus a one ring) are read; reached vertices have flg == 2.
+//false : a chunk could not be read, the growth stopped there and expMap is incomplete
+bool DijikstraMapping
+(
+	const TChunkedMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	ExpMapPaged        &expMap
+);
+
+bool expnentialMapping
+(
+	const TChunkedMesh &mesh   ,
+	const EVec3f       &startP ,
+	const int          &polyIdx,
+	const float         maxDist,
+	ExpMapPaged        &expMap
+);
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "tvolume.h"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * exact 3D Euclidean distance transform (Felzenszwalb & Huttenlocher)
+ *
+ * squared distance is computed by three separable 1D lower envelope passes (x, y, z),
+ * O(N) for the whole volume, each pass is parallelized over lines.
+ * anisotropic voxel pitch is supported by weighting each pass with pitch^2.
+ *
+ * t_edt_sqDist3D         : in-place squared distance (0 at sites, FLT_MAX elsewhere as input)
+ * t_distanceTransform3D  : distance to the nearest site voxel
+ * t_signedDistance3D     : negative inside, positive outside
+ *                          |value| is the distance between voxel centers
+ *                          (inside voxel -> nearest outside voxel, and vice versa),
+ *                          so the zero level lies halfway between inside and outside voxels
+-------------------------------------------------------------------*/
+
+// 1D squared distance of sampled function f
+// d[q] = min_p ( w (q-p)^2 + f[p] ),  v,z : work area of n, n+1 elements, f[p] = FLT_MAX : no site
+inline void t_edt_sqDist1D(const int n, const float w, const float *f, float *d, int *v, float *z)
+{
+	int k = 0;
+	v[0] = 0;
+	z[0] = -FLT_MAX;
+	z[1] =  FLT_MAX;
+	for (int q = 1; q < n; ++q)
+	{
+		if (f[q] >= FLT_MAX) continue;
+		if (f[v[k]] >= FLT_MAX) { v[k] = q; continue; }
+
+		float s = ( (f[q] + w * q * q) - (f[v[k]] + w * v[k] * v[k]) ) / (2.0f * w * (q - v[k]));
+		while (s <= z[k])
+		{
+			--k;
+			s = ( (f[q] + w * q * q) - (f[v[k]] + w * v[k] * v[k]) ) / (2.0f * w * (q - v[k]));
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = FLT_MAX;
+	}
+
+	if (f[v[0]] >= FLT_MAX) { for (int q = 0; q < n; ++q) d[q] = FLT_MAX; return; }
+
+	k = 0;
+	for (int q = 0; q < n; ++q)
+	{
+		while (z[k + 1] < q) ++k;
+		d[q] = w * (q - v[k]) * (float)(q - v[k]) + f[v[k]];
+	}
+}
+
+
+
+// dist : contiguous W x H x D, 0 at sites and FLT_MAX elsewhere
+//        -> squared distance to the nearest site (FLT_MAX if there is no site)
+inline void t_edt_sqDist3D(const int W, const int H, const int D, const EVec3f &pitch, float *dist)
+{
+	const size_t WH = (size_t)W * H;
+	const float  wx = pitch[0] * pitch[0], wy = pitch[1] * pitch[1], wz = pitch[2] * pitch[2];
+	const int    N  = max(W, max(H, D));
+
+#pragma omp parallel
+	{
+		vector<float> f(N), d(N), zz(N + 1);
+		vector<int>   v(N);
+
+		//x
+#pragma omp for
+		for (int i = 0; i < H * D; ++i)
+		{
+			float *line = &dist[(size_t)i * W];
+			memcpy(f.data(), line, sizeof(float) * W);
+			t_edt_sqDist1D(W, wx, f.data(), line, v.data(), zz.data());
+		}
+
+		//y
+#pragma omp for
+		for (int i = 0; i < W * D; ++i)
+		{
+			float *line = &dist[(i / W) * WH + (i % W)];
+			for (int y = 0; y < H; ++y) f[y] = line[y * (size_t)W];
+			t_edt_sqDist1D(H, wy, f.data(), d.data(), v.data(), zz.data());
+			for (int y = 0; y < H; ++y) line[y * (size_t)W] = d[y];
+		}
+
+		//z
+#pragma omp for
+		for (int i = 0; i < (int)WH; ++i)
+		{
+			float *line = &dist[i];
+			for (int z = 0; z < D; ++z) f[z] = line[z * WH];
+			t_edt_sqDist1D(D, wz, f.data(), d.data(), v.data(), zz.data());
+			for (int z = 0; z < D; ++z) line[z * WH] = d[z];
+		}
+	}
+}
+
+
+
+// dist[i] : distance to the nearest voxel with isSite(vol[i]) == true (FLT_MAX if there is none)
+template<class T, class PRED>
+void t_distanceTransform3D(const TVolume<T> &vol, const PRED &isSite, const EVec3f &pitch, TVolume<float> &dist)
+{
+	const int W = vol.getW(), H = vol.getH(), D = vol.getD();
+	if (dist.getRes() != vol.getRes() || !dist.isContiguous()) dist.Allocate(vol.getRes());
+
+#pragma omp parallel for
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			const T *s = vol .ptr(y, z);
+			float   *d = dist.ptr(y, z);
+			for (int x = 0; x < W; ++x) d[x] = isSite(s[x]) ? 0 : FLT_MAX;
+		}
+
+	t_edt_sqDist3D(W, H, D, pitch, dist.data());
+
+	const int N = (int)dist.getNum();
+#pragma omp parallel for
+	for (int i = 0; i < N; ++i) if (dist[i] < FLT_MAX) dist[i] = sqrt(dist[i]);
+}
+
+
+
+// sd[i] = -(distance to the nearest outside voxel) for inside voxels ( isInside(vol[i]) )
+//         +(distance to the nearest inside  voxel) for outside voxels
+// use -sd (with threshold 0) for t_MarchingCubes, which treats larger values as inside
+template<class T, class PRED>
+void t_signedDistance3D(const TVolume<T> &vol, const PRED &isInside, const EVec3f &pitch, TVolume<float> &sd)
+{
+	TVolume<float> dIn;
+	t_distanceTransform3D(vol, [&](const T v){ return !isInside(v); }, pitch, dIn);
+	t_distanceTransform3D(vol, isInside, pitch, sd);
+
+	const int W = vol.getW(), H = vol.getH(), D = vol.getD();
+#pragma omp parallel for
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			const T     *s = vol.ptr(y, z);
+			const float *a = dIn.ptr(y, z);
+			float       *d = sd .ptr(y, z);
+			for (int x = 0; x < W; ++x) if (isInside(s[x])) d[x] = -a[x];
+		}
+}
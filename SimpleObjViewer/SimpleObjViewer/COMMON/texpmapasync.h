@@ -0,0 +1,176 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "texpmapcache.h"
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * exp map off the UI thread
+ *
+ * Post()    : sets the seed to compute. A pending seed that the worker has not taken yet is replaced
+ *             (stale seeds are dropped) and a running growth is canceled (TCancelToken, checked every
+ *             4096 settled vertices). Post never waits for a growth.
+ * Acquire() : swaps the newest completed map into the caller's vector (no copy). It only try_locks,
+ *             so the UI thread never waits : false means "nothing new (yet)", draw the current map.
+ * results are double buffered : the worker grows into m_back and swaps it with m_ready when it is
+ * complete, Acquire swaps m_ready with the map of the caller (whose buffer is reused afterwards).
+ * onReady is called from the worker thread after a map is published (e.g. ::InvalidateRect) and
+ * after every later job while that map is not acquired.
+ * The maps are computed through a TExpMapCache (a revisited seed is a lookup).
+ * The mesh must not change while the worker runs (Stop, modify, Start).
+-------------------------------------------------------------------*/
+
+class TExpMapAsync
+{
+	struct Job
+	{
+		EVec3f      startP;
+		int         polyIdx;
+		TExpMapMode mode;
+		float       radius;
+		long long   id;
+	};
+
+	const TMesh            *m_mesh   ;
+	TExpMapCache            m_cache  ; //used by the worker thread only
+	std::thread             m_thread ;
+	std::mutex              m_mutex  ;
+	std::condition_variable m_condJob, m_condIdle;
+	TCancelToken            m_cancel ;
+	std::function<void()>   m_onReady;
+
+	bool              m_bQuit, m_bPending, m_bRunning, m_bReady;
+	Job               m_pending;
+	vector<ExpMapVtx> m_back, m_ready;
+	long long         m_postId, m_readyId;
+	long long         m_nPosted, m_nDropped, m_nCanceled, m_nComputed;
+
+	TExpMapAsync(const TExpMapAsync&);
+	TExpMapAsync& operator=(const TExpMapAsync&);
+
+public:
+	TExpMapAsync(const size_t cacheBytes = (size_t)256 << 20) : m_cache(cacheBytes)
+	{
+		m_mesh  = 0;
+		m_bQuit = m_bPending = m_bRunning = m_bReady = false;
+		m_postId = m_readyId = 0;
+		m_nPosted = m_nDropped = m_nCanceled = m_nComputed = 0;
+	}
+	~TExpMapAsync() { Stop(); }
+
+	void Start(const TMesh &mesh, std::function<void()> onReady = std::function<void()>())
+	{
+		Stop();
+		m_mesh    = &mesh;
+		m_onReady = onReady;
+		m_bQuit   = m_bPending = m_bRunning = m_bReady = false;
+		m_cache.clear();
+		m_thread  = std::thread(&TExpMapAsync::Run, this);
+	}
+
+	void Stop()
+	{
+		if (!m_thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bQuit = true;
+			m_cancel.Cancel();
+		}
+		m_condJob.notify_one();
+		m_thread.join();
+		m_bPending = m_bRunning = false;
+		m_mesh = 0;
+	}
+
+	//returns the id of the posted job (Acquire reports the id of the map it returns)
+	long long Post(const EVec3f &startP, const int polyIdx, const TExpMapMode mode = EXPMAP_EXPONENTIAL, const float radius = FLT_MAX)
+	{
+		long long id;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_bPending) ++m_nDropped;
+			m_pending.startP  = startP;
+			m_pending.polyIdx = polyIdx;
+			m_pending.mode    = mode;
+			m_pending.radius  = radius;
+			m_pending.id      = id = ++m_postId;
+			m_bPending = true;
+			++m_nPosted;
+			if (m_bRunning) m_cancel.Cancel();
+		}
+		m_condJob.notify_one();
+		return id;
+	}
+
+	//newest completed map (if any and not acquired yet) into expMap, never blocks
+	bool Acquire(vector<ExpMapVtx> &expMap, long long *id = 0)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+		if (!lock.owns_lock() || !m_bReady) return false;
+		expMap.swap(m_ready);
+		m_bReady = false;
+		if (id) *id = m_readyId;
+		return true;
+	}
+
+	//blocks until the posted jobs are done (batch use and tests, not for the UI thread)
+	void WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condIdle.wait(lock, [this]() { return !m_thread.joinable() || m_bQuit || (!m_bPending && !m_bRunning); });
+	}
+
+	//posted, replaced before being started, canceled while running, published
+	void getStats(long long &posted, long long &dropped, long long &canceled, long long &computed)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		posted = m_nPosted; dropped = m_nDropped; canceled = m_nCanceled; computed = m_nComputed;
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_condJob.wait(lock, [this]() { return m_bQuit || m_bPending; });
+			if (m_bQuit) break;
+
+			const Job job = m_pending;
+			m_bPending = false;
+			m_bRunning = true;
+			m_cancel.Reset();
+			lock.unlock();
+
+			m_cache.Compute(*m_mesh, job.startP, job.polyIdx, job.mode, job.radius, m_back, &m_cancel);
+
+			lock.lock();
+			m_bRunning = false;
+			const bool bDone = !m_cancel.isCanceled();
+			if (bDone)
+			{
+				m_ready.swap(m_back);
+				m_bReady  = true;
+				m_readyId = job.id;
+				++m_nComputed;
+			}
+			else ++m_nCanceled;
+			m_condIdle.notify_all();
+
+			//also after a canceled job : a map not acquired yet (Acquire lost the try_lock) is signaled again
+			if (m_bReady && m_onReady)
+			{
+				lock.unlock();
+				m_onReady();
+				lock.lock();
+			}
+		}
+		m_condIdle.notify_all();
+	}
+};
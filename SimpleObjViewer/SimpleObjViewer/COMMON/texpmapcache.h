@@ -0,0 +1,246 @@
+#pragma once
+
+#include <map>
+#include <list>
+#include <vector>
+#include <cmath>
+#include "expmap.h"
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * cache of exp map / Dijkstra results for a handful of seeds visited again and again
+ *
+ * key : (polyIdx, barycentric position quantized to 1/m_baryRes, mode, radius with an 8 bit mantissa)
+ *   the seed is snapped to the quantized barycentric position before the growth, so an entry is a
+ *   function of its key only (the same seed cell always gives the same map).
+ * entry : the reached vertices (flg == 2, dist <= radius) as runs of vertex indices,
+ *   dist as uint16 (dist = q * dStep), from as int32 (paths back to the seed),
+ *   (u,v) as half floats (not stored for EXPMAP_DIJKSTRA)
+ *   -> 10 byte per reached vertex, a local map in a spatially ordered mesh is a few runs.
+ * the least recently used entries are dropped when the total size exceeds the budget.
+ * Compute() returns the decoded entry on a hit and on a miss (flg = 2 for the reached vertices).
+ * The cache belongs to one mesh : call clear() when the mesh changes (a change of its size clears it).
+-------------------------------------------------------------------*/
+
+enum TExpMapMode
+{
+	EXPMAP_EXPONENTIAL = 0,
+	EXPMAP_DIJKSTRA    = 1
+};
+
+
+
+class TExpMapCache
+{
+	struct Key
+	{
+		int polyIdx, b1, b2, mode;
+		float radius;
+
+		bool operator<(const Key &k) const
+		{
+			if (polyIdx != k.polyIdx) return polyIdx < k.polyIdx;
+			if (b1      != k.b1     ) return b1      < k.b1     ;
+			if (b2      != k.b2     ) return b2      < k.b2     ;
+			if (mode    != k.mode   ) return mode    < k.mode   ;
+			return radius < k.radius;
+		}
+	};
+
+	struct Entry
+	{
+		Key                    key  ;
+		float                  dStep;
+		vector<int>            runs ; //[runs[2k], runs[2k+1]) : reached vertices
+		vector<unsigned short> dist ;
+		vector<int>            from ;
+		vector<unsigned short> uv   ;
+
+		size_t getMemorySize() const
+		{
+			return sizeof(Entry) + sizeof(int) * (runs.capacity() + from.capacity()) + sizeof(unsigned short) * (dist.capacity() + uv.capacity());
+		}
+	};
+
+	list<Entry>                           m_lru; //front : most recently used
+	map<Key, list<Entry>::iterator>       m_map;
+	size_t                                m_bytes, m_budget;
+	int                                   m_vSize, m_pSize;
+	long long                             m_hits, m_misses;
+
+public:
+	int m_baryRes; //barycentric quantization (seed cells per face edge)
+
+	TExpMapCache(const size_t budgetBytes = (size_t)256 << 20, const int baryRes = 64)
+	{
+		m_budget  = budgetBytes;
+		m_baryRes = baryRes;
+		m_bytes   = 0;
+		m_vSize   = m_pSize = -1;
+		m_hits    = m_misses = 0;
+	}
+
+	void clear()
+	{
+		m_lru.clear();
+		m_map.clear();
+		m_bytes = 0;
+		m_vSize = m_pSize = -1;
+	}
+
+	void setBudget(const size_t budgetBytes) { m_budget = budgetBytes; evict(); }
+
+	size_t    getMemorySize() const { return m_bytes ; }
+	int       getEntryNum  () const { return (int)m_lru.size(); }
+	long long getHitNum    () const { return m_hits  ; }
+	long long getMissNum   () const { return m_misses; }
+
+	//radius : geodesic radius of the map (FLT_MAX : whole mesh), returns true on a cache hit
+	//cancel   : a growth canceled through it is neither cached nor decoded (expMap holds the partial map)
+	bool Compute(
+		const TMesh        &mesh   ,
+		const EVec3f       &startP ,
+		const int           polyIdx,
+		const TExpMapMode   mode   ,
+		const float         radius ,
+		vector<ExpMapVtx>  &expMap ,
+		const TCancelToken *cancel = 0)
+	{
+		if (mesh.m_vSize != m_vSize || mesh.m_pSize != m_pSize)
+		{
+			clear();
+			m_vSize = mesh.m_vSize;
+			m_pSize = mesh.m_pSize;
+		}
+
+		//key and snapped seed
+		const int   *idx = mesh.m_pPolys[polyIdx].idx;
+		const EVec3f x0  = mesh.m_vVerts[idx[0]];
+		const EVec3f e1  = mesh.m_vVerts[idx[1]] - x0;
+		const EVec3f e2  = mesh.m_vVerts[idx[2]] - x0;
+		Key key;
+		key.polyIdx = polyIdx;
+		key.mode    = (int)mode;
+		key.radius  = quantizeRadius(radius);
+		baryCoord(e1, e2, startP - x0, key.b1, key.b2);
+		const EVec3f seed = x0 + ((float)key.b1 / m_baryRes) * e1 + ((float)key.b2 / m_baryRes) * e2;
+
+		auto it = m_map.find(key);
+		if (it != m_map.end())
+		{
+			++m_hits;
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			Decode(*it->second, mesh.m_vSize, expMap);
+			return true;
+		}
+		++m_misses;
+
+		if (mode == EXPMAP_EXPONENTIAL) expnentialMapping(mesh, seed, polyIdx, key.radius, expMap, cancel);
+		else                            DijikstraMapping (mesh, seed, polyIdx, key.radius, expMap, cancel);
+		if (cancel && cancel->isCanceled()) return false;
+
+		Entry e;
+		e.key = key;
+		Encode(expMap, mode == EXPMAP_EXPONENTIAL, key.radius, e);
+		Decode(e, mesh.m_vSize, expMap);
+
+		const size_t bytes = e.getMemorySize();
+		if (bytes <= m_budget)
+		{
+			m_lru.push_front(std::move(e));
+			m_map[key] = m_lru.begin();
+			m_bytes += bytes;
+			evict();
+		}
+		return false;
+	}
+
+private:
+	//radius rounded up to 8 significant bits
+	static float quantizeRadius(const float r)
+	{
+		if (!(r < FLT_MAX)) return FLT_MAX;
+		if (r <= 0) return 0;
+		int e;
+		const float m = frexp(r, &e);
+		return ldexp(ceil(m * 256.0f) / 256.0f, e);
+	}
+
+	//quantized barycentric coordinates (b1, b2) of p = b1 e1 + b2 e2 (projected onto the face), b1 + b2 <= res
+	void baryCoord(const EVec3f &e1, const EVec3f &e2, const EVec3f &p, int &b1, int &b2) const
+	{
+		const float a = e1.dot(e1), b = e1.dot(e2), c = e2.dot(e2), d = e1.dot(p), f = e2.dot(p);
+		const float det = a * c - b * b;
+		float s = 0, t = 0;
+		if (fabs(det) > 1e-30f)
+		{
+			s = (c * d - b * f) / det;
+			t = (a * f - b * d) / det;
+		}
+		b1 = (int)floor(max(0.0f, min(1.0f, s)) * m_baryRes + 0.5f);
+		b2 = (int)floor(max(0.0f, min(1.0f, t)) * m_baryRes + 0.5f);
+		if (b1 + b2 > m_baryRes) { if (b1 > b2) b1 = m_baryRes - b2; else b2 = m_baryRes - b1; }
+	}
+
+	static void Encode(const vector<ExpMapVtx> &expMap, const bool bPos, const float radius, Entry &e)
+	{
+		const int vSize = (int)expMap.size();
+		float dMax = 0;
+		for (int i = 0; i < vSize; ++i)
+		{
+			const ExpMapVtx &v = expMap[i];
+			if (v.flg != 2 || v.dist > radius) continue;
+			dMax = max(dMax, v.dist);
+			if (e.runs.empty() || e.runs.back() != i) { e.runs.push_back(i); e.runs.push_back(i + 1); }
+			else ++e.runs.back();
+		}
+		e.dStep = (dMax > 0) ? dMax / 65535.0f : 1.0f;
+		const float inv = 1.0f / e.dStep;
+
+		for (size_t r = 0; r < e.runs.size(); r += 2)
+		{
+			for (int i = e.runs[r]; i < e.runs[r + 1]; ++i)
+			{
+				e.dist.push_back((unsigned short)min(65535.0f, floor(expMap[i].dist * inv + 0.5f)));
+				e.from.push_back(expMap[i].from);
+				if (!bPos) continue;
+				e.uv.push_back(t_floatToHalf(expMap[i].pos[0]));
+				e.uv.push_back(t_floatToHalf(expMap[i].pos[1]));
+			}
+		}
+		e.runs.shrink_to_fit();
+		e.dist.shrink_to_fit();
+		e.from.shrink_to_fit();
+		e.uv  .shrink_to_fit();
+	}
+
+	static void Decode(const Entry &e, const int vSize, vector<ExpMapVtx> &expMap)
+	{
+		expMap.assign(vSize, ExpMapVtx());
+		const bool bPos = !e.uv.empty();
+		int k = 0;
+		for (size_t r = 0; r < e.runs.size(); r += 2)
+		{
+			for (int i = e.runs[r]; i < e.runs[r + 1]; ++i, ++k)
+			{
+				EVec2f p(0, 0);
+				if (bPos) p << t_halfToFloat(e.uv[2 * k]), t_halfToFloat(e.uv[2 * k + 1]);
+				expMap[i].Set(2, e.from[k], e.dist[k] * e.dStep, p);
+			}
+		}
+	}
+
+	void evict()
+	{
+		while (m_bytes > m_budget && !m_lru.empty())
+		{
+			const Entry &e = m_lru.back();
+			m_bytes -= e.getMemorySize();
+			m_map.erase(e.key);
+			m_lru.pop_back();
+		}
+	}
+};
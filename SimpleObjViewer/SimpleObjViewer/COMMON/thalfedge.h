@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * edge tables for triangle meshes
+ *
+ * TMeshEdges : undirected edge table. The half-edges h = 3f+k (polys[3f+k] -> polys[3f+(k+1)%3])
+ *   are radix sorted by the 64 bit key (min vertex, max vertex), so the half-edges of an edge are
+ *   adjacent and equal keys share one edge id (used by THalfEdges and by the subdivision).
+ *
+ * THalfEdges : index based half-edge table
+ * half-edge h = 3 * f + k runs from polys[3f+k] to polys[3f+(k+1)%3] of face f,
+ * so next / prev / face / from / to are arithmetic and only two arrays are stored :
+ *   twin[h] : opposite half-edge (-1 on the border and at non-manifold edges)
+ *   vOut[v] : one outgoing half-edge of v (the border one if v is on the border, -1 if isolated)
+ *
+ * twins are the two half-edges of an edge of TMeshEdges (parallel LSD radix sort, per-thread histograms).
+ * Edges shared by faces of inconsistent orientation or by more than two faces are left without twin.
+ *
+ * rotating around v (counter clockwise for CCW faces) : h -> twin(prev(h)),
+ * starting from vOut[v] visits the whole fan of v (one fan for non-manifold vertices).
+ *
+ * The table refers to the polygon array given to Build (TMesh rebuilds it with the ring info).
+-------------------------------------------------------------------*/
+
+// sort (key, val) pairs by the lower "bits" bits of key (stable LSD radix, 12 bits per pass)
+// keys / vals are sorted in place, tmpK / tmpV : work area of n
+inline void t_radixSortPairs(
+	const int           n,
+	const int           bits,
+	unsigned long long *keys,
+	int                *vals,
+	unsigned long long *tmpK,
+	int                *tmpV)
+{
+	const int DIG = 12, BKT = 1 << DIG;
+	const int passNum = (bits + DIG - 1) / DIG;
+	const int thNum   = omp_get_max_threads();
+	vector<int> hist((size_t)thNum * BKT);
+
+	for (int pass = 0; pass < passNum; ++pass)
+	{
+		const int shift = pass * DIG;
+
+#pragma omp parallel num_threads(thNum)
+		{
+			const int th = omp_get_thread_num(), nt = omp_get_num_threads();
+			const int i0 = (int)((long long)n * th / nt), i1 = (int)((long long)n * (th + 1) / nt);
+			int *h = &hist[(size_t)th * BKT];
+			for (int b = 0; b < BKT; ++b) h[b] = 0;
+			for (int i = i0; i < i1; ++i) ++h[(keys[i] >> shift) & (BKT - 1)];
+
+#pragma omp barrier
+#pragma omp single
+			{
+				//offsets : bucket major, thread minor (stable)
+				int ofs = 0;
+				for (int b = 0; b < BKT; ++b)
+					for (int t = 0; t < nt; ++t)
+					{
+						const int c = hist[(size_t)t * BKT + b];
+						hist[(size_t)t * BKT + b] = ofs;
+						ofs += c;
+					}
+			}
+
+			for (int i = i0; i < i1; ++i)
+			{
+				const int o = h[(keys[i] >> shift) & (BKT - 1)]++;
+				tmpK[o] = keys[i];
+				tmpV[o] = vals[i];
+			}
+		}
+		swap(keys, tmpK);
+		swap(vals, tmpV);
+	}
+
+	if (passNum % 2 == 1)
+	{
+		//the result is in the work area
+		memcpy(tmpK, keys, sizeof(unsigned long long) * n);
+		memcpy(tmpV, vals, sizeof(int) * n);
+	}
+}
+
+
+
+class TMeshEdges
+{
+public:
+	int         m_eSize ;
+	vector<int> m_hEdge ; //edge id of each half-edge (3 * pSize)
+	vector<int> m_eVerts; //two end vertices (min, max) of each edge
+	vector<int> m_eOff  ; //half-edges of edge e : m_eHalf[ m_eOff[e] .. m_eOff[e+1] )
+	vector<int> m_eHalf ;
+
+	TMeshEdges() { m_eSize = 0; }
+
+	void Build(const int vSize, const int pSize, const int *polys)
+	{
+		const int hN = 3 * pSize;
+		m_eSize = 0;
+		m_hEdge.resize(hN);
+		m_eHalf.resize(hN);
+		m_eVerts.clear();
+		m_eOff  .clear();
+
+		int bits = 1;
+		while (bits < 31 && (1 << bits) < vSize) ++bits;
+		const unsigned long long mask = (1ull << bits) - 1;
+
+		vector<unsigned long long> keys(hN), tmpK(hN);
+		vector<int>                tmpV(hN);
+#pragma omp parallel for
+		for (int h = 0; h < hN; ++h)
+		{
+			const int a = polys[h], b = polys[(h % 3 == 2) ? h - 2 : h + 1];
+			keys[h]    = ((unsigned long long)min(a, b) << bits) | (unsigned long long)max(a, b);
+			m_eHalf[h] = h;
+		}
+		t_radixSortPairs(hN, 2 * bits, keys.data(), m_eHalf.data(), tmpK.data(), tmpV.data());
+
+		//edge id of each sorted position (tmpV) : count of run heads up to it - 1
+#pragma omp parallel for
+		for (int i = 0; i < hN; ++i) tmpV[i] = (i == 0 || keys[i] != keys[i - 1]) ? 1 : 0;
+		for (int i = 0; i < hN; ++i) { m_eSize += tmpV[i]; tmpV[i] = m_eSize - 1; }
+
+		m_eOff  .resize(m_eSize + 1);
+		m_eVerts.resize(2 * (size_t)m_eSize);
+#pragma omp parallel for
+		for (int i = 0; i < hN; ++i)
+		{
+			const int e = tmpV[i];
+			m_hEdge[m_eHalf[i]] = e;
+			if (i == 0 || keys[i] != keys[i - 1])
+			{
+				m_eOff  [e] = i;
+				m_eVerts[2 * e    ] = (int)(keys[i] >> bits);
+				m_eVerts[2 * e + 1] = (int)(keys[i] & mask);
+			}
+		}
+		m_eOff[m_eSize] = hN;
+	}
+
+	inline int faceNum(const int e) const { return m_eOff[e + 1] - m_eOff[e]; }
+
+	//vertex opposite to the half-edge h in its face
+	static inline int oppVertex(const int *polys, const int h) { return polys[h - h % 3 + (h % 3 + 2) % 3]; }
+};
+
+
+
+class THalfEdges
+{
+	int         m_vSize ;
+	int         m_pSize ;
+	const int  *m_polys ;
+	vector<int> m_twin  ;
+	vector<int> m_vOut  ;
+
+public:
+	THalfEdges()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		m_vSize = 0;
+		m_pSize = 0;
+		m_polys = 0;
+		m_twin.clear();
+		m_vOut.clear();
+	}
+
+	// polys : 3 * pSize vertex indices (must stay alive while the table is used)
+	void Build(const int vSize, const int pSize, const int *polys)
+	{
+		m_vSize = vSize;
+		m_pSize = pSize;
+		m_polys = polys;
+
+		const int hN = 3 * pSize;
+		m_twin.assign(hN, -1);
+		m_vOut.assign(vSize, -1);
+		if (hN == 0) return;
+
+		TMeshEdges E;
+		E.Build(vSize, pSize, polys);
+
+		//an edge with exactly two half-edges of opposite direction is manifold : they are twins
+#pragma omp parallel for
+		for (int e = 0; e < E.m_eSize; ++e)
+		{
+			if (E.faceNum(e) != 2) continue;
+			const int ha = E.m_eHalf[E.m_eOff[e]], hb = E.m_eHalf[E.m_eOff[e] + 1];
+			if (from(ha) != to(hb)) continue;
+			m_twin[ha] = hb;
+			m_twin[hb] = ha;
+		}
+
+		//outgoing half-edges (border ones have priority)
+		for (int h = 0; h < hN; ++h)
+		{
+			int &o = m_vOut[from(h)];
+			if (o < 0 || m_twin[h] < 0) o = h;
+		}
+	}
+
+	int  getVSize   () const { return m_vSize; }
+	int  getHalfNum () const { return 3 * m_pSize; }
+	bool isBuilt    () const { return m_polys != 0; }
+
+	static inline int next(const int h) { return (h % 3 == 2) ? h - 2 : h + 1; }
+	static inline int prev(const int h) { return (h % 3 == 0) ? h + 2 : h - 1; }
+	static inline int face(const int h) { return h / 3; }
+
+	inline int from(const int h) const { return m_polys[h]; }
+	inline int to  (const int h) const { return m_polys[next(h)]; }
+	inline int twin(const int h) const { return m_twin[h]; }
+	inline int vOut(const int v) const { return m_vOut[v]; }
+
+	inline bool isBorder      (const int h) const { return m_twin[h] < 0; }
+	inline bool isBorderVertex(const int v) const { return m_vOut[v] >= 0 && m_twin[m_vOut[v]] < 0; }
+
+	// next outgoing half-edge around from(h), -1 at the border
+	inline int rotate(const int h) const { return m_twin[prev(h)]; }
+
+	// one ring of v in rotation order (the first one is to(vOut[v]))
+	// the last vertex of an open fan (border) is also added, returns false if v is on the border
+	bool getOrderedRing(const int v, vector<int> &ringVs, vector<int> *ringPs = 0) const
+	{
+		ringVs.clear();
+		if (ringPs) ringPs->clear();
+		const int h0 = m_vOut[v];
+		if (h0 < 0) return false;
+
+		int h = h0;
+		do
+		{
+			ringVs.push_back(to(h));
+			if (ringPs) ringPs->push_back(face(h));
+			const int r = rotate(h);
+			if (r < 0)
+			{
+				ringVs.push_back(from(prev(h)));
+				return false;
+			}
+			h = r;
+		}
+		while (h != h0);
+		return true;
+	}
+};
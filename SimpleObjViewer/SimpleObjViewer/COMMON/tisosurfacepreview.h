@@ -0,0 +1,228 @@
+#pragma once
+
+#include "tmarchingcubes.h"
+#include "tvolumepyramid.h"
+
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <climits>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * coarse-to-fine iso-surface preview for interactive threshold tuning
+ *
+ * SetThresh() extracts the iso-surface of a coarse pyramid level on the caller thread
+ * (at most previewVoxNum voxels, a few ms) and starts a background thread
+ * that extracts the finer levels down to level 0.
+ * Each finished level replaces the current result, the UI thread polls FetchMesh().
+ *
+ * A new SetThresh() / SetVolume() / Cancel() increments the generation counter.
+ * The worker extracts in z-slabs and checks the counter between slabs,
+ * so the caller waits at most for one slab when it joins an outdated worker.
+ *
+ * usage
+ *   TIsoSurfacePreview<short> iso;
+ *   iso.SetVolume( vol, pitch );
+ *   iso.SetThresh( 300 );                       //slider moved
+ *   if( iso.FetchMesh( mesh ) ) redraw();       //in OnTimer / OnIdle
+-------------------------------------------------------------------*/
+
+// marching cubes of the whole volume in z-slabs of slabN cells
+// vertices on slab boundaries are welded (same result as t_MarchingCubes)
+// returns false if "gen" became different from "myGen" (canceled)
+template<class T>
+bool t_MarchingCubes_Slabs(
+	const TVolume<T> &vol,
+	const EVec3f     &pitch,
+	const T           Thresh,
+	const int         slabN,
+	const std::atomic<int> &gen,
+	const int         myGen,
+
+	vector<EVec3f> &Vs,
+	vector<TPoly > &Ps)
+{
+	const int W = vol.getW(), H = vol.getH(), D = vol.getD();
+	const int cWH = (W + 1) * (H + 1);
+
+	Vs.clear();
+	Ps.clear();
+
+	vector<EVec3f>    sVs;
+	vector<TPoly >    sPs;
+	vector<long long> keys;
+	vector<int>       idx;
+	unordered_map<long long, int> bottom, top;
+
+	for (int z0 = 0; z0 < D + 1; z0 += slabN)
+	{
+		if (gen != myGen) return false;
+
+		const int z1 = min(D + 1, z0 + slabN);
+		const int cellS[3] = { 0, 0, z0 }, cellE[3] = { W + 1, H + 1, z1 };
+
+		sVs.clear(); sPs.clear(); keys.clear();
+		t_MarchingCubes_Cells<T>(vol.getRes(), pitch, vol.data(), Thresh, cellS, cellE, sVs, sPs, &keys);
+
+		//vertices on node plane z0 were generated by the previous slab
+		idx.resize(sVs.size());
+		top.clear();
+		for (int i = 0; i < (int)sVs.size(); ++i)
+		{
+			const int axis = (int)(keys[i] % 3);
+			const int nz   = (int)(keys[i] / 3 / cWH);
+
+			auto it = (axis != 2 && nz == z0) ? bottom.find(keys[i]) : bottom.end();
+			if (it != bottom.end()) idx[i] = it->second;
+			else
+			{
+				idx[i] = (int)Vs.size();
+				Vs.push_back(sVs[i]);
+			}
+			if (axis != 2 && nz == z1) top[keys[i]] = idx[i];
+		}
+		for (const auto &p : sPs) Ps.push_back(TPoly(idx[p.idx[0]], idx[p.idx[1]], idx[p.idx[2]]));
+		bottom.swap(top);
+	}
+	return true;
+}
+
+
+
+template<class T>
+class TIsoSurfacePreview
+{
+	TVolume<T>        m_vol    ; //level 0 (contiguous copy of the input)
+	TVolumePyramid<T> m_pyramid;
+	EVec3f            m_pitch  ;
+	size_t            m_previewVoxNum;
+
+	std::thread       m_worker ;
+	std::atomic<int>  m_gen    ;
+	std::atomic<bool> m_bRefining;
+
+	//latest result (guarded by m_mutex)
+	std::mutex        m_mutex  ;
+	vector<EVec3f>    m_Vs     ;
+	vector<TPoly >    m_Ps     ;
+	int               m_level  ;
+	bool              m_bNew   ;
+
+public:
+	TIsoSurfacePreview()
+	{
+		m_pitch << 1, 1, 1;
+		m_previewVoxNum = 64 * 64 * 64;
+		m_gen       = 0;
+		m_bRefining = false;
+		m_level     = -1;
+		m_bNew      = false;
+	}
+
+	~TIsoSurfacePreview()
+	{
+		Cancel();
+	}
+
+	// builds the pyramid (the volume is copied)
+	void SetVolume(const TVolume<T> &vol, const EVec3f &pitch, const TPyramidMode mode = PYR_MAX, const size_t previewVoxNum = 64 * 64 * 64)
+	{
+		Cancel();
+		if (vol.isContiguous()) m_vol = vol;
+		else
+		{
+			m_vol.Allocate(vol.getRes());
+			vol.CopyTo(m_vol.data());
+		}
+		m_pitch         = pitch;
+		m_previewVoxNum = previewVoxNum;
+		m_pyramid.Build(m_vol, mode);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_Vs.clear();
+		m_Ps.clear();
+		m_level = -1;
+		m_bNew  = false;
+	}
+
+	// extract the coarse level now and refine in background
+	// return the level of the coarse mesh
+	int SetThresh(const T thresh)
+	{
+		Cancel();
+		if (m_pyramid.getLevelNum() == 0) return -1;
+
+		const int myGen  = m_gen;
+		const int coarse = m_pyramid.getLevelFor(m_previewVoxNum);
+
+		vector<EVec3f> Vs;
+		vector<TPoly > Ps;
+		t_MarchingCubes_Slabs<T>(m_pyramid.getLevel(coarse), m_pyramid.getPitch(coarse, m_pitch), thresh, INT_MAX, m_gen, myGen, Vs, Ps);
+		publish(Vs, Ps, coarse, myGen);
+
+		if (coarse > 0)
+		{
+			m_bRefining = true;
+			m_worker = std::thread([this, thresh, coarse, myGen]()
+			{
+				vector<EVec3f> Vs;
+				vector<TPoly > Ps;
+				for (int l = coarse - 1; l >= 0; --l)
+				{
+					if (!t_MarchingCubes_Slabs<T>(m_pyramid.getLevel(l), m_pyramid.getPitch(l, m_pitch), thresh, 8, m_gen, myGen, Vs, Ps)) break;
+					publish(Vs, Ps, l, myGen);
+				}
+				m_bRefining = false;
+			});
+		}
+		return coarse;
+	}
+
+	// stop the background refinement (waits at most one slab)
+	void Cancel()
+	{
+		++m_gen;
+		if (m_worker.joinable()) m_worker.join();
+		m_bRefining = false;
+	}
+
+	// true if a newer mesh than the last fetched one is available (never blocks on extraction)
+	bool FetchMesh(vector<EVec3f> &Vs, vector<TPoly> &Ps, int *level = 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_bNew) return false;
+		Vs.swap(m_Vs);
+		Ps.swap(m_Ps);
+		if (level) *level = m_level;
+		m_bNew = false;
+		return true;
+	}
+
+	bool FetchMesh(TMesh &mesh, int *level = 0)
+	{
+		vector<EVec3f> Vs;
+		vector<TPoly > Ps;
+		if (!FetchMesh(Vs, Ps, level)) return false;
+		mesh.initialize(Vs, Ps);
+		return true;
+	}
+
+	bool isRefining() const { return m_bRefining; }
+	const TVolumePyramid<T> &getPyramid() const { return m_pyramid; }
+
+private:
+	void publish(vector<EVec3f> &Vs, vector<TPoly> &Ps, const int level, const int myGen)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_gen != myGen) return;
+		m_Vs.swap(Vs);
+		m_Ps.swap(Ps);
+		m_level = level;
+		m_bNew  = true;
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "tmath.h"
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <omp.h>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * 3D connected component labeling (6/18/26 connectivity)
+ *
+ * two-pass union-find
+ *  1. the volume is split into z-slabs and each thread scans one slab in raster order,
+ *     uniting every foreground voxel with its already-scanned neighbors.
+ *     The label array itself stores the union-find parent (voxel index),
+ *     roots are always the smallest index of their tree.
+ *  2. slab boundaries are united, then one raster pass flattens the trees into
+ *     consecutive labels (1..N) and accumulates voxel counts and bounding boxes.
+ *
+ * label : 0 for background, 1..N for components
+ * comps : comps[k] is the information of label k+1
+-------------------------------------------------------------------*/
+
+class TComponent3D
+{
+public:
+	int    voxNum;
+	EVec3i minIdx;
+	EVec3i maxIdx;
+
+	TComponent3D()
+	{
+		voxNum = 0;
+		minIdx << INT_MAX, INT_MAX, INT_MAX;
+		maxIdx << -1, -1, -1;
+	}
+};
+
+
+
+inline int t_labeling_findRoot(const int *parent, int i)
+{
+	while (parent[i] != i) i = parent[i];
+	return i;
+}
+
+inline void t_labeling_compress(int *parent, int i, const int root)
+{
+	while (parent[i] != root)
+	{
+		const int p = parent[i];
+		parent[i] = root;
+		i = p;
+	}
+}
+
+inline void t_labeling_unite(int *parent, const int a, const int b)
+{
+	const int ra = t_labeling_findRoot(parent, a);
+	const int rb = t_labeling_findRoot(parent, b);
+	const int r  = min(ra, rb);
+	if (ra != rb) parent[max(ra, rb)] = r;
+
+	t_labeling_compress(parent, a, r);
+	t_labeling_compress(parent, b, r);
+}
+
+
+
+// return number of components
+template<class T, class PRED>
+int t_labeling3D
+(
+	const int W, const int H, const int D,
+	const T   *vol,
+	const PRED &isForeground,
+	const int  connectivity, // 6, 18, or 26
+	int       *label,
+	vector<TComponent3D> &comps
+)
+{
+	const int WH = W * H;
+
+	//neighbors scanned before (x,y,z) in raster order
+	static const int neiAll[13][3] = {
+		{-1, 0, 0}, { 0,-1, 0}, { 0, 0,-1},                                     //6
+		{-1,-1, 0}, { 1,-1, 0}, {-1, 0,-1}, { 1, 0,-1}, { 0,-1,-1}, { 0, 1,-1}, //18
+		{-1,-1,-1}, { 1,-1,-1}, {-1, 1,-1}, { 1, 1,-1} };                      //26
+	const int neiNum = (connectivity <= 6) ? 3 : (connectivity <= 18) ? 9 : 13;
+
+	int neiOfs[13];
+	for (int k = 0; k < neiNum; ++k) neiOfs[k] = neiAll[k][0] + neiAll[k][1] * W + neiAll[k][2] * WH;
+
+	//the first foreground neighbor gives the root, the others are united only when they differ
+	auto uniteNeighbors = [&](const int x, const int y, const int z, const int zMin)
+	{
+		const int I = x + y * W + z * WH;
+		label[I] = I;
+		const bool bInner = x > 0 && x < W - 1 && y > 0 && y < H - 1 && z > zMin;
+		for (int k = 0; k < neiNum; ++k)
+		{
+			if (!bInner)
+			{
+				const int nx = x + neiAll[k][0], ny = y + neiAll[k][1], nz = z + neiAll[k][2];
+				if (nx < 0 || ny < 0 || nz < zMin || nx >= W || ny >= H) continue;
+			}
+
+			const int n = label[I + neiOfs[k]];
+			if (n < 0 || n == label[I]) continue;
+			if (label[I] == I) label[I] = t_labeling_findRoot(label, n);
+			else               t_labeling_unite(label, I, n);
+		}
+	};
+
+	//1. label each z-slab in parallel
+	const int slabN = max(1, min(D, omp_get_max_threads()));
+	vector<int> slabZ(slabN + 1);
+	for (int i = 0; i <= slabN; ++i) slabZ[i] = (int)( (long long)D * i / slabN );
+
+#pragma omp parallel for schedule(static, 1)
+	for (int s = 0; s < slabN; ++s)
+	{
+		for (int z = slabZ[s]; z < slabZ[s + 1]; ++z)
+		for (int y = 0; y < H; ++y)
+		for (int x = 0; x < W; ++x)
+		{
+			const int I = x + y * W + z * WH;
+			if (!isForeground(vol[I])) { label[I] = -1; continue; }
+			uniteNeighbors(x, y, z, slabZ[s]);
+		}
+	}
+
+	//2. unite slab boundaries
+	for (int s = 1; s < slabN; ++s)
+	{
+		const int z = slabZ[s];
+		for (int y = 0; y < H; ++y)
+		for (int x = 0; x < W; ++x)
+		{
+			const int I = x + y * W + z * WH;
+			if (label[I] < 0) continue;
+			for (int k = 0; k < neiNum; ++k)
+			{
+				if (neiAll[k][2] != -1) continue;
+				const int nx = x + neiAll[k][0], ny = y + neiAll[k][1];
+				if (nx < 0 || ny < 0 || nx >= W || ny >= H) continue;
+				if (label[I + neiOfs[k]] >= 0) t_labeling_unite(label, I, I + neiOfs[k]);
+			}
+		}
+	}
+
+	//3. flatten (parent[i] < i, so parent's entry already holds its final label)
+	comps.clear();
+	for (int z = 0, I = 0; z < D; ++z)
+	for (int y = 0; y < H; ++y)
+	for (int x = 0; x < W; ++x, ++I)
+	{
+		if (label[I] < 0) { label[I] = 0; continue; }
+		if (label[I] == I)
+		{
+			comps.push_back(TComponent3D());
+			label[I] = (int)comps.size();
+		}
+		else label[I] = label[label[I]];
+
+		TComponent3D &c = comps[label[I] - 1];
+		c.voxNum++;
+		c.minIdx << min(c.minIdx[0], x), min(c.minIdx[1], y), min(c.minIdx[2], z);
+		c.maxIdx << max(c.maxIdx[0], x), max(c.maxIdx[1], y), max(c.maxIdx[2], z);
+	}
+
+	return (int)comps.size();
+}
+
+
+
+// keep the largest "keepLargestN" components (<=0 : no limit) having at least "minVoxNum" voxels
+// removed components get label 0, survivors are relabeled 1..M in descending order of size
+// return M
+inline int t_labeling3D_Filter
+(
+	const int W, const int H, const int D,
+	int *label,
+	vector<TComponent3D> &comps,
+	const int keepLargestN,
+	const int minVoxNum
+)
+{
+	const int N = (int)comps.size();
+
+	vector<int> order(N);
+	for (int i = 0; i < N; ++i) order[i] = i;
+	stable_sort(order.begin(), order.end(), [&](int a, int b) { return comps[a].voxNum > comps[b].voxNum; });
+
+	//newLabel[old label]
+	vector<int> newLabel(N + 1, 0);
+	vector<TComponent3D> kept;
+	for (int k = 0; k < N; ++k)
+	{
+		const TComponent3D &c = comps[order[k]];
+		if (keepLargestN > 0 && (int)kept.size() >= keepLargestN) break;
+		if (c.voxNum < minVoxNum) break;
+		kept.push_back(c);
+		newLabel[order[k] + 1] = (int)kept.size();
+	}
+
+	const int WHD = W * H * D;
+#pragma omp parallel for
+	for (int i = 0; i < WHD; ++i) label[i] = newLabel[label[i]];
+
+	comps.swap(kept);
+	return (int)comps.size();
+}
@@ -2,6 +2,7 @@
 #define __T_ISOSURF_H_INCLUDED__
 
 #include "tmesh.h"
+#include "tprofile.h"
 
 #include <vector>
 #include <map>
@@ -357,17 +358,31 @@ inline EVec3f getPosZ(const int &x, const int &y, int const &z, const EVec3f &pi
 	return EVec3f((x + 0.5f) * pitch[0], (y + 0.5f) * pitch[1], (z + (float)t + 0.5f) * pitch[2]);
 }
 
+// edge key : unique id of a cell edge in the global sampling cell grid
+// (nx,ny,nz) is the grid node at the lower end of the edge and axis 0:x 1:y 2:z
+inline long long t_MarchingCubes_EdgeKey(const int nx, const int ny, const int nz, const int axis, const int cW, const int cWH)
+{
+	return 3 * ( (long long)nx + (long long)ny * cW + (long long)nz * cWH ) + axis;
+}
+
+
+
+// marching cubes only for sampling cells [cellS, cellE) 
+// generated vertices/polygons are appended to Vs/Ps
+// edge caches are allocated only for the ROI, so this can be called for small blocks repeatedly
+// if edgeKeys != 0, edge key of each generated vertex is also appended  
 template<class T>
-void t_MarchingCubes( 
+void t_MarchingCubes_Cells( 
 	const EVec3i &vRes  ,
 	const EVec3f &vPitch,
 	const T      *vol   ,
 	const T       Thresh,
-	const int    *minIdx, 
-	const int    *maxIdx,
+	const int    *cellS , 
+	const int    *cellE ,
 
-	vector<EVec3f> &Vs,
-	vector<TPoly > &Ps 
+	vector<EVec3f>    &Vs,
+	vector<TPoly >    &Ps,
+	vector<long long> *edgeKeys = 0
 	)
 {
 	struct cellEdgeVtx{ 
@@ -376,39 +391,37 @@ void t_MarchingCubes(
 	};
 
 	//volume resolution
-	const int W = vRes[0], H = vRes[1], D = vRes[2], WH = W*H, WHD = W*H*D;
+	const int W = vRes[0], H = vRes[1], D = vRes[2], WH = W*H;
 	
-	//sampling cell resolution & sampling ROI 
-	const int cW = W + 1, cH = H + 1, cD = D + 1, cWH = cW * cH, cWHD = cW*cH*cD;
-
-	int cellXs = 0, cellXe = W + 1, cellYs = 0, cellYe = H + 1, cellZs = 0, cellZe = D + 1;
+	//sampling cell resolution 
+	const int cW = W + 1, cH = H + 1, cWH = cW * cH;
 
-	if (minIdx != 0 && maxIdx != 0)
-	{
-		cellXs = max( 0, minIdx[0] );  cellXe = min( maxIdx[0] + 2, cellXe );
-		cellYs = max( 0, minIdx[1] );  cellYe = min( maxIdx[1] + 2, cellYe );
-		cellZs = max( 0, minIdx[2] );  cellZe = min( maxIdx[2] + 2, cellZe );
-	}
+	const int cellXs = max( 0, cellS[0] ), cellXe = min( cW + 0, cellE[0] );
+	const int cellYs = max( 0, cellS[1] ), cellYe = min( cH + 0, cellE[1] );
+	const int cellZs = max( 0, cellS[2] ), cellZe = min( D  + 1, cellE[2] );
+	if( cellXs >= cellXe || cellYs >= cellYe || cellZs >= cellZe ) return;
 
-	cellEdgeVtx *edgePiv = new cellEdgeVtx[cWH];
-	cellEdgeVtx *edgeNex = new cellEdgeVtx[cWH];
-	for (int i = 0; i < cWH; ++i) edgePiv[i].Set(-1, -1, -1);
-	for (int i = 0; i < cWH; ++i) edgeNex[i].Set(-1, -1, -1);
+	const size_t psSize0 = Ps.size();
 
+	//edge cache for the ROI (+1 for the far side nodes)
+	const int rW = cellXe - cellXs + 1, rH = cellYe - cellYs + 1, rWH = rW * rH;
 
-	//reserve Vs and Ps 
-	int preCount = 0;
-	for (int i = 0; i < WHD; ++i) if (vol[i] > Thresh) preCount++;
-	Vs.reserve(preCount);
-	Ps.reserve(preCount);
+	cellEdgeVtx *edgePiv = new cellEdgeVtx[rWH];
+	cellEdgeVtx *edgeNex = new cellEdgeVtx[rWH];
+	for (int i = 0; i < rWH; ++i) edgePiv[i].Set(-1, -1, -1);
+	for (int i = 0; i < rWH; ++i) edgeNex[i].Set(-1, -1, -1);
 
+	auto pushV = [&]( const EVec3f &p, const int nx, const int ny, const int nz, const int axis)
+	{
+		if( edgeKeys ) edgeKeys->push_back( t_MarchingCubes_EdgeKey( nx, ny, nz, axis, cW, cWH) );
+		Vs.push_back( p );
+		return (int)Vs.size() - 1;
+	};
 
 	for( int cz = cellZs; cz < cellZe; ++cz)
 	{
 		swap(edgeNex, edgePiv);
-		for (int i = 0; i < cWH; ++i) edgeNex[i].Set(-1, -1, -1);
-
-		if (cz % 50 == 0) fprintf(stderr, "%d/%d done...\n", cz, cellZe - cellZs);
+		for (int i = 0; i < rWH; ++i) edgeNex[i].Set(-1, -1, -1);
 
 		for( int cy = cellYs; cy < cellYe; ++cy)
 		{
@@ -440,31 +453,31 @@ void t_MarchingCubes(
 				short caseFlg = mcEdgeTable[caseID];
 				if ( caseFlg == 0) continue;
 
-				const int eI = cx + cy * cW;
-				if( caseFlg & 1    && edgePiv[eI     ].x < 0) { edgePiv[eI   ].x = (int)Vs.size(); Vs.push_back( getPosX(x,  y, z , vPitch, (Thresh - p[0]) / (p[1] - p[0]) )); }
-				if( caseFlg & 4    && edgeNex[eI     ].x < 0) { edgeNex[eI   ].x = (int)Vs.size(); Vs.push_back( getPosX(x,  y,z+1, vPitch, (Thresh - p[3]) / (p[2] - p[3]) )); }
-				if( caseFlg & 16   && edgePiv[eI  +cW].x < 0) { edgePiv[eI+cW].x = (int)Vs.size(); Vs.push_back( getPosX(x,y+1, z , vPitch, (Thresh - p[4]) / (p[5] - p[4]) )); }
-				if( caseFlg & 64   && edgeNex[eI  +cW].x < 0) { edgeNex[eI+cW].x = (int)Vs.size(); Vs.push_back( getPosX(x,y+1,z+1, vPitch, (Thresh - p[7]) / (p[6] - p[7]) )); }
+				const int eI = (cx - cellXs) + (cy - cellYs) * rW;
+				if( caseFlg & 1    && edgePiv[eI     ].x < 0) edgePiv[eI   ].x = pushV( getPosX(x,  y, z , vPitch, (Thresh - p[0]) / (p[1] - p[0]) ), cx  , cy  , cz  , 0);
+				if( caseFlg & 4    && edgeNex[eI     ].x < 0) edgeNex[eI   ].x = pushV( getPosX(x,  y,z+1, vPitch, (Thresh - p[3]) / (p[2] - p[3]) ), cx  , cy  , cz+1, 0);
+				if( caseFlg & 16   && edgePiv[eI  +rW].x < 0) edgePiv[eI+rW].x = pushV( getPosX(x,y+1, z , vPitch, (Thresh - p[4]) / (p[5] - p[4]) ), cx  , cy+1, cz  , 0);
+				if( caseFlg & 64   && edgeNex[eI  +rW].x < 0) edgeNex[eI+rW].x = pushV( getPosX(x,y+1,z+1, vPitch, (Thresh - p[7]) / (p[6] - p[7]) ), cx  , cy+1, cz+1, 0);
 
-				if (caseFlg & 2    && edgePiv[eI+1   ].z < 0) { edgePiv[eI+1   ].z = (int)Vs.size(); Vs.push_back(getPosZ(x+1, y , z, vPitch, (Thresh - p[1]) / (p[2] - p[1])) ); }
-				if (caseFlg & 8    && edgePiv[eI     ].z < 0) { edgePiv[eI     ].z = (int)Vs.size(); Vs.push_back(getPosZ(x  , y , z, vPitch, (Thresh - p[0]) / (p[3] - p[0])) ); }
-				if (caseFlg & 32   && edgePiv[eI+1+cW].z < 0) { edgePiv[eI+1+cW].z = (int)Vs.size(); Vs.push_back(getPosZ(x+1,y+1, z, vPitch, (Thresh - p[5]) / (p[6] - p[5])) ); }
-				if (caseFlg & 128  && edgePiv[eI  +cW].z < 0) { edgePiv[eI  +cW].z = (int)Vs.size(); Vs.push_back(getPosZ( x ,y+1, z, vPitch, (Thresh - p[4]) / (p[7] - p[4])) ); }
+				if (caseFlg & 2    && edgePiv[eI+1   ].z < 0) edgePiv[eI+1   ].z = pushV( getPosZ(x+1, y , z, vPitch, (Thresh - p[1]) / (p[2] - p[1]) ), cx+1, cy  , cz  , 2);
+				if (caseFlg & 8    && edgePiv[eI     ].z < 0) edgePiv[eI     ].z = pushV( getPosZ(x  , y , z, vPitch, (Thresh - p[0]) / (p[3] - p[0]) ), cx  , cy  , cz  , 2);
+				if (caseFlg & 32   && edgePiv[eI+1+rW].z < 0) edgePiv[eI+1+rW].z = pushV( getPosZ(x+1,y+1, z, vPitch, (Thresh - p[5]) / (p[6] - p[5]) ), cx+1, cy+1, cz  , 2);
+				if (caseFlg & 128  && edgePiv[eI  +rW].z < 0) edgePiv[eI  +rW].z = pushV( getPosZ( x ,y+1, z, vPitch, (Thresh - p[4]) / (p[7] - p[4]) ), cx  , cy+1, cz  , 2);
 
-				if (caseFlg & 256  && edgePiv[eI     ].y < 0) { edgePiv[eI     ].y = (int)Vs.size(); Vs.push_back(getPosY( x ,y, z , vPitch,(Thresh - p[0]) / (p[4] - p[0])) ); }
-				if (caseFlg & 512  && edgePiv[eI+1   ].y < 0) { edgePiv[eI+1   ].y = (int)Vs.size(); Vs.push_back(getPosY(x+1,y, z , vPitch,(Thresh - p[1]) / (p[5] - p[1])) ); }
-				if (caseFlg & 1024 && edgeNex[eI+1   ].y < 0) { edgeNex[eI+1   ].y = (int)Vs.size(); Vs.push_back(getPosY(x+1,y,z+1, vPitch,(Thresh - p[2]) / (p[6] - p[2])) ); }
-				if (caseFlg & 2048 && edgeNex[eI     ].y < 0) { edgeNex[eI     ].y = (int)Vs.size(); Vs.push_back(getPosY( x ,y,z+1, vPitch,(Thresh - p[3]) / (p[7] - p[3])) ); }
+				if (caseFlg & 256  && edgePiv[eI     ].y < 0) edgePiv[eI     ].y = pushV( getPosY( x ,y, z , vPitch, (Thresh - p[0]) / (p[4] - p[0]) ), cx  , cy  , cz  , 1);
+				if (caseFlg & 512  && edgePiv[eI+1   ].y < 0) edgePiv[eI+1   ].y = pushV( getPosY(x+1,y, z , vPitch, (Thresh - p[1]) / (p[5] - p[1]) ), cx+1, cy  , cz  , 1);
+				if (caseFlg & 1024 && edgeNex[eI+1   ].y < 0) edgeNex[eI+1   ].y = pushV( getPosY(x+1,y,z+1, vPitch, (Thresh - p[2]) / (p[6] - p[2]) ), cx+1, cy  , cz+1, 1);
+				if (caseFlg & 2048 && edgeNex[eI     ].y < 0) edgeNex[eI     ].y = pushV( getPosY( x ,y,z+1, vPitch, (Thresh - p[3]) / (p[7] - p[3]) ), cx  , cy  , cz+1, 1);
 
 				int v[12];
 				v[0]  = edgePiv[eI     ].x;
 				v[2]  = edgeNex[eI     ].x;
-				v[4]  = edgePiv[eI + cW].x;
-				v[6]  = edgeNex[eI + cW].x;
+				v[4]  = edgePiv[eI + rW].x;
+				v[6]  = edgeNex[eI + rW].x;
 				v[1]  = edgePiv[eI+1   ].z; 
 				v[3]  = edgePiv[eI     ].z; 
-				v[5]  = edgePiv[eI+1+cW].z;
-				v[7]  = edgePiv[eI  +cW].z; 
+				v[5]  = edgePiv[eI+1+rW].z;
+				v[7]  = edgePiv[eI  +rW].z; 
 				v[8]  = edgePiv[eI     ].y;
 				v[9]  = edgePiv[eI+1   ].y;
 				v[10] = edgeNex[eI+1   ].y;
@@ -479,13 +492,50 @@ void t_MarchingCubes(
 		}
 	}
 
-
-	fprintf( stderr, "Mesh size vtx: %d  polys : %d\n", (int)Vs.size(), (int)Ps.size() );
-	fprintf( stderr, "Initialize surface data...");
-	fprintf( stderr, "done...\n");
-	
 	delete[] edgePiv;
 	delete[] edgeNex;
+
+	TPROF_COUNT(PROF_CELLS_VISITED, (long long)(cellXe - cellXs) * (cellYe - cellYs) * (cellZe - cellZs));
+	TPROF_COUNT(PROF_TRIS_EMITTED , (long long)(Ps.size() - psSize0));
+}
+
+
+
+template<class T>
+void t_MarchingCubes( 
+	const EVec3i &vRes  ,
+	const EVec3f &vPitch,
+	const T      *vol   ,
+	const T       Thresh,
+	const int    *minIdx, 
+	const int    *maxIdx,
+
+	vector<EVec3f> &Vs,
+	vector<TPoly > &Ps 
+	)
+{
+	TPROF_SCOPE("t_MarchingCubes");
+
+	//volume resolution
+	const int W = vRes[0], H = vRes[1], D = vRes[2], WHD = W*H*D;
+	
+	//sampling ROI 
+	int cellS[3] = { 0, 0, 0 }, cellE[3] = { W + 1, H + 1, D + 1 };
+
+	if (minIdx != 0 && maxIdx != 0)
+	{
+		cellS[0] = max( 0, minIdx[0] );  cellE[0] = min( maxIdx[0] + 2, cellE[0] );
+		cellS[1] = max( 0, minIdx[1] );  cellE[1] = min( maxIdx[1] + 2, cellE[1] );
+		cellS[2] = max( 0, minIdx[2] );  cellE[2] = min( maxIdx[2] + 2, cellE[2] );
+	}
+
+	//reserve Vs and Ps 
+	int preCount = 0;
+	for (int i = 0; i < WHD; ++i) if (vol[i] > Thresh) preCount++;
+	Vs.reserve(preCount);
+	Ps.reserve(preCount);
+
+	t_MarchingCubes_Cells<T>( vRes, vPitch, vol, Thresh, cellS, cellE, Vs, Ps);
 }
 
 
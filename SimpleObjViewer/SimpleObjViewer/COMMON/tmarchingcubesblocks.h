@@ -0,0 +1,456 @@
+#pragma once
+
+#include "tmarchingcubes.h"
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * Block partitioned iso-surface for incremental re-meshing
+ *
+ * The sampling cell grid of t_MarchingCubes ((W+1)x(H+1)x(D+1) cells) is split
+ * into blocks of B^3 cells and each block keeps its own Vs/Ps.
+ * After the volume is edited, Update() re-extracts only the blocks
+ * touched by the edited bounding box and replaces their triangles.
+ * getMesh() welds the blocks into one TMesh on the first call (vertices shared by
+ * neighboring blocks are found through their edge keys) and keeps it : each block knows
+ * its vertices / faces in that mesh, so Update() removes the old ones of the re-extracted
+ * blocks (the last vertex / face is moved into each hole), appends the new ones and
+ * updates the rings and normals of the touched vertices only.
+ *
+ * usage
+ *   TMarchingCubesBlocks<byte> iso;
+ *   iso.Initialize( vRes, vPitch, vol, 128);
+ *   const TMesh &mesh = iso.getMesh();
+ *   ... edit vol in [minIdx, maxIdx] ...
+ *   iso.Update( vol, minIdx, maxIdx); // mesh is up to date
+-------------------------------------------------------------------*/
+
+template<class T>
+class TMarchingCubesBlocks
+{
+	class Block
+	{
+	public:
+		vector<EVec3f>    Vs;
+		vector<TPoly >    Ps;
+		vector<int>       sharedIdx; // vertices on block boundary faces
+		vector<long long> sharedKey; // and their edge keys
+		vector<int>       gV, gP   ; // vertices (not shared) and faces of the block in m_mesh
+	};
+
+	EVec3i m_vRes  ;
+	EVec3f m_vPitch;
+	T      m_thresh;
+	int    m_B     ; //block size (in cells)
+	EVec3i m_bRes  ; //number of blocks
+	vector<Block> m_blocks;
+
+	//welded mesh, built by getMesh and then patched by Update
+	TMesh             m_mesh  ;
+	bool              m_bMesh ;
+	int               m_vCap, m_pCap;   // allocated sizes of the m_mesh arrays (>= m_vSize, m_pSize)
+	vector<int>       m_vBlock, m_vPos; // block of each vertex (-1 : shared) and its index in gV
+	vector<long long> m_vKey  ;         // edge key of each shared vertex
+	vector<int>       m_pBlock, m_pPos; // block of each face and its index in gP
+	unordered_map<long long, pair<int, int>> m_shared; // edge key -> (vertex, number of blocks using it)
+
+public:
+	TMarchingCubesBlocks()
+	{
+		m_vRes   << 0, 0, 0;
+		m_vPitch << 1, 1, 1;
+		m_bRes   << 0, 0, 0;
+		m_thresh = 0;
+		m_B      = 16;
+		m_bMesh  = false;
+		m_vCap   = m_pCap = 0;
+	}
+
+	void clear()
+	{
+		m_blocks.clear();
+		m_vRes << 0, 0, 0;
+		m_bRes << 0, 0, 0;
+		clearMesh();
+	}
+
+	int getBlockNum() const { return (int)m_blocks.size(); }
+	T   getThresh  () const { return m_thresh; }
+
+
+
+	void Initialize(
+		const EVec3i &vRes  ,
+		const EVec3f &vPitch,
+		const T      *vol   ,
+		const T       Thresh,
+		const int     blockSize = 16)
+	{
+		m_vRes   = vRes;
+		m_vPitch = vPitch;
+		m_thresh = Thresh;
+		m_B      = max( 2, blockSize);
+		m_bRes   << (vRes[0] + 1 + m_B - 1) / m_B,
+		            (vRes[1] + 1 + m_B - 1) / m_B,
+		            (vRes[2] + 1 + m_B - 1) / m_B;
+
+		m_blocks.clear();
+		m_blocks.resize( m_bRes[0] * m_bRes[1] * m_bRes[2] );
+		clearMesh();
+
+		vector<int> all( m_blocks.size() );
+		for( int i = 0; i < (int)all.size(); ++i ) all[i] = i;
+		extractBlocks( vol, all );
+	}
+
+
+
+	// re-extract iso-surface after voxels in [minIdx, maxIdx] (inclusive) were modified
+	// return number of re-extracted blocks
+	int Update(const T *vol, const int *minIdx, const int *maxIdx)
+	{
+		if( m_blocks.empty() ) return 0;
+
+		//voxel x is sampled by cells x and x+1
+		int bS[3], bE[3];
+		for( int i = 0; i < 3; ++i )
+		{
+			bS[i] = max( 0          , minIdx[i]     ) / m_B;
+			bE[i] = min( m_vRes[i]  , maxIdx[i] + 1 ) / m_B;
+			bE[i] = min( m_bRes[i] - 1, bE[i] );
+		}
+
+		vector<int> dirty;
+		for( int bz = bS[2]; bz <= bE[2]; ++bz )
+		for( int by = bS[1]; by <= bE[1]; ++by )
+		for( int bx = bS[0]; bx <= bE[0]; ++bx ) dirty.push_back( bx + by * m_bRes[0] + bz * m_bRes[0] * m_bRes[1] );
+
+		vector<vector<long long>> oldKeys( m_bMesh ? dirty.size() : 0 );
+		for( int k = 0; k < (int)oldKeys.size(); ++k ) oldKeys[k].swap( m_blocks[dirty[k]].sharedKey );
+
+		extractBlocks( vol, dirty );
+		if( m_bMesh ) patchMesh( dirty, oldKeys );
+		return (int)dirty.size();
+	}
+
+
+
+	// re-extract all blocks with a new threshold (the mesh is welded again by the next getMesh)
+	void SetThresh(const T *vol, const T Thresh)
+	{
+		m_thresh = Thresh;
+		vector<int> all( m_blocks.size() );
+		for( int i = 0; i < (int)all.size(); ++i ) all[i] = i;
+		extractBlocks( vol, all );
+		clearMesh();
+	}
+
+
+
+	// the welded mesh of all blocks, kept up to date by Update
+	const TMesh &getMesh()
+	{
+		if( !m_bMesh ) buildMesh();
+		return m_mesh;
+	}
+
+
+
+private:
+	void clearMesh()
+	{
+		m_mesh.clear();
+		m_bMesh = false;
+		m_vCap  = m_pCap = 0;
+		m_vBlock.clear(); m_vPos.clear(); m_vKey.clear();
+		m_pBlock.clear(); m_pPos.clear();
+		m_shared.clear();
+		for( auto &b : m_blocks ) { b.gV.clear(); b.gP.clear(); }
+	}
+
+	int pushVertex(const int bI, const int pos, const long long key)
+	{
+		m_vBlock.push_back( bI  );
+		m_vPos  .push_back( pos );
+		m_vKey  .push_back( key );
+		return (int)m_vBlock.size() - 1;
+	}
+
+	int pushFace(const int bI, const int pos)
+	{
+		m_pBlock.push_back( bI  );
+		m_pPos  .push_back( pos );
+		return (int)m_pBlock.size() - 1;
+	}
+
+	// concatenate all blocks, vertices on block boundaries are welded by their edge keys
+	void buildMesh()
+	{
+		clearMesh();
+		int vNum = 0, pNum = 0;
+		for( const auto &b : m_blocks ) { vNum += (int)b.Vs.size(); pNum += (int)b.Ps.size(); }
+
+		vector<EVec3f> Vs; Vs.reserve( vNum );
+		vector<TPoly > Ps; Ps.reserve( pNum );
+		vector<int> newIdx;
+
+		for( int bI = 0; bI < (int)m_blocks.size(); ++bI )
+		{
+			Block &b = m_blocks[bI];
+			if( b.Vs.empty() ) continue;
+			newIdx.assign( b.Vs.size(), -1 );
+
+			for( int k = 0; k < (int)b.sharedIdx.size(); ++k )
+			{
+				auto it = m_shared.find( b.sharedKey[k] );
+				if( it != m_shared.end() ) { ++it->second.second; newIdx[b.sharedIdx[k]] = it->second.first; continue; }
+				newIdx[b.sharedIdx[k]] = pushVertex( -1, -1, b.sharedKey[k] );
+				m_shared[ b.sharedKey[k] ] = make_pair( newIdx[b.sharedIdx[k]], 1 );
+				Vs.push_back( b.Vs[b.sharedIdx[k]] );
+			}
+
+			for( int i = 0; i < (int)b.Vs.size(); ++i )
+			{
+				if( newIdx[i] >= 0 ) continue;
+				newIdx[i] = pushVertex( bI, (int)b.gV.size(), -1 );
+				b.gV.push_back( newIdx[i] );
+				Vs.push_back( b.Vs[i] );
+			}
+
+			for( const auto &p : b.Ps )
+			{
+				b.gP.push_back( pushFace( bI, (int)b.gP.size() ) );
+				Ps.push_back( TPoly( newIdx[p.idx[0]], newIdx[p.idx[1]], newIdx[p.idx[2]] ) );
+			}
+		}
+
+		m_mesh.initialize( Vs, Ps );
+		for( int i = 0; i < m_mesh.m_vSize; ++i ) m_mesh.m_vTexCd[i] << 0, 0, 0;
+		m_vCap  = m_mesh.m_vSize;
+		m_pCap  = m_mesh.m_pSize;
+		m_bMesh = true;
+	}
+
+	// make room for vSize vertices and pSize faces, m_vSize / m_pSize are kept
+	void reserveMesh(const int vSize, const int pSize)
+	{
+		if( vSize <= m_vCap && pSize <= m_pCap ) return;
+		const int vN = m_mesh.m_vSize, pN = m_mesh.m_pSize;
+		m_vCap = max( m_vCap, vSize + vSize / 2 );
+		m_pCap = max( m_pCap, pSize + pSize / 2 );
+		m_mesh.resize( m_vCap, m_pCap );
+		m_mesh.m_vSize = vN;
+		m_mesh.m_pSize = pN;
+	}
+
+	// replace the faces / vertices of the re-extracted blocks in m_mesh
+	// (oldKeys : shared edge keys of each dirty block before the extraction)
+	void patchMesh(const vector<int> &dirty, const vector<vector<long long>> &oldKeys)
+	{
+		TMesh &M = m_mesh;
+		vector<int> cand; // vertices whose rings / normals are recomputed
+
+		//remove the faces, the last face is moved into each hole (descending, so it is never a removed one)
+		vector<int> rmP;
+		for( const int bI : dirty ) { rmP.insert( rmP.end(), m_blocks[bI].gP.begin(), m_blocks[bI].gP.end() ); m_blocks[bI].gP.clear(); }
+		for( const int f : rmP )
+			for( int k = 0; k < 3; ++k )
+			{
+				vector<int> &r = M.m_vRingPs[ M.m_pPolys[f].idx[k] ];
+				r.erase( find( r.begin(), r.end(), f ) );
+				cand.push_back( M.m_pPolys[f].idx[k] );
+			}
+		sort( rmP.begin(), rmP.end(), greater<int>() );
+		for( const int f : rmP )
+		{
+			const int last = --M.m_pSize;
+			if( f != last )
+			{
+				M.m_pPolys[f] = M.m_pPolys[last];
+				M.m_pNorms[f] = M.m_pNorms[last];
+				for( int k = 0; k < 3; ++k )
+				{
+					vector<int> &r = M.m_vRingPs[ M.m_pPolys[f].idx[k] ];
+					replace( r.begin(), r.end(), last, f );
+					cand.push_back( M.m_pPolys[f].idx[k] );
+				}
+				m_pBlock[f] = m_pBlock[last];
+				m_pPos  [f] = m_pPos  [last];
+				m_blocks[ m_pBlock[f] ].gP[ m_pPos[f] ] = f;
+			}
+			m_pBlock.pop_back();
+			m_pPos  .pop_back();
+		}
+
+		//shared vertices : references of the old and the new extraction
+		for( const auto &keys : oldKeys ) for( const long long key : keys ) --m_shared[key].second;
+		for( const int bI : dirty )
+			for( const long long key : m_blocks[bI].sharedKey )
+			{
+				auto it = m_shared.find( key );
+				if( it == m_shared.end() ) m_shared[key] = make_pair( -1, 1 );
+				else ++it->second.second;
+			}
+
+		//remove the old vertices of the blocks and the shared ones no block uses any more (they have no faces left)
+		vector<int> rmV;
+		for( const int bI : dirty ) { rmV.insert( rmV.end(), m_blocks[bI].gV.begin(), m_blocks[bI].gV.end() ); m_blocks[bI].gV.clear(); }
+		for( const auto &keys : oldKeys )
+			for( const long long key : keys )
+			{
+				auto it = m_shared.find( key );
+				if( it == m_shared.end() || it->second.second != 0 ) continue;
+				rmV.push_back( it->second.first );
+				m_shared.erase( it );
+			}
+		sort( rmV.begin(), rmV.end(), greater<int>() );
+		for( const int v : rmV )
+		{
+			const int last = --M.m_vSize;
+			M.m_vRingPs[v].clear();
+			M.m_vRingVs[v].clear();
+			if( v != last )
+			{
+				M.m_vVerts[v] = M.m_vVerts[last];
+				M.m_vNorms[v] = M.m_vNorms[last];
+				M.m_vTexCd[v] = M.m_vTexCd[last];
+				M.m_vRingPs[v].swap( M.m_vRingPs[last] );
+				M.m_vRingVs[v].swap( M.m_vRingVs[last] );
+				for( const int f : M.m_vRingPs[v] )
+					for( int k = 0; k < 3; ++k )
+					{
+						int &i = M.m_pPolys[f].idx[k];
+						if( i == last ) i = v;
+						cand.push_back( i );
+					}
+				m_vBlock[v] = m_vBlock[last];
+				m_vPos  [v] = m_vPos  [last];
+				m_vKey  [v] = m_vKey  [last];
+				if( m_vBlock[v] >= 0 ) m_blocks[ m_vBlock[v] ].gV[ m_vPos[v] ] = v;
+				else                   m_shared[ m_vKey[v] ].first = v;
+			}
+			m_vBlock.pop_back();
+			m_vPos  .pop_back();
+			m_vKey  .pop_back();
+		}
+
+		//append the new vertices and faces
+		int vNew = 0, pNew = 0;
+		for( const int bI : dirty ) { vNew += (int)m_blocks[bI].Vs.size(); pNew += (int)m_blocks[bI].Ps.size(); }
+		reserveMesh( M.m_vSize + vNew, M.m_pSize + pNew );
+
+		const int pSize0 = M.m_pSize;
+		vector<int> newIdx;
+		for( const int bI : dirty )
+		{
+			Block &b = m_blocks[bI];
+			newIdx.assign( b.Vs.size(), -1 );
+			for( int k = 0; k < (int)b.sharedIdx.size(); ++k )
+			{
+				pair<int, int> &s = m_shared[ b.sharedKey[k] ];
+				if( s.first < 0 ) s.first = pushVertex( -1, -1, b.sharedKey[k] );
+				newIdx[b.sharedIdx[k]] = s.first;
+			}
+			for( int i = 0; i < (int)b.Vs.size(); ++i )
+			{
+				if( newIdx[i] < 0 ) { newIdx[i] = pushVertex( bI, (int)b.gV.size(), -1 ); b.gV.push_back( newIdx[i] ); }
+				M.m_vVerts[ newIdx[i] ] = b.Vs[i];
+				cand.push_back( newIdx[i] );
+			}
+			for( ; M.m_vSize < (int)m_vBlock.size(); ++M.m_vSize )
+			{
+				M.m_vTexCd [M.m_vSize] << 0, 0, 0;
+				M.m_vRingPs[M.m_vSize].clear();
+				M.m_vRingVs[M.m_vSize].clear();
+			}
+
+			for( const auto &p : b.Ps )
+			{
+				const int f = pushFace( bI, (int)b.gP.size() );
+				b.gP.push_back( f );
+				M.m_pPolys[f] = TPoly( newIdx[p.idx[0]], newIdx[p.idx[1]], newIdx[p.idx[2]] );
+				for( int k = 0; k < 3; ++k ) M.m_vRingPs[ M.m_pPolys[f].idx[k] ].push_back( f );
+			}
+			M.m_pSize = (int)m_pBlock.size();
+		}
+
+		//rings and normals of the touched vertices (as TMesh::subdivideFaces)
+		sort( cand.begin(), cand.end() );
+		cand.erase( unique( cand.begin(), cand.end() ), cand.end() );
+		while( !cand.empty() && cand.back() >= M.m_vSize ) cand.pop_back();
+
+#pragma omp parallel for
+		for( int f = pSize0; f < M.m_pSize; ++f )
+		{
+			const int *idx = M.m_pPolys[f].idx;
+			M.m_pNorms[f] = ( M.m_vVerts[ idx[1] ] - M.m_vVerts[ idx[0] ] ).cross( M.m_vVerts[idx[2]] - M.m_vVerts[idx[0]] ).normalized();
+		}
+
+#pragma omp parallel for
+		for( int a = 0; a < (int)cand.size(); ++a )
+		{
+			const int v = cand[a];
+			vector<int> &rPs = M.m_vRingPs[v], &rVs = M.m_vRingVs[v];
+			sort( rPs.begin(), rPs.end() );
+
+			rVs.clear();
+			EVec3f n(0, 0, 0);
+			for( const auto &f : rPs )
+			{
+				n += M.m_pNorms[f];
+				for( int k = 0; k < 3; ++k ) if( M.m_pPolys[f].idx[k] != v ) rVs.push_back( M.m_pPolys[f].idx[k] );
+			}
+			sort( rVs.begin(), rVs.end() );
+			rVs.erase( unique( rVs.begin(), rVs.end() ), rVs.end() );
+			M.m_vNorms[v] = n.normalized();
+		}
+
+		M.m_smoother.clear();
+		M.m_fairing .reset();
+		M.m_hEdges  .clear();
+	}
+
+	void extractBlocks(const T *vol, const vector<int> &blockIds )
+	{
+		const int cW = m_vRes[0] + 1, cWH = (m_vRes[0] + 1) * (m_vRes[1] + 1);
+		const int B  = m_B;
+		const int bW = m_bRes[0], bWH = m_bRes[0] * m_bRes[1];
+
+#pragma omp parallel for schedule(dynamic)
+		for( int k = 0; k < (int)blockIds.size(); ++k )
+		{
+			const int bI = blockIds[k];
+			const int bz = bI / bWH, by = (bI - bz * bWH) / bW, bx = bI - bz * bWH - by * bW;
+			const int cellS[3] = { bx * B, by * B, bz * B };
+			const int cellE[3] = { cellS[0] + B, cellS[1] + B, cellS[2] + B };
+
+			Block &b = m_blocks[bI];
+			b.Vs.clear();
+			b.Ps.clear();
+			b.sharedIdx.clear();
+			b.sharedKey.clear();
+
+			vector<long long> keys;
+			t_MarchingCubes_Cells<T>( m_vRes, m_vPitch, vol, m_thresh, cellS, cellE, b.Vs, b.Ps, &keys);
+
+			//an edge is shared with neighbor blocks if it lies on a block boundary plane
+			for( int i = 0; i < (int)keys.size(); ++i )
+			{
+				const long long e = keys[i] / 3;
+				const int axis = (int)( keys[i] % 3 );
+				const int nz = (int)( e / cWH ), ny = (int)( (e % cWH) / cW ), nx = (int)( e % cW );
+				const bool bShared = (axis != 0 && nx % B == 0) ||
+				                     (axis != 1 && ny % B == 0) ||
+				                     (axis != 2 && nz % B == 0);
+				if( !bShared ) continue;
+				b.sharedIdx.push_back( i );
+				b.sharedKey.push_back( keys[i] );
+			}
+		}
+	}
+};
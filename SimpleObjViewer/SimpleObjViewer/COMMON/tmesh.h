@@ -2,9 +2,28 @@
 
 #include <list>
 #include <vector>
+#include <memory>
 #include "tmath.h"
+#include "tmeshsmoothing.h"
+#include "thalfedge.h"
+#include "tprofile.h"
 using namespace std;
 
+//the members using the heavier engines are defined in their headers, include the one you call :
+//implicitFairing (tmeshfairing.h, Eigen sparse solvers), decimate (tmeshdecimation.h),
+//subdivide / subdivideFaces (tmeshsubdiv.h), reorder (tmeshreorder.h), initializeSphere etc. / addNoise (tmeshgen.h)
+class TMeshFairing;
+enum  TFairingSolver : int;
+enum  TSubdivMode    : int;
+enum  TVertexOrder   : int;
+
+//headless builds (no OpenGL / MFC) define TMESH_NO_GL, which removes draw()
+#ifndef _WIN32
+#include <strings.h>
+#define stricmp strcasecmp
+#define _strdup strdup
+#endif
+
 
 #pragma warning(disable : 4996)
 
@@ -53,6 +72,14 @@ public:
 	EVec3f      *m_pNorms ;
 	TPoly       *m_pPolys ;
 
+	//half-edge table (ordered adjacency, built by getHalfEdges, cleared when the topology changes)
+	THalfEdges   m_hEdges ;
+
+	//smoothing engine (CSR one ring + SoA scratch, rebuilt when the topology changes)
+	TMeshSmoother m_smoother;
+	//implicit fairing (cached factorization, created by implicitFairing, released when the topology changes)
+	shared_ptr<TMeshFairing> m_fairing;
+
 	TMesh()
 	{
 		m_vSize   = 0;
@@ -89,6 +116,9 @@ public:
 		m_pPolys  = 0;
 		m_vRingPs = 0;
 		m_vRingVs = 0;
+		m_smoother.clear();
+		m_fairing .reset();
+		m_hEdges  .clear();
 	}
 
 
@@ -111,8 +141,8 @@ public:
 			m_vRingPs = new vector<int>[m_vSize];
 			for (int i = 0; i < m_vSize; ++i)
 			{
-				for (const auto &k : m_vRingVs[i]) m_vRingVs[i].push_back(k);
-				for (const auto &k : m_vRingPs[i]) m_vRingPs[i].push_back(k);
+				m_vRingVs[i] = v.m_vRingVs[i];
+				m_vRingPs[i] = v.m_vRingPs[i];
 			}
 		}
 
@@ -159,6 +189,7 @@ public:
 
 	bool initialize(const char *fName)
 	{	
+		TPROF_SCOPE("TMesh::initialize(obj)");
 
 		FILE* fp = fopen(fName,"r") ;
 		if( !fp ) return false;
@@ -218,7 +249,7 @@ public:
 			for ( int i = 0; i < m_vSize; ++i ) m_vTexCd[i] << Ts[i][0], Ts[i][1], 0;	
 		}
 
-		fprintf(stderr, "loaded object file info : %d %d \n", m_vSize, m_pSize);
+		TPROF_LOG("loaded object file info : %d %d \n", m_vSize, m_pSize);
 		return true;
 	}
 
@@ -239,11 +270,11 @@ private:
 
 
 public:
-	void initialize( const vector<EVec3f> &Vs, const vector<TPoly> &Ps )
+	//clear and allocate all arrays for vSize vertices and pSize faces (contents are left uninitialized)
+	void allocate(const int vSize, const int pSize)
 	{
 		clear();
-		
-		m_vSize = (int)Vs.size();
+		m_vSize = vSize;
 		if( m_vSize != 0 )
 		{
 			m_vVerts  = new EVec3f[m_vSize];
@@ -251,60 +282,139 @@ public:
 			m_vTexCd  = new EVec3f[m_vSize];
 			m_vRingVs = new vector<int>[m_vSize];
 			m_vRingPs = new vector<int>[m_vSize];
-			for ( int i = 0; i < m_vSize; ++i ) m_vVerts[i] = Vs[i];
 		}
 
-		m_pSize   = (int)Ps.size();
-		if (m_pSize != 0)
+		m_pSize = pSize;
+		if( m_pSize != 0 )
 		{
 			m_pPolys  = new TPoly [m_pSize];
 			m_pNorms  = new EVec3f[m_pSize];
-			for ( int i = 0; i < m_pSize; ++i ) m_pPolys [i] = Ps [i];
 		}
+	}
+
+	//resize all arrays to vSize / pSize, the first min(old, new) entries are kept
+	void resize(const int vSize, const int pSize)
+	{
+		const int vN = min(vSize, m_vSize), pN = min(pSize, m_pSize);
+
+		EVec3f      *Vs = new EVec3f[vSize], *Ns = new EVec3f[vSize], *Ts = new EVec3f[vSize];
+		vector<int> *Rv = new vector<int>[vSize], *Rp = new vector<int>[vSize];
+#pragma omp parallel for
+		for( int i=0; i < vN; ++i)
+		{
+			Vs[i] = m_vVerts[i];
+			Ns[i] = m_vNorms[i];
+			Ts[i] = m_vTexCd[i];
+			Rv[i].swap(m_vRingVs[i]);
+			Rp[i].swap(m_vRingPs[i]);
+		}
+
+		TPoly  *Ps = new TPoly [pSize];
+		EVec3f *Pn = new EVec3f[pSize];
+#pragma omp parallel for
+		for( int i=0; i < pN; ++i)
+		{
+			Ps[i] = m_pPolys[i];
+			Pn[i] = m_pNorms[i];
+		}
+
+		m_hEdges.clear();
+		delete[] m_vVerts ; m_vVerts  = Vs;
+		delete[] m_vNorms ; m_vNorms  = Ns;
+		delete[] m_vTexCd ; m_vTexCd  = Ts;
+		delete[] m_vRingVs; m_vRingVs = Rv;
+		delete[] m_vRingPs; m_vRingPs = Rp;
+		delete[] m_pPolys ; m_pPolys  = Ps;
+		delete[] m_pNorms ; m_pNorms  = Pn;
+		m_vSize = vSize;
+		m_pSize = pSize;
+	}
+
+	void initialize( const vector<EVec3f> &Vs, const vector<TPoly> &Ps )
+	{
+		allocate( (int)Vs.size(), (int)Ps.size() );
+		for ( int i = 0; i < m_vSize; ++i ) m_vVerts[i] = Vs[i];
+		for ( int i = 0; i < m_pSize; ++i ) m_pPolys[i] = Ps[i];
 
 		updateNormal();
 		updateRingInfo();
 
 
-		//for debug
-		fprintf( stderr, "check data\n");
+#ifdef _DEBUG
 		for (int i = 0; i < m_pSize; ++i)
 		{
 			int *idx = m_pPolys[i].idx;
-			if( idx[0] < 0 || idx[0] >= m_vSize ) fprintf( stderr, "aaaaaaa");
-			if( idx[1] < 0 || idx[1] >= m_vSize ) fprintf( stderr, "bbbbbb");
-			if( idx[2] < 0 || idx[2] >= m_vSize ) fprintf( stderr, "cccccc");
-
+			if( idx[0] < 0 || idx[0] >= m_vSize || idx[1] < 0 || idx[1] >= m_vSize || idx[2] < 0 || idx[2] >= m_vSize )
+				fprintf( stderr, "TMesh::initialize : polygon %d has an invalid vertex index\n", i);
 		}
-
+#endif
 	}
 
 
 
+	//replace each vertex by the average of its one ring, n times
 	void smoothing(int n)
 	{
-		EVec3f *vs = new EVec3f[m_vSize];
-		
-		for (int k = 0; k < n; ++k)
-		{
-#pragma omp parallel for
-			for( int i=0; i < m_vSize; ++i)
-			{
-				vs[i] << 0,0,0;
-				for( const auto &it : m_vRingVs[i] ) vs[i] += m_vVerts[it];
-				vs[i] /= (float)m_vRingVs[i].size();
-			}
-			swap( vs, m_vVerts );
+		smoothing(n, SMOOTH_UNIFORM, 1.0f);
+	}
 
-		}
-		delete[] vs;
+	//SMOOTH_UNIFORM / SMOOTH_COTANGENT : n steps of p += lambda * L p
+	//SMOOTH_TAUBIN : n pairs of steps with lambda (>0) and mu (<-lambda)
+	void smoothing(int n, TSmoothMode mode, float lambda = 0.5f, float mu = -0.53f)
+	{
+		if( m_vSize == 0 || n <= 0 ) return;
+		TPROF_SCOPE("TMesh::smoothing");
+
+		if( !m_smoother.isBuilt(m_vSize) ) m_smoother.Build(m_vSize, m_vRingVs);
+		m_smoother.UpdateWeights(m_vVerts, m_vRingPs, (const int*)m_pPolys, mode == SMOOTH_COTANGENT);
+		m_smoother.Smooth(m_vVerts, n, lambda, mode == SMOOTH_TAUBIN ? mu : 0.0f);
 		updateNormal();
 	}
 
+	//implicit fairing : solve (I + lambda L) x = x0 (SMOOTH_UNIFORM or SMOOTH_COTANGENT weights)
+	//the factorization is reused while lambda, mode and solver are unchanged
+	//(tmeshfairing.h, mode = SMOOTH_UNIFORM, solver = FAIR_AUTO)
+	bool implicitFairing(float lambda, TSmoothMode mode, TFairingSolver solver);
+
+
+
+	//QEM edge collapse decimation down to targetPSize faces (or until a collapse costs more than maxError)
+	//m_vTexCd is interpolated, vertices not used by any face are removed (tmeshdecimation.h, maxError = DBL_MAX)
+	void decimate(int targetPSize, double maxError);
+
+
+
+	//uniform subdivision, every face -> 4 (SUBDIV_MIDPOINT or SUBDIV_LOOP, tmeshsubdiv.h, mode = SUBDIV_LOOP)
+	//face f becomes the faces 4f .. 4f+3, the ring info and the normals are rebuilt
+	void subdivide(TSubdivMode mode);
+
+	//adaptive (red-green, midpoint) subdivision of the given faces (e.g. the faces inside an exp map radius)
+	//faces keep their indices and the new faces are appended, so only the one ring / normals of
+	//the vertices of the refined faces are updated (tmeshsubdiv.h)
+	void subdivideFaces(const vector<int> &faces);
+
+
+
+	//reorder vertices (space filling curve / RCM) and faces (Forsyth) for memory locality
+	//all arrays are permuted and the one ring / half-edge / smoothing / fairing data are rebuilt
+	//vNewIdx, pNewIdx : new index of each old vertex / face (for external data)
+	//(tmeshreorder.h, vOrder = VORDER_HILBERT, bFaceOrder = true, vNewIdx = pNewIdx = 0)
+	void reorder(TVertexOrder vOrder, bool bFaceOrder, vector<int> *vNewIdx, vector<int> *pNewIdx);
+
+
+
+	//half-edge table of the current faces, built on the first call after a topology change
+	const THalfEdges &getHalfEdges()
+	{
+		if( !m_hEdges.isBuilt() ) m_hEdges.Build( m_vSize, m_pSize, (const int*)m_pPolys );
+		return m_hEdges;
+	}
+
 
 
 	void updateNormal()
 	{
+		TPROF_SCOPE("TMesh::updateNormal");
 #pragma omp parallel for
 		for( int i=0; i < m_vSize; ++i) m_vNorms[i].setZero();
 
@@ -326,6 +436,10 @@ public:
 
 	void updateRingInfo()
 	{
+		TPROF_SCOPE("TMesh::updateRingInfo");
+		m_smoother.clear();
+		m_fairing .reset();
+		m_hEdges  .clear();
 		for (int i = 0; i < m_vSize; ++i) m_vRingPs[i].clear();
 		for (int i = 0; i < m_vSize; ++i) m_vRingVs[i].clear();
 
@@ -350,6 +464,47 @@ public:
 			m_vRingVs[i].erase( it, m_vRingVs[i].end());
 		}
 	}
+
+	//the same lists as updateRingInfo, for the generated meshes (initializeSphere etc.) : the face corners are
+	//bucketed per vertex in one pass (ascending face order), then each vertex fills exactly sized lists in parallel
+	void updateRingInfoParallel()
+	{
+		TPROF_SCOPE("TMesh::updateRingInfoParallel");
+		m_smoother.clear();
+		m_fairing .reset();
+		m_hEdges  .clear();
+
+		//corner[offset[v]..offset[v+1]) : corners (3 * face + k) at vertex v
+		const int  *P = (const int*)m_pPolys;
+		vector<int> offset(m_vSize + 1, 0), corner(3 * (size_t)m_pSize);
+		for( int i=0; i < 3 * m_pSize; ++i) ++offset[ P[i] + 1 ];
+		for( int i=0; i < m_vSize; ++i) offset[i+1] += offset[i];
+		{
+			vector<int> pos(offset.begin(), offset.end() - 1);
+			for( int i=0; i < 3 * m_pSize; ++i) corner[ pos[P[i]]++ ] = i;
+		}
+
+#pragma omp parallel
+		{
+			vector<int> vs; //sorted into a scratch, so that m_vRingVs[i] gets its exact size
+#pragma omp for schedule(dynamic, 1024)
+			for( int i=0; i < m_vSize; ++i)
+			{
+				const int *c = corner.data() + offset[i], n = offset[i+1] - offset[i];
+				m_vRingPs[i].resize(n);
+				vs.resize(2 * n);
+				for( int j=0; j < n; ++j)
+				{
+					const int f = c[j] / 3, k = c[j] % 3;
+					m_vRingPs[i][j] = f;
+					vs[2*j    ]     = P[3*f + (k == 0 ? 1 : 0)];
+					vs[2*j + 1]     = P[3*f + (k == 2 ? 1 : 2)];
+				}
+				sort(vs.begin(), vs.end());
+				m_vRingVs[i].assign( vs.begin(), unique(vs.begin(), vs.end()) );
+			}
+		}
+	}
 		
 	void Translate(const EVec3f t         ) { for( int i=0; i < m_vSize; ++i ) m_vVerts[i] += t;			  }
 	void Scale    (const float  s         ) { for( int i=0; i < m_vSize; ++i ) m_vVerts[i] *= s;			  }
@@ -416,6 +571,7 @@ public:
 		*/
 	}
 
+#ifndef TMESH_NO_GL
 	void draw() const 
 	{
 			checkError();
@@ -453,6 +609,27 @@ public:
 		glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, shin);
 		draw();
 	}
+#endif
+
+
+
+	//texture coordinates (u,v) of m_vTexCd are written as one vt per vertex
+	bool exportObj(const char *fname) const
+	{
+		FILE* fp = fopen(fname, "w") ;
+		if( !fp ) return false;
+
+		fprintf(fp,"#Obj exported from tmesh\n") ;
+		for( int i=0;i<m_vSize; ++i ) fprintf(fp,"v %f %f %f\n", m_vVerts[i][0], m_vVerts[i][1], m_vVerts[i][2]) ;
+		for( int i=0;i<m_vSize; ++i ) fprintf(fp,"vt %f %f\n"  , m_vTexCd[i][0], m_vTexCd[i][1]) ;
+		for( int i=0;i<m_pSize; ++i )
+		{
+			const int *p = m_pPolys[i].idx;
+			fprintf(fp,"f %d/%d %d/%d %d/%d\n", p[0] + 1, p[0] + 1, p[1] + 1, p[1] + 1, p[2] + 1, p[2] + 1) ;
+		}
+		fclose(fp) ;
+		return true;
+	}
 
 
 
@@ -523,10 +700,18 @@ public:
 	}
 
 
-	void initializeSphere(const double r, const int M, const int N)
-	{
-		//todo
-	}
+	//parametric meshes (tmeshgen.h), m_vTexCd holds the surface parameters (u,v,0)
+	//one core : geo9 (5.2M faces) 0.5-0.8 s of which t_genGeodesicSphere is 0.17 s, a 10M face torus 1.0-1.8 s.
+	//Most of the rest is the ring info, one allocation per vertex for each of m_vRingPs and m_vRingVs
+	//initializeGeodesicSphere : icosahedron subdivided "level" times on the sphere (20 * 4^level faces, level 10 : 20M faces)
+	void initializeSphere        (const double r, const int M, const int N);
+	void initializeGeodesicSphere(const double r, const int level);
+	void initializeTorus         (const double R, const double r, const int M, const int N);
+	void initializePlane         (const double w, const double h, const int M, const int N);
+	void initializeCylinder      (const double r, const double h, const int M, const int N);
+
+	//move each vertex along its normal by amp * (smooth noise of frequency freq in [-1,1]) (tmeshgen.h, seed = 0)
+	void addNoise(const float amp, const float freq, const unsigned int seed);
 
 
 
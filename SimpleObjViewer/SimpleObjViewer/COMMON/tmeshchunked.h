@@ -0,0 +1,459 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "tmesh.h"
+
+using namespace std;
+
+#ifdef _WIN32
+#define t_fseek64 _fseeki64
+#define t_ftell64 _ftelli64
+#else
+#define t_fseek64 fseeko
+#define t_ftell64 ftello
+#endif
+
+
+
+/* -----------------------------------------------------------------
+ * out-of-core mesh : spatially partitioned chunk file + LRU page cache
+ *
+ * file (.tcm, little endian) written by TChunkedMesh::Write from a TMesh
+ *   header : "TCM1", vSize, pSize, chunkBits, chunkNum
+ *            per chunk : file offset (int64), pBegin, pNum, ringNum, bounding box (6 float)
+ *   chunk c: vertices [c << chunkBits, (c+1) << chunkBits) :
+ *            verts (3f), norms (3f), texCd (2f), ring offsets (vNum+1, local), ring vertices (global index)
+ *            faces whose smallest vertex is in the chunk : polys (3i), face normals (3f)
+ * The vertex order of the mesh is the chunk partition, so the mesh should be in a space filling
+ * curve order (TMesh::reorder(VORDER_HILBERT)) : every chunk is then a compact piece of the surface.
+ *
+ * TChunkedMesh::Open reads the header only; chunks are read on first access and the least recently
+ * used ones are dropped when the resident size exceeds the budget. The accessors are the ones of
+ * TCompactMesh, so expnentialMapping / DijikstraMapping (expmap.h) run on it directly and only fault in
+ * the chunks the front reaches. The chunk of the last ringBegin() is pinned (never evicted), so the
+ * ring pointers stay valid while the neighbors are read. Not thread safe.
+ * A chunk that cannot be read is not cached : the accessors return a zero filled placeholder (empty
+ * rings, ringBegin == ringEnd) and isReadFailed() is set. Until resetReadError() the placeholder is
+ * returned without reading the file again (pointers into it stay valid), after it the next access
+ * retries the read.
+-------------------------------------------------------------------*/
+
+class TMeshChunk
+{
+public:
+	int            m_vBegin, m_vNum, m_pBegin, m_pNum;
+	vector<EVec3f> m_verts  ;
+	vector<EVec3f> m_norms  ;
+	vector<EVec2f> m_texCd  ;
+	vector<int   > m_ringOff; //m_ringVs[ m_ringOff[i - m_vBegin] .. ) : one ring of vertex i
+	vector<int   > m_ringVs ;
+	vector<int   > m_polys  ;
+	vector<EVec3f> m_pNorms ;
+
+	size_t getMemorySize() const
+	{
+		return sizeof(EVec3f) * (m_verts.size() + m_norms.size() + m_pNorms.size()) + sizeof(EVec2f) * m_texCd.size() +
+			   sizeof(int) * (m_ringOff.size() + m_ringVs.size() + m_polys.size());
+	}
+};
+
+
+
+class TChunkedMesh
+{
+	struct ChunkInfo
+	{
+		long long offset;
+		int       pBegin, pNum, ringNum;
+		float     bbMin[3], bbMax[3];
+	};
+
+	FILE             *m_fp;
+	vector<ChunkInfo> m_info;
+	vector<int>       m_pOff; //faces of chunk c : [m_pOff[c], m_pOff[c+1])
+	size_t            m_budget;
+
+	//page cache (mutable : the accessors are const as those of TMesh / TCompactMesh)
+	mutable vector<TMeshChunk*>          m_res  ;
+	mutable list<int>                    m_lru  ; //front : most recently used
+	mutable vector<list<int>::iterator>  m_lruIt;
+	mutable int                          m_mru, m_pin;
+	mutable size_t                       m_resBytes, m_peakBytes;
+	mutable long long                    m_faults, m_readBytes;
+	mutable TMeshChunk                   m_failed; //placeholder returned for a chunk that failed to read
+	mutable int                          m_failedC;
+	mutable bool                         m_bReadFailed;
+
+	TChunkedMesh(const TChunkedMesh&);
+	TChunkedMesh& operator=(const TChunkedMesh&);
+
+public:
+	int m_vSize, m_pSize, m_chunkBits, m_chunkNum;
+
+	TChunkedMesh()
+	{
+		m_fp = 0;
+		m_budget = (size_t)256 << 20;
+		m_vSize = m_pSize = m_chunkBits = m_chunkNum = 0;
+		m_mru = m_pin = -1;
+		m_resBytes = 0;
+		m_failedC = -1;
+		m_bReadFailed = false;
+		resetStats();
+	}
+	~TChunkedMesh() { Close(); }
+
+	void Close()
+	{
+		dropAll();
+		if (m_fp) fclose(m_fp);
+		m_fp = 0;
+		m_vSize = m_pSize = m_chunkNum = 0;
+		m_failedC = -1;
+		m_bReadFailed = false;
+		m_info.clear(); m_pOff.clear(); m_res.clear(); m_lruIt.clear();
+	}
+
+	//budgetBytes : resident chunk data (at least two chunks are kept)
+	bool Open(const char *fname, const size_t budgetBytes = (size_t)256 << 20)
+	{
+		Close();
+		m_budget = budgetBytes;
+		m_fp = fopen(fname, "rb");
+		if (!m_fp) { fprintf(stderr, "TChunkedMesh : cannot open %s\n", fname); return false; }
+
+		char magic[4];
+		int  head[4];
+		if (fread(magic, 1, 4, m_fp) != 4 || memcmp(magic, "TCM1", 4) != 0 || fread(head, sizeof(int), 4, m_fp) != 4)
+		{
+			fprintf(stderr, "TChunkedMesh : %s is not a chunk file\n", fname);
+			Close();
+			return false;
+		}
+		m_vSize = head[0]; m_pSize = head[1]; m_chunkBits = head[2]; m_chunkNum = head[3];
+
+		m_info.resize(m_chunkNum);
+		for (auto &ci : m_info)
+		{
+			int   iv[3];
+			float fv[6];
+			if (fread(&ci.offset, sizeof(long long), 1, m_fp) != 1 || fread(iv, sizeof(int), 3, m_fp) != 3 || fread(fv, sizeof(float), 6, m_fp) != 6)
+			{
+				fprintf(stderr, "TChunkedMesh : %s is truncated\n", fname);
+				Close();
+				return false;
+			}
+			ci.pBegin = iv[0]; ci.pNum = iv[1]; ci.ringNum = iv[2];
+			memcpy(ci.bbMin, fv, sizeof(float) * 3);
+			memcpy(ci.bbMax, fv + 3, sizeof(float) * 3);
+		}
+		m_pOff.resize(m_chunkNum + 1);
+		for (int c = 0; c < m_chunkNum; ++c) m_pOff[c] = m_info[c].pBegin;
+		m_pOff[m_chunkNum] = m_pSize;
+
+		m_res  .assign(m_chunkNum, 0);
+		m_lruIt.assign(m_chunkNum, m_lru.end());
+		resetStats();
+		return true;
+	}
+
+	//mesh : vertices in a spatially coherent order (TMesh::reorder), normals and ring info up to date
+	//chunkBits : 2^chunkBits vertices per chunk
+	//pNewIdx : face index in the file of each face of mesh (faces are grouped by chunk)
+	static bool Write(const char *fname, const TMesh &mesh, const int chunkBits = 16, vector<int> *pNewIdx = 0)
+	{
+		TPROF_SCOPE("TChunkedMesh::Write");
+		const int vSize = mesh.m_vSize, pSize = mesh.m_pSize;
+		const int chunkNum = (vSize + (1 << chunkBits) - 1) >> chunkBits;
+
+		//faces grouped by the chunk of their smallest vertex (stable counting sort)
+		vector<int> pOff(chunkNum + 1, 0), pOld(pSize);
+		for (int i = 0; i < pSize; ++i)
+		{
+			const int *idx = mesh.m_pPolys[i].idx;
+			++pOff[(min(idx[0], min(idx[1], idx[2])) >> chunkBits) + 1];
+		}
+		for (int c = 0; c < chunkNum; ++c) pOff[c + 1] += pOff[c];
+		{
+			vector<int> pos(pOff.begin(), pOff.end() - 1);
+			for (int i = 0; i < pSize; ++i)
+			{
+				const int *idx = mesh.m_pPolys[i].idx;
+				pOld[pos[min(idx[0], min(idx[1], idx[2])) >> chunkBits]++] = i;
+			}
+		}
+
+		FILE *fp = fopen(fname, "wb");
+		if (!fp) { fprintf(stderr, "TChunkedMesh : cannot open %s\n", fname); return false; }
+
+		const int head[4] = { vSize, pSize, chunkBits, chunkNum };
+		fwrite("TCM1", 1, 4, fp);
+		fwrite(head, sizeof(int), 4, fp);
+		const long long tableOfs = t_ftell64(fp);
+		vector<char> table((sizeof(long long) + 3 * sizeof(int) + 6 * sizeof(float)) * (size_t)chunkNum, 0);
+		if (!table.empty()) fwrite(table.data(), 1, table.size(), fp);
+
+		vector<ChunkInfo> info(chunkNum);
+		for (int c = 0; c < chunkNum; ++c)
+		{
+			const int v0 = c << chunkBits, vNum = min(1 << chunkBits, vSize - v0);
+			ChunkInfo &ci = info[c];
+			ci.offset = t_ftell64(fp);
+			ci.pBegin = pOff[c];
+			ci.pNum   = pOff[c + 1] - pOff[c];
+
+			vector<int>   ringOff(vNum + 1, 0), ringVs;
+			vector<float> tex(2 * (size_t)vNum);
+			for (int i = 0; i < vNum; ++i)
+			{
+				const vector<int> &r = mesh.m_vRingVs[v0 + i];
+				ringVs.insert(ringVs.end(), r.begin(), r.end());
+				ringOff[i + 1] = (int)ringVs.size();
+				tex[2 * i] = mesh.m_vTexCd[v0 + i][0]; tex[2 * i + 1] = mesh.m_vTexCd[v0 + i][1];
+			}
+			ci.ringNum = (int)ringVs.size();
+
+			//bounding box of the vertices and of the faces of the chunk (used by pickByRay)
+			EVec3f bbMin(FLT_MAX, FLT_MAX, FLT_MAX), bbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			vector<int>    polys(3 * (size_t)ci.pNum);
+			vector<EVec3f> pNorms(ci.pNum);
+			for (int i = 0; i < vNum; ++i) { bbMin = bbMin.cwiseMin(mesh.m_vVerts[v0 + i]); bbMax = bbMax.cwiseMax(mesh.m_vVerts[v0 + i]); }
+			for (int j = 0; j < ci.pNum; ++j)
+			{
+				const int p = pOld[ci.pBegin + j];
+				for (int k = 0; k < 3; ++k)
+				{
+					polys[3 * j + k] = mesh.m_pPolys[p].idx[k];
+					bbMin = bbMin.cwiseMin(mesh.m_vVerts[polys[3 * j + k]]);
+					bbMax = bbMax.cwiseMax(mesh.m_vVerts[polys[3 * j + k]]);
+				}
+				pNorms[j] = mesh.m_pNorms[p];
+			}
+			for (int k = 0; k < 3; ++k) { ci.bbMin[k] = bbMin[k]; ci.bbMax[k] = bbMax[k]; }
+
+			fwrite(&mesh.m_vVerts[v0], sizeof(EVec3f), vNum, fp);
+			fwrite(&mesh.m_vNorms[v0], sizeof(EVec3f), vNum, fp);
+			fwrite(tex    .data(), sizeof(float ), tex.size(), fp);
+			fwrite(ringOff.data(), sizeof(int   ), ringOff.size(), fp);
+			if (!ringVs.empty()) fwrite(ringVs.data(), sizeof(int   ), ringVs.size(), fp);
+			if (ci.pNum)
+			{
+				fwrite(polys .data(), sizeof(int   ), polys.size(), fp);
+				fwrite(pNorms.data(), sizeof(EVec3f), pNorms.size(), fp);
+			}
+		}
+
+		t_fseek64(fp, tableOfs, SEEK_SET);
+		for (const auto &ci : info)
+		{
+			const int iv[3] = { ci.pBegin, ci.pNum, ci.ringNum };
+			fwrite(&ci.offset, sizeof(long long), 1, fp);
+			fwrite(iv, sizeof(int), 3, fp);
+			fwrite(ci.bbMin, sizeof(float), 3, fp);
+			fwrite(ci.bbMax, sizeof(float), 3, fp);
+		}
+		const bool ok = !ferror(fp);
+		fclose(fp);
+
+		if (pNewIdx)
+		{
+			pNewIdx->resize(pSize);
+			for (int i = 0; i < pSize; ++i) (*pNewIdx)[pOld[i]] = i;
+		}
+		return ok;
+	}
+
+	//chunk c, read from the file if not resident
+	const TMeshChunk &getChunk(const int c) const
+	{
+		if (c == m_mru) return *m_res[c];
+		if (m_res[c]) m_lru.splice(m_lru.begin(), m_lru, m_lruIt[c]);
+		else if (m_bReadFailed && c == m_failedC) return m_failed;
+		else if (!load(c)) return m_failed;
+		m_mru = c;
+		return *m_res[c];
+	}
+
+	inline int vChunk(const int i) const { return i >> m_chunkBits; }
+	inline int pChunk(const int p) const { return (int)(upper_bound(m_pOff.begin(), m_pOff.end(), p) - m_pOff.begin()) - 1; }
+
+	inline EVec3f getVert    (const int i) const { const TMeshChunk &ch = getChunk(vChunk(i)); return ch.m_verts[i - ch.m_vBegin]; }
+	inline EVec3f getNorm    (const int i) const { const TMeshChunk &ch = getChunk(vChunk(i)); return ch.m_norms[i - ch.m_vBegin]; }
+	inline EVec2f getTexCd   (const int i) const { const TMeshChunk &ch = getChunk(vChunk(i)); return ch.m_texCd[i - ch.m_vBegin]; }
+	inline EVec3f getPolyNorm(const int p) const { const TMeshChunk &ch = getChunk(pChunk(p)); return ch.m_pNorms[p - ch.m_pBegin]; }
+
+	//the returned pointers are valid until the next getPoly / ringBegin / ringEnd
+	inline const int *getPoly(const int p) const
+	{
+		m_pin = pChunk(p);
+		const TMeshChunk &ch = getChunk(m_pin);
+		return &ch.m_polys[3 * (size_t)(p - ch.m_pBegin)];
+	}
+	inline const int *ringBegin(const int i) const
+	{
+		m_pin = vChunk(i);
+		const TMeshChunk &ch = getChunk(m_pin);
+		return ch.m_ringVs.data() + ch.m_ringOff[i - ch.m_vBegin];
+	}
+	inline const int *ringEnd(const int i) const
+	{
+		m_pin = vChunk(i);
+		const TMeshChunk &ch = getChunk(m_pin);
+		return ch.m_ringVs.data() + ch.m_ringOff[i - ch.m_vBegin + 1];
+	}
+
+	//chunks whose bounding box the ray enters are searched in the order of the entry points
+	bool pickByRay(const EVec3f &rayP, const EVec3f &rayD, EVec3f &pos, int &pIdx) const
+	{
+		vector<pair<float, int>> cand;
+		for (int c = 0; c < m_chunkNum; ++c)
+		{
+			const ChunkInfo &ci = m_info[c];
+			if (ci.pNum == 0) continue;
+			float t0 = -FLT_MAX, t1 = FLT_MAX;
+			for (int k = 0; k < 3 && t0 <= t1; ++k)
+			{
+				if (fabs(rayD[k]) < 1e-20f)
+				{
+					if (rayP[k] < ci.bbMin[k] || ci.bbMax[k] < rayP[k]) t0 = FLT_MAX;
+					continue;
+				}
+				float a = (ci.bbMin[k] - rayP[k]) / rayD[k], b = (ci.bbMax[k] - rayP[k]) / rayD[k];
+				if (a > b) swap(a, b);
+				t0 = max(t0, a);
+				t1 = min(t1, b);
+			}
+			if (t0 <= t1) cand.push_back(make_pair(t0, c));
+		}
+		sort(cand.begin(), cand.end());
+
+		const float rayLen = rayD.norm();
+		float  depth = FLT_MAX;
+		EVec3f tmpPos;
+		pIdx = -1;
+		for (const auto &cd : cand)
+		{
+			if (depth != FLT_MAX && cd.first * rayLen > depth) break;
+			const int c = cd.second;
+			for (int pi = m_pOff[c]; pi < m_pOff[c + 1]; ++pi)
+			{
+				const int *p = getPoly(pi);
+				const int i0 = p[0], i1 = p[1], i2 = p[2];
+				if (t_intersectRayToTriangle(rayP, rayD, getVert(i0), getVert(i1), getVert(i2), tmpPos))
+				{
+					float d = (tmpPos - rayP).norm();
+					if (d < depth)
+					{
+						depth = d;
+						pos   = tmpPos;
+						pIdx  = pi;
+					}
+				}
+			}
+		}
+		return depth != FLT_MAX;
+	}
+
+	void      setBudget(const size_t budgetBytes) { m_budget = budgetBytes; evict(-1); }
+	size_t    getResidentBytes() const { return m_resBytes ; }
+	size_t    getPeakBytes    () const { return m_peakBytes; }
+	long long getFaultNum     () const { return m_faults   ; }
+	long long getReadBytes    () const { return m_readBytes; }
+	int       getResidentNum  () const { return (int)m_lru.size(); }
+	void      resetStats() { m_faults = m_readBytes = 0; m_peakBytes = m_resBytes; }
+
+	//true if a chunk read failed since Open / resetReadError (the results computed meanwhile are incomplete)
+	bool isReadFailed  () const { return m_bReadFailed ; }
+	void resetReadError() const { m_bReadFailed = false; }
+
+	//drop every resident chunk
+	void dropAll()
+	{
+		for (auto &ch : m_res) { delete ch; ch = 0; }
+		m_lru.clear();
+		for (auto &it : m_lruIt) it = m_lru.end();
+		m_mru = m_pin = -1;
+		m_resBytes = 0;
+	}
+
+private:
+	//false : the chunk is not cached, m_failed is set up as its zero filled placeholder
+	bool load(const int c) const
+	{
+		const ChunkInfo &ci = m_info[c];
+		TMeshChunk *ch = new TMeshChunk();
+		ch->m_vBegin = c << m_chunkBits;
+		ch->m_vNum   = min(1 << m_chunkBits, m_vSize - ch->m_vBegin);
+		ch->m_pBegin = ci.pBegin;
+		ch->m_pNum   = ci.pNum;
+		ch->m_verts  .resize(ch->m_vNum);
+		ch->m_norms  .resize(ch->m_vNum);
+		ch->m_texCd  .resize(ch->m_vNum);
+		ch->m_ringOff.resize(ch->m_vNum + 1);
+		ch->m_ringVs .resize(ci.ringNum);
+		ch->m_polys  .resize(3 * (size_t)ci.pNum);
+		ch->m_pNorms .resize(ci.pNum);
+
+		bool ok = t_fseek64(m_fp, ci.offset, SEEK_SET) == 0;
+		ok = ok && fread(ch->m_verts  .data(), sizeof(EVec3f), ch->m_vNum     , m_fp) == (size_t)ch->m_vNum;
+		ok = ok && fread(ch->m_norms  .data(), sizeof(EVec3f), ch->m_vNum     , m_fp) == (size_t)ch->m_vNum;
+		ok = ok && fread(ch->m_texCd  .data(), sizeof(EVec2f), ch->m_vNum     , m_fp) == (size_t)ch->m_vNum;
+		ok = ok && fread(ch->m_ringOff.data(), sizeof(int   ), ch->m_vNum + 1 , m_fp) == (size_t)ch->m_vNum + 1;
+		ok = ok && fread(ch->m_ringVs .data(), sizeof(int   ), ci.ringNum     , m_fp) == (size_t)ci.ringNum;
+		ok = ok && fread(ch->m_polys  .data(), sizeof(int   ), 3 * (size_t)ci.pNum, m_fp) == 3 * (size_t)ci.pNum;
+		ok = ok && fread(ch->m_pNorms .data(), sizeof(EVec3f), ci.pNum        , m_fp) == (size_t)ci.pNum;
+		if (!ok)
+		{
+			if (!m_bReadFailed) fprintf(stderr, "TChunkedMesh : failed to read chunk %d\n", c);
+			delete ch;
+			m_bReadFailed = true;
+			m_failedC = c;
+			m_failed = TMeshChunk();
+			m_failed.m_vBegin = c << m_chunkBits;
+			m_failed.m_vNum   = min(1 << m_chunkBits, m_vSize - m_failed.m_vBegin);
+			m_failed.m_pBegin = ci.pBegin;
+			m_failed.m_pNum   = ci.pNum;
+			m_failed.m_verts  .assign(m_failed.m_vNum, EVec3f::Zero());
+			m_failed.m_norms  .assign(m_failed.m_vNum, EVec3f::Zero());
+			m_failed.m_texCd  .assign(m_failed.m_vNum, EVec2f::Zero());
+			m_failed.m_ringOff.assign(m_failed.m_vNum + 1, 0);
+			m_failed.m_polys  .assign(3 * (size_t)ci.pNum, m_failed.m_vBegin);
+			m_failed.m_pNorms .assign(ci.pNum, EVec3f::Zero());
+			return false;
+		}
+
+		const size_t bytes = ch->getMemorySize();
+		m_res[c] = ch;
+		m_lru.push_front(c);
+		m_lruIt[c] = m_lru.begin();
+		m_resBytes  += bytes;
+		m_readBytes += bytes;
+		++m_faults;
+		TPROF_COUNT(PROF_CHUNK_FAULT, 1);
+		evict(c);
+		m_peakBytes = max(m_peakBytes, m_resBytes);
+		return true;
+	}
+
+	//drop least recently used chunks (except keep and the pinned one) until the budget is met
+	void evict(const int keep) const
+	{
+		list<int>::iterator it = m_lru.end();
+		while (m_resBytes > m_budget && it != m_lru.begin())
+		{
+			--it;
+			const int c = *it;
+			if (c == keep || c == m_pin) continue;
+			m_resBytes -= m_res[c]->getMemorySize();
+			delete m_res[c];
+			m_res[c]   = 0;
+			m_lruIt[c] = m_lru.end();
+			if (m_mru == c) m_mru = -1;
+			it = m_lru.erase(it);
+		}
+	}
+};
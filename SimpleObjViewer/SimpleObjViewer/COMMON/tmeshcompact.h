@@ -0,0 +1,280 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include "tmesh.h"
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * compact (quantized) read only copy of a TMesh for huge meshes
+ *
+ *   position : 3 x uint16 against the bounding box (getBoundBox), p = m_bbMin + q * m_bbStep  ( 6 byte)
+ *   normal   : octahedral encoding, 2 x snorm16 packed into one uint32                     ( 4 byte)
+ *   uv       : 2 x half float (w of m_vTexCd is dropped)                                     ( 4 byte)
+ *   one ring : CSR (m_ringOff / m_ringVs), same order as TMesh::m_vRingVs                    ( 4 byte + 4 per neighbor)
+ *
+ * the position components are stored as separate arrays (SoA) so that decodeVerts is a plain
+ * multiply-add loop the compiler vectorizes; pickByRay decodes the vertices in blocks through it.
+ * The quantization error of a position is at most half a step (bounding box size / 131070 per axis).
+ * expnentialMapping / DijikstraMapping (expmap.h) read the arrays directly.
+-------------------------------------------------------------------*/
+
+//IEEE half float <-> float, round to nearest even, denormals / inf / nan preserved
+inline unsigned short t_floatToHalf(const float v)
+{
+	unsigned int f;
+	memcpy(&f, &v, 4);
+	const unsigned int sign = f & 0x80000000u;
+	f ^= sign;
+
+	unsigned int h;
+	if (f >= (143u << 23)) h = (f > (255u << 23)) ? 0x7e00u : 0x7c00u; //overflow -> inf, nan
+	else if (f < (113u << 23))                                       //denormal half (or zero)
+	{
+		const unsigned int magicU = 126u << 23;
+		float fm, magic;
+		memcpy(&fm, &f, 4);
+		memcpy(&magic, &magicU, 4);
+		fm += magic;
+		memcpy(&h, &fm, 4);
+		h -= magicU;
+	}
+	else
+	{
+		const unsigned int odd = (f >> 13) & 1;
+		f += 0xfffu + odd;
+		f -= 112u << 23; //rebias the exponent
+		h  = f >> 13;
+	}
+	return (unsigned short)(h | (sign >> 16));
+}
+
+inline float t_halfToFloat(const unsigned short h)
+{
+	const unsigned int expMask = 0x7c00u << 13;
+	unsigned int f = (h & 0x7fffu) << 13;
+	const unsigned int e = f & expMask;
+	f += (127 - 15) << 23;
+	if (e == expMask) f += (128 - 16) << 23; //inf, nan
+	else if (e == 0)                         //denormal
+	{
+		const unsigned int magicU = 113u << 23;
+		float fm, magic;
+		f += 1 << 23;
+		memcpy(&fm, &f, 4);
+		memcpy(&magic, &magicU, 4);
+		fm -= magic;
+		memcpy(&f, &fm, 4);
+	}
+	f |= (unsigned int)(h & 0x8000u) << 16;
+
+	float v;
+	memcpy(&v, &f, 4);
+	return v;
+}
+
+
+
+//octahedral normal encoding (n : unit vector)
+inline unsigned int t_encodeOctNormal(const EVec3f &n)
+{
+	const float s = fabs(n[0]) + fabs(n[1]) + fabs(n[2]);
+	if (s < 1e-20f) return 0;
+	float x = n[0] / s, y = n[1] / s;
+	if (n[2] < 0)
+	{
+		const float ox = x;
+		x = (1 - fabs(y )) * (ox >= 0 ? 1.0f : -1.0f);
+		y = (1 - fabs(ox)) * (y  >= 0 ? 1.0f : -1.0f);
+	}
+	const int qx = (int)floor(max(-1.0f, min(1.0f, x)) * 32767.0f + 0.5f);
+	const int qy = (int)floor(max(-1.0f, min(1.0f, y)) * 32767.0f + 0.5f);
+	return (unsigned int)(unsigned short)(short)qx | ((unsigned int)(unsigned short)(short)qy << 16);
+}
+
+inline EVec3f t_decodeOctNormal(const unsigned int c)
+{
+	const float x = (short)(c & 0xffffu) * (1.0f / 32767.0f);
+	const float y = (short)(c >> 16    ) * (1.0f / 32767.0f);
+	EVec3f n(x, y, 1 - fabs(x) - fabs(y));
+	const float t = max(-n[2], 0.0f);
+	n[0] += (n[0] >= 0) ? -t : t;
+	n[1] += (n[1] >= 0) ? -t : t;
+	return n.normalized();
+}
+
+
+
+class TCompactMesh
+{
+public:
+	int    m_vSize ;
+	int    m_pSize ;
+	EVec3f m_bbMin ;
+	EVec3f m_bbStep; //bounding box size / 65535
+
+	vector<unsigned short> m_qx, m_qy, m_qz; //quantized positions
+	vector<unsigned int  > m_oNorms ;         //octahedral normals
+	vector<unsigned short> m_hTexCd ;         //(u,v) half float, 2 per vertex
+	vector<int           > m_polys  ;         //3 per face
+	vector<int           > m_ringOff;         //m_ringVs[ m_ringOff[i] .. m_ringOff[i+1] ) : one ring of vertex i
+	vector<int           > m_ringVs ;
+
+	TCompactMesh() { m_vSize = m_pSize = 0; m_bbMin = m_bbStep = EVec3f(0, 0, 0); }
+	TCompactMesh(const TMesh &mesh) { Set(mesh); }
+
+	void clear()
+	{
+		m_vSize = m_pSize = 0;
+		vector<unsigned short>().swap(m_qx);
+		vector<unsigned short>().swap(m_qy);
+		vector<unsigned short>().swap(m_qz);
+		vector<unsigned int  >().swap(m_oNorms);
+		vector<unsigned short>().swap(m_hTexCd);
+		vector<int           >().swap(m_polys);
+		vector<int           >().swap(m_ringOff);
+		vector<int           >().swap(m_ringVs);
+	}
+
+	//mesh needs up to date normals and ring info
+	void Set(const TMesh &mesh)
+	{
+		TPROF_SCOPE("TCompactMesh::Set");
+		clear();
+		m_vSize = mesh.m_vSize;
+		m_pSize = mesh.m_pSize;
+
+		EVec3f maxV;
+		mesh.getBoundBox(m_bbMin, maxV);
+		if (m_vSize == 0) m_bbMin = maxV = EVec3f(0, 0, 0);
+		m_bbStep = (maxV - m_bbMin) / 65535.0f;
+		EVec3f inv;
+		for (int k = 0; k < 3; ++k) inv[k] = (m_bbStep[k] > 0) ? 1.0f / m_bbStep[k] : 0.0f;
+
+		m_qx.resize(m_vSize); m_qy.resize(m_vSize); m_qz.resize(m_vSize);
+		m_oNorms.resize(m_vSize);
+		m_hTexCd.resize(2 * (size_t)m_vSize);
+		m_ringOff.resize(m_vSize + 1);
+		m_ringOff[0] = 0;
+		for (int i = 0; i < m_vSize; ++i) m_ringOff[i + 1] = m_ringOff[i] + (int)mesh.m_vRingVs[i].size();
+		m_ringVs.resize(m_ringOff[m_vSize]);
+
+#pragma omp parallel for
+		for (int i = 0; i < m_vSize; ++i)
+		{
+			const EVec3f q = (mesh.m_vVerts[i] - m_bbMin).cwiseProduct(inv);
+			m_qx[i] = (unsigned short)min(65535.0f, max(0.0f, floor(q[0] + 0.5f)));
+			m_qy[i] = (unsigned short)min(65535.0f, max(0.0f, floor(q[1] + 0.5f)));
+			m_qz[i] = (unsigned short)min(65535.0f, max(0.0f, floor(q[2] + 0.5f)));
+			m_oNorms[i]         = t_encodeOctNormal(mesh.m_vNorms[i]);
+			m_hTexCd[2 * i    ] = t_floatToHalf(mesh.m_vTexCd[i][0]);
+			m_hTexCd[2 * i + 1] = t_floatToHalf(mesh.m_vTexCd[i][1]);
+			if (!mesh.m_vRingVs[i].empty()) memcpy(&m_ringVs[m_ringOff[i]], mesh.m_vRingVs[i].data(), sizeof(int) * mesh.m_vRingVs[i].size());
+		}
+
+		m_polys.resize(3 * (size_t)m_pSize);
+		if (m_pSize) memcpy(m_polys.data(), mesh.m_pPolys, sizeof(int) * 3 * (size_t)m_pSize);
+	}
+
+	//decode to a full TMesh (ring info and face normals are rebuilt, vertex normals are the decoded ones)
+	void Get(TMesh &mesh) const
+	{
+		mesh.allocate(m_vSize, m_pSize);
+#pragma omp parallel for
+		for (int i = 0; i < m_pSize; ++i) mesh.m_pPolys[i] = TPoly(m_polys[3 * i], m_polys[3 * i + 1], m_polys[3 * i + 2]);
+#pragma omp parallel for
+		for (int i = 0; i < m_vSize; ++i)
+		{
+			mesh.m_vVerts[i] = getVert(i);
+			mesh.m_vTexCd[i] << t_halfToFloat(m_hTexCd[2 * i]), t_halfToFloat(m_hTexCd[2 * i + 1]), 0;
+		}
+		mesh.updateRingInfo();
+		mesh.updateNormal();
+#pragma omp parallel for
+		for (int i = 0; i < m_vSize; ++i) mesh.m_vNorms[i] = getNorm(i);
+	}
+
+	inline EVec3f getVert (const int i) const { return EVec3f(m_bbMin[0] + m_bbStep[0] * m_qx[i], m_bbMin[1] + m_bbStep[1] * m_qy[i], m_bbMin[2] + m_bbStep[2] * m_qz[i]); }
+	inline EVec3f getNorm (const int i) const { return t_decodeOctNormal(m_oNorms[i]); }
+	inline EVec2f getTexCd(const int i) const { return EVec2f(t_halfToFloat(m_hTexCd[2 * i]), t_halfToFloat(m_hTexCd[2 * i + 1])); }
+
+	inline const int *getPoly  (const int p) const { return &m_polys[3 * (size_t)p]; }
+	inline const int *ringBegin(const int i) const { return m_ringVs.data() + m_ringOff[i]    ; }
+	inline const int *ringEnd  (const int i) const { return m_ringVs.data() + m_ringOff[i + 1]; }
+
+	inline EVec3f getPolyNorm(const int p) const
+	{
+		const int *idx = getPoly(p);
+		const EVec3f x0 = getVert(idx[0]);
+		return (getVert(idx[1]) - x0).cross(getVert(idx[2]) - x0).normalized();
+	}
+
+	//positions of vertices i0 .. i0+n-1 into separate x, y, z arrays
+	void decodeVerts(const int i0, const int n, float *x, float *y, float *z) const
+	{
+		const unsigned short *qx = m_qx.data() + i0, *qy = m_qy.data() + i0, *qz = m_qz.data() + i0;
+		const float mx = m_bbMin [0], my = m_bbMin [1], mz = m_bbMin [2];
+		const float sx = m_bbStep[0], sy = m_bbStep[1], sz = m_bbStep[2];
+		for (int k = 0; k < n; ++k) x[k] = mx + sx * qx[k];
+		for (int k = 0; k < n; ++k) y[k] = my + sy * qy[k];
+		for (int k = 0; k < n; ++k) z[k] = mz + sz * qz[k];
+	}
+
+	size_t getMemorySize() const
+	{
+		return sizeof(unsigned short) * (m_qx.size() + m_qy.size() + m_qz.size() + m_hTexCd.size()) +
+			   sizeof(unsigned int  ) *  m_oNorms.size() +
+			   sizeof(int           ) * (m_polys.size() + m_ringOff.size() + m_ringVs.size());
+	}
+
+	//the vertices are decoded in blocks and classified against two planes through the ray,
+	//a face whose three vertices are on the same side of one plane is skipped without decoding
+	bool pickByRay(const EVec3f &rayP, const EVec3f &rayD, EVec3f &pos, int &pIdx) const
+	{
+		const EVec3f d = rayD.normalized();
+		const EVec3f a = (fabs(d[0]) < 0.9f ? EVec3f(1, 0, 0) : EVec3f(0, 1, 0)).cross(d).normalized();
+		const EVec3f b = d.cross(a);
+		const float  ea  = -a.dot(rayP), eb = -b.dot(rayP);
+		const float  eps = 1e-5f * (65535.0f * m_bbStep + (m_bbMin - rayP).cwiseAbs()).norm();
+
+		const int B = 1024;
+		vector<unsigned char> side(m_vSize);
+#pragma omp parallel for
+		for (int i0 = 0; i0 < m_vSize; i0 += B)
+		{
+			float x[B], y[B], z[B];
+			const int n = min(B, m_vSize - i0);
+			decodeVerts(i0, n, x, y, z);
+			unsigned char *s = &side[i0];
+			for (int k = 0; k < n; ++k)
+			{
+				const float da = a[0] * x[k] + a[1] * y[k] + a[2] * z[k] + ea;
+				const float db = b[0] * x[k] + b[1] * y[k] + b[2] * z[k] + eb;
+				s[k] = (unsigned char)((da > eps) | (da < -eps) << 1 | (db > eps) << 2 | (db < -eps) << 3);
+			}
+		}
+
+		float depth = FLT_MAX;
+		EVec3f tmpPos;
+		pIdx = -1;
+		for (int pi = 0; pi < m_pSize; ++pi)
+		{
+			const int *p = getPoly(pi);
+			if (side[p[0]] & side[p[1]] & side[p[2]]) continue;
+			if (t_intersectRayToTriangle(rayP, rayD, getVert(p[0]), getVert(p[1]), getVert(p[2]), tmpPos))
+			{
+				float d = (tmpPos - rayP).norm();
+				if (d < depth)
+				{
+					depth = d;
+					pos   = tmpPos;
+					pIdx  = pi;
+				}
+			}
+		}
+		return depth != FLT_MAX;
+	}
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "tmeshsmoothing.h"
+#include "tmesh.h"
+
+#include <vector>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/IterativeLinearSolvers>
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * implicit (backward Euler) mesh fairing
+ *
+ * solves (I + lambda L) x = x0  with L = I - D^-1 A
+ * (A : symmetric one ring weights, uniform or cotangent, D = diag(rowsum(A))).
+ * The system is multiplied by D to make it symmetric positive definite,
+ *     (D + lambda (D - A)) x = D x0,
+ * and solved for the three coordinates at once by
+ *   FAIR_LDLT : Eigen::SimplicialLDLT (direct)
+ *   FAIR_CG   : Eigen::ConjugateGradient with Jacobi preconditioner, warm started by x0
+ *   FAIR_AUTO : LDLT up to 100k vertices, CG above
+ *               (the fill-in of the direct factorization grows quickly :
+ *                100k vertices 2 s, 1M vertices > 3 min, while CG needs about 15 iterations)
+ *
+ * The symbolic analysis is kept while the topology is unchanged, and
+ * the numeric factorization (or the CG matrix and preconditioner) is kept
+ * while lambda / weighting is unchanged, so repeated calls cost one solve each.
+ * Cotangent weights are frozen at the positions of the factorization;
+ * call clear() to recompute them from the current shape.
+-------------------------------------------------------------------*/
+
+enum TFairingSolver : int
+{
+	FAIR_AUTO = 0,
+	FAIR_LDLT = 1,
+	FAIR_CG   = 2
+};
+
+
+
+class TMeshFairing
+{
+	typedef Eigen::SparseMatrix<double> SpMat;
+	enum { AUTO_LDLT_MAX = 100000 };
+
+	int     m_vSize     ;
+	float   m_lambda    ;
+	bool    m_bCotangent;
+	bool    m_bAnalyzed ;
+	bool    m_bFactorized;
+	bool    m_bCG       ;
+
+	vector<double>               m_diag; //D
+	SpMat                        m_M   ; //system matrix (referenced by m_cg)
+	Eigen::SimplicialLDLT<SpMat> m_ldlt;
+	Eigen::ConjugateGradient<SpMat, Eigen::Lower | Eigen::Upper> m_cg;
+
+public:
+	TMeshFairing()
+	{
+		m_vSize       = 0;
+		m_lambda      = 0;
+		m_bCotangent  = false;
+		m_bAnalyzed   = false;
+		m_bFactorized = false;
+		m_bCG         = false;
+		m_cg.setTolerance(1e-7); //relative residual, enough for float positions
+	}
+
+	void clear()
+	{
+		m_vSize       = 0;
+		m_bAnalyzed   = false;
+		m_bFactorized = false;
+		m_diag.clear();
+		m_M = SpMat();
+	}
+
+	bool isFactorized(const int vSize, const float lambda, const bool bCotangent, const TFairingSolver solver = FAIR_AUTO) const
+	{
+		return m_bFactorized && m_vSize == vSize && m_lambda == lambda && m_bCotangent == bCotangent && m_bCG == useCG(vSize, solver);
+	}
+
+
+
+	// csr : one ring of the mesh (TMeshSmoother::Build)
+	bool Factorize(
+		const TMeshSmoother &csr, 
+		const EVec3f        *verts, 
+		const vector<int>   *ringPs, 
+		const int           *polys, 
+		const float          lambda, 
+		const bool           bCotangent, 
+		const TFairingSolver solver = FAIR_AUTO)
+	{
+		const int  vSize  = csr.getVSize ();
+		const int *rowPtr = csr.getRowPtr();
+		const int *col    = csr.getCol   ();
+		if (m_vSize != vSize) m_bAnalyzed = false;
+
+		vector<float> w(rowPtr[vSize]);
+		csr.ComputeWeights(verts, ringPs, polys, bCotangent, false, w.data());
+
+		//A (symmetrized) and D
+		SpMat A(vSize, vSize);
+		{
+			vector<Eigen::Triplet<double> > trip;
+			trip.reserve(rowPtr[vSize]);
+			for (int i = 0; i < vSize; ++i)
+				for (int k = rowPtr[i]; k < rowPtr[i + 1]; ++k) trip.push_back(Eigen::Triplet<double>(i, col[k], w[k]));
+			A.setFromTriplets(trip.begin(), trip.end());
+			SpMat At = A.transpose();
+			A = 0.5 * (A + At);
+		}
+
+		m_diag.resize(vSize);
+		for (int i = 0; i < vSize; ++i) m_diag[i] = 0;
+		for (int j = 0; j < vSize; ++j)
+			for (SpMat::InnerIterator it(A, j); it; ++it) m_diag[it.row()] += it.value();
+
+		//M = (1 + lambda) D - lambda A
+		SpMat D(vSize, vSize);
+		{
+			vector<Eigen::Triplet<double> > trip(vSize);
+			for (int i = 0; i < vSize; ++i) trip[i] = Eigen::Triplet<double>(i, i, (1.0 + lambda) * m_diag[i]);
+			D.setFromTriplets(trip.begin(), trip.end());
+		}
+		m_M = D - (double)lambda * A;
+
+		m_vSize       = vSize;
+		m_lambda      = lambda;
+		m_bCotangent  = bCotangent;
+		m_bCG         = useCG(vSize, solver);
+
+		if (m_bCG)
+		{
+			m_cg.compute(m_M);
+			m_bFactorized = (m_cg.info() == Eigen::Success);
+			return m_bFactorized;
+		}
+
+		if (!m_bAnalyzed)
+		{
+			m_ldlt.analyzePattern(m_M);
+			m_bAnalyzed = true;
+		}
+		m_ldlt.factorize(m_M);
+		m_bFactorized = (m_ldlt.info() == Eigen::Success);
+		return m_bFactorized;
+	}
+
+
+
+	// verts <- (I + lambda L)^-1 verts
+	bool Solve(EVec3f *verts)
+	{
+		if (!m_bFactorized) return false;
+
+		Eigen::MatrixX3d b(m_vSize, 3), x;
+#pragma omp parallel for
+		for (int i = 0; i < m_vSize; ++i) b.row(i) = m_diag[i] * verts[i].cast<double>().transpose();
+
+		if (m_bCG)
+		{
+			Eigen::MatrixX3d x0(m_vSize, 3);
+#pragma omp parallel for
+			for (int i = 0; i < m_vSize; ++i) x0.row(i) = verts[i].cast<double>().transpose();
+			x = m_cg.solveWithGuess(b, x0);
+			if (m_cg.info() != Eigen::Success) return false;
+		}
+		else
+		{
+			x = m_ldlt.solve(b);
+			if (m_ldlt.info() != Eigen::Success) return false;
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < m_vSize; ++i) verts[i] = x.row(i).transpose().cast<float>();
+		return true;
+	}
+
+private:
+	static bool useCG(const int vSize, const TFairingSolver solver)
+	{
+		return solver == FAIR_CG || (solver == FAIR_AUTO && vSize > AUTO_LDLT_MAX);
+	}
+};
+
+
+
+//TMesh members declared in tmesh.h
+
+inline bool TMesh::implicitFairing(float lambda, TSmoothMode mode = SMOOTH_UNIFORM, TFairingSolver solver = FAIR_AUTO)
+{
+	if( m_vSize == 0 ) return false;
+	TPROF_SCOPE("TMesh::implicitFairing");
+	const bool bCot = (mode == SMOOTH_COTANGENT);
+
+	if( !m_smoother.isBuilt(m_vSize) ) m_smoother.Build(m_vSize, m_vRingVs);
+	if( !m_fairing ) m_fairing = make_shared<TMeshFairing>();
+	if( !m_fairing->isFactorized(m_vSize, lambda, bCot, solver) &&
+		!m_fairing->Factorize(m_smoother, m_vVerts, m_vRingPs, (const int*)m_pPolys, lambda, bCot, solver) ) return false;
+
+	if( !m_fairing->Solve(m_vVerts) ) return false;
+	updateNormal();
+	return true;
+}
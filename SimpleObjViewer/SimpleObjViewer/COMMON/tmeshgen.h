@@ -0,0 +1,356 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include "tmath.h"
+#include "tmesh.h"
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * parametric test meshes (uv sphere, geodesic sphere, torus, plane, cylinder) and a smooth noise field
+ *
+ * t_genXxxSize gives the vertex / face numbers, t_genXxx fills preallocated arrays
+ * (Vs : position, Ts : parameter (u,v,0) in [0,1], Ps : 3 indices per face, CCW seen from outside).
+ * Vertices and faces are written in parallel straight into the arrays (the geodesic sphere keeps two
+ * index rows per thread), TMesh::initializeXxx allocates its arrays and calls them.
+ *
+ * The parameters in Ts give the analytic position of each vertex, e.g. for geodesic distances :
+ *   sphere   : u = longitude / 2pi, v = colatitude / pi
+ *   torus    : u = major angle / 2pi, v = minor angle / 2pi
+ *   plane    : u, v along x and y
+ *   cylinder : u = angle / 2pi, v along the axis (z)
+-------------------------------------------------------------------*/
+
+
+
+//uv sphere of radius r centered at the origin, poles on the z axis
+//M slices (>= 3) x N stacks (>= 2), one vertex at each pole
+inline void t_genUVSphereSize(const int M, const int N, int &vSize, int &pSize)
+{
+	vSize = 2 + M * (N - 1);
+	pSize = 2 * M * (N - 1);
+}
+
+inline void t_genUVSphere(const float r, const int M, const int N, EVec3f *Vs, EVec3f *Ts, int *Ps)
+{
+	const int S = 1 + M * (N - 1); //south pole
+
+	Vs[0] << 0, 0,  r; Ts[0] << 0, 0, 0;
+	Vs[S] << 0, 0, -r; Ts[S] << 0, 1, 0;
+
+#pragma omp parallel for
+	for (int j = 1; j < N; ++j)
+	{
+		const double th = M_PI * j / N;
+		for (int i = 0; i < M; ++i)
+		{
+			const double ph = 2 * M_PI * i / M;
+			const int    k  = 1 + (j - 1) * M + i;
+			Vs[k] << (float)(r * sin(th) * cos(ph)), (float)(r * sin(th) * sin(ph)), (float)(r * cos(th));
+			Ts[k] << (float)i / M, (float)j / N, 0;
+		}
+	}
+
+	//row 0 : north cap, row 1..N-2 : bands, row N-1 : south cap
+#pragma omp parallel for
+	for (int j = 0; j < N; ++j)
+	{
+		int *p = (j == 0) ? Ps : Ps + 3 * (M + 2 * M * (j - 1));
+		for (int i = 0; i < M; ++i)
+		{
+			const int i1 = (i + 1) % M;
+			const int a  = 1 + (j - 1) * M + i, b = 1 + (j - 1) * M + i1;
+			const int c  = a + M              , d = b + M;
+			if      (j == 0    ) { p[0] = 0; p[1] = 1 + i; p[2] = 1 + i1; p += 3; }
+			else if (j == N - 1) { p[0] = a; p[1] = S    ; p[2] = b     ; p += 3; }
+			else
+			{
+				p[0] = a; p[1] = c; p[2] = d;
+				p[3] = a; p[4] = d; p[5] = b; p += 6;
+			}
+		}
+	}
+}
+
+
+
+//geodesic sphere : the icosahedron subdivided "level" times (each triangle -> 4) and projected on the sphere,
+//generated directly as a frequency 2^level grid on each face (20 * 4^level faces, 10 * 4^level + 2 vertices)
+//vertices : 12 corners, then (f-1) per edge, then the face interiors
+inline void t_genGeodesicSphereSize(const int level, int &vSize, int &pSize)
+{
+	const int f = 1 << level;
+	vSize = 10 * f * f + 2;
+	pSize = 20 * f * f;
+}
+
+inline void t_genGeodesicSphere(const float r, const int level, EVec3f *Vs, EVec3f *Ts, int *Ps)
+{
+	const float a = 0.525731f, b = 0.850651f;
+	const EVec3f C[12] = {
+		EVec3f(0, -a,  b), EVec3f( b, 0, a), EVec3f( b, 0,-a), EVec3f(-b, 0, -a), EVec3f(-b, 0, a), EVec3f(-a, b, 0),
+		EVec3f( a, b, 0 ), EVec3f( a,-b, 0), EVec3f(-a,-b, 0), EVec3f( 0,-a, -b), EVec3f(0, a, -b), EVec3f(0,  a, b) };
+	const int F[20][3] = {
+		{ 1,  2,  6}, {1,  7,  2}, { 3,  4,  5}, {4,  3,  8},
+		{ 6,  5, 11}, {5,  6, 10}, { 9, 10,  2}, {10, 9,  3},
+		{ 7,  8,  9}, {8,  7,  0}, {11,  0,  1}, { 0,11,  4},
+		{ 6,  2, 10}, {1,  6, 11}, { 3,  5, 10}, { 5, 4, 11},
+		{ 2,  7,  9}, {7,  1,  0}, { 3,  9,  8}, { 4, 8,  0} };
+
+	const int f = 1 << level;
+	const int eBase = 12, fBase = 12 + 30 * (f - 1), fInN = (f - 1) * (f - 2) / 2;
+
+	//30 edges (a < b) in the order of first appearance in F, faceE[fi] : edge id of (c0,c1), (c0,c2), (c1,c2) of face fi
+	static const int edges[30][2] = {
+		{ 1, 2}, { 1, 6}, { 2, 6}, { 1, 7}, { 2, 7}, { 3, 4}, { 3, 5}, { 4, 5}, { 4, 8}, { 3, 8},
+		{ 5, 6}, { 6,11}, { 5,11}, { 5,10}, { 6,10}, { 9,10}, { 2, 9}, { 2,10}, { 3,10}, { 3, 9},
+		{ 7, 8}, { 7, 9}, { 8, 9}, { 0, 8}, { 0, 7}, { 0,11}, { 1,11}, { 0, 1}, { 0, 4}, { 4,11} };
+	static const int faceE[20][3] = {
+		{ 0, 1, 2}, { 3, 0, 4}, { 5, 6, 7}, { 5, 8, 9}, {10,11,12}, {10,13,14}, {15,16,17}, {15,18,19}, {20,21,22}, {20,23,24},
+		{25,26,27}, {25,28,29}, { 2,14,17}, { 1,26,11}, { 6,18,13}, { 7,12,29}, { 4,16,21}, { 3,24,27}, {19, 9,22}, { 8,28,23} };
+
+	auto setV = [&](const int k, const EVec3f &p)
+	{
+		const EVec3f n = p.normalized();
+		Vs[k] = r * n;
+		Ts[k] << 0.5f + atan2f(n[1], n[0]) * (float)(0.5 / M_PI), acosf(max(-1.0f, min(1.0f, n[2]))) * (float)(1.0 / M_PI), 0;
+	};
+
+	//vertex on face "fi" at grid (i,j) : corners[0] + i/f (corners[1]-corners[0]) + j/f (corners[2]-corners[0])
+	auto edgeV = [&](const int e, const int v0, const int v1, const int t)
+	{
+		return eBase + e * (f - 1) + ((v0 < v1) ? t : f - t) - 1;
+	};
+	auto vid = [&](const int fi, const int i, const int j)
+	{
+		const int *c = F[fi];
+		if (i == 0 && j == 0) return c[0];
+		if (j == f          ) return c[2];
+		if (i == f          ) return c[1];
+		if (j == 0          ) return edgeV(faceE[fi][0], c[0], c[1], i);
+		if (i == 0          ) return edgeV(faceE[fi][1], c[0], c[2], j);
+		if (i + j == f      ) return edgeV(faceE[fi][2], c[1], c[2], j);
+		return fBase + fi * fInN + (j - 1) * (f - 1) - (j - 1) * j / 2 + (i - 1);
+	};
+
+	for (int k = 0; k < 12; ++k) setV(k, C[k]);
+
+#pragma omp parallel for
+	for (int e = 0; e < 30; ++e)
+		for (int t = 1; t < f; ++t)
+			setV(eBase + e * (f - 1) + t - 1, C[edges[e][0]] + (C[edges[e][1]] - C[edges[e][0]]) * ((float)t / f));
+
+	//one task per (face, row), r0 / r1 : vertex ids of rows j and j+1
+#pragma omp parallel
+	{
+		vector<int> r0(f + 1), r1(f);
+#pragma omp for schedule(dynamic, 16)
+		for (int fj = 0; fj < 20 * f; ++fj)
+		{
+			const int     fi = fj / f, j = fj % f;
+			const EVec3f &c0 = C[F[fi][0]], &c1 = C[F[fi][1]], &c2 = C[F[fi][2]];
+
+			for (int i = 1; j > 0 && i + j < f; ++i)
+				setV(vid(fi, i, j), c0 + (c1 - c0) * ((float)i / f) + (c2 - c0) * ((float)j / f));
+
+			//row j : (f-j) upward and (f-j-1) downward triangles, rows before j : 2fj - j^2
+			for (int i = 0; i <= f - j; ++i) r0[i] = vid(fi, i, j);
+			for (int i = 0; i <  f - j; ++i) r1[i] = vid(fi, i, j + 1);
+
+			int *p = Ps + 3 * ((long long)fi * f * f + 2 * f * j - j * j);
+			for (int i = 0; i + j < f; ++i)
+			{
+				p[0] = r0[i]; p[1] = r0[i + 1]; p[2] = r1[i]; p += 3;
+				if (i + j + 1 < f) { p[0] = r0[i + 1]; p[1] = r1[i + 1]; p[2] = r1[i]; p += 3; }
+			}
+		}
+	}
+}
+
+
+
+//torus around the z axis, major radius R, minor radius r, M x N (>= 3) segments
+inline void t_genTorusSize(const int M, const int N, int &vSize, int &pSize)
+{
+	vSize = M * N;
+	pSize = 2 * M * N;
+}
+
+inline void t_genTorus(const float R, const float r, const int M, const int N, EVec3f *Vs, EVec3f *Ts, int *Ps)
+{
+#pragma omp parallel for
+	for (int j = 0; j < N; ++j)
+	{
+		const double v = 2 * M_PI * j / N;
+		for (int i = 0; i < M; ++i)
+		{
+			const double u = 2 * M_PI * i / M;
+			Vs[j * M + i] << (float)((R + r * cos(v)) * cos(u)), (float)((R + r * cos(v)) * sin(u)), (float)(r * sin(v));
+			Ts[j * M + i] << (float)i / M, (float)j / N, 0;
+
+			const int a = j * M + i, b = j * M + (i + 1) % M;
+			const int c = ((j + 1) % N) * M + i, d = ((j + 1) % N) * M + (i + 1) % M;
+			int *p = Ps + 6 * (j * M + i);
+			p[0] = a; p[1] = b; p[2] = d;
+			p[3] = a; p[4] = d; p[5] = c;
+		}
+	}
+}
+
+
+
+//plane w x h on z = 0 centered at the origin, M x N quads (normal +z)
+inline void t_genPlaneSize(const int M, const int N, int &vSize, int &pSize)
+{
+	vSize = (M + 1) * (N + 1);
+	pSize = 2 * M * N;
+}
+
+inline void t_genPlane(const float w, const float h, const int M, const int N, EVec3f *Vs, EVec3f *Ts, int *Ps)
+{
+#pragma omp parallel for
+	for (int j = 0; j <= N; ++j)
+	{
+		for (int i = 0; i <= M; ++i)
+		{
+			Vs[j * (M + 1) + i] << w * ((float)i / M - 0.5f), h * ((float)j / N - 0.5f), 0;
+			Ts[j * (M + 1) + i] << (float)i / M, (float)j / N, 0;
+			if (i == M || j == N) continue;
+
+			const int a = j * (M + 1) + i, b = a + 1, c = a + M + 1, d = c + 1;
+			int *p = Ps + 6 * (j * M + i);
+			p[0] = a; p[1] = b; p[2] = d;
+			p[3] = a; p[4] = d; p[5] = c;
+		}
+	}
+}
+
+
+
+//open cylinder (no caps) of radius r around the z axis, z in [-h/2, h/2], M (>= 3) segments x N rows
+inline void t_genCylinderSize(const int M, const int N, int &vSize, int &pSize)
+{
+	vSize = M * (N + 1);
+	pSize = 2 * M * N;
+}
+
+inline void t_genCylinder(const float r, const float h, const int M, const int N, EVec3f *Vs, EVec3f *Ts, int *Ps)
+{
+#pragma omp parallel for
+	for (int j = 0; j <= N; ++j)
+	{
+		for (int i = 0; i < M; ++i)
+		{
+			const double u = 2 * M_PI * i / M;
+			Vs[j * M + i] << (float)(r * cos(u)), (float)(r * sin(u)), h * ((float)j / N - 0.5f);
+			Ts[j * M + i] << (float)i / M, (float)j / N, 0;
+			if (j == N) continue;
+
+			const int a = j * M + i, b = j * M + (i + 1) % M, c = a + M, d = b + M;
+			int *p = Ps + 6 * (j * M + i);
+			p[0] = a; p[1] = b; p[2] = d;
+			p[3] = a; p[4] = d; p[5] = c;
+		}
+	}
+}
+
+
+
+//smooth deterministic noise field in about [-1,1] : 3 octaves of value noise (hashed lattice, quintic fade)
+inline float t_valueNoise3(const float x, const float y, const float z, const unsigned int seed)
+{
+	auto hash = [seed](int i, int j, int k)
+	{
+		unsigned int h = seed ^ ((unsigned int)i * 73856093u) ^ ((unsigned int)j * 19349663u) ^ ((unsigned int)k * 83492791u);
+		h ^= h >> 16; h *= 0x7feb352du; h ^= h >> 15; h *= 0x846ca68bu; h ^= h >> 16;
+		return (h >> 8) / (float)(1 << 23) - 1.0f;
+	};
+	auto fade = [](float t) { return t * t * t * (t * (t * 6 - 15) + 10); };
+
+	const int   ix = (int)floor(x), iy = (int)floor(y), iz = (int)floor(z);
+	const float fx = fade(x - ix), fy = fade(y - iy), fz = fade(z - iz);
+
+	float v[2][2];
+	for (int k = 0; k < 2; ++k)
+		for (int j = 0; j < 2; ++j)
+			v[k][j] = hash(ix, iy + j, iz + k) + fx * (hash(ix + 1, iy + j, iz + k) - hash(ix, iy + j, iz + k));
+
+	const float v0 = v[0][0] + fy * (v[0][1] - v[0][0]);
+	const float v1 = v[1][0] + fy * (v[1][1] - v[1][0]);
+	return v0 + fz * (v1 - v0);
+}
+
+inline float t_noiseField3(const EVec3f &p, const float freq, const unsigned int seed)
+{
+	float v = 0, a = 1, f = freq, aSum = 0;
+	for (int o = 0; o < 3; ++o, a *= 0.5f, f *= 2.0f)
+	{
+		v    += a * t_valueNoise3(f * p[0], f * p[1], f * p[2], seed + o);
+		aSum += a;
+	}
+	return v / aSum;
+}
+
+
+
+//TMesh members declared in tmesh.h
+
+inline void TMesh::initializeSphere(const double r, const int M, const int N)
+{
+	int vSize, pSize;
+	t_genUVSphereSize( max(3, M), max(2, N), vSize, pSize);
+	allocate(vSize, pSize);
+	t_genUVSphere( (float)r, max(3, M), max(2, N), m_vVerts, m_vTexCd, (int*)m_pPolys);
+	updateRingInfoParallel();
+	updateNormal();
+}
+
+inline void TMesh::initializeGeodesicSphere(const double r, const int level)
+{
+	int vSize, pSize;
+	t_genGeodesicSphereSize( max(0, level), vSize, pSize);
+	allocate(vSize, pSize);
+	t_genGeodesicSphere( (float)r, max(0, level), m_vVerts, m_vTexCd, (int*)m_pPolys);
+	updateRingInfoParallel();
+	updateNormal();
+}
+
+inline void TMesh::initializeTorus(const double R, const double r, const int M, const int N)
+{
+	int vSize, pSize;
+	t_genTorusSize( max(3, M), max(3, N), vSize, pSize);
+	allocate(vSize, pSize);
+	t_genTorus( (float)R, (float)r, max(3, M), max(3, N), m_vVerts, m_vTexCd, (int*)m_pPolys);
+	updateRingInfoParallel();
+	updateNormal();
+}
+
+inline void TMesh::initializePlane(const double w, const double h, const int M, const int N)
+{
+	int vSize, pSize;
+	t_genPlaneSize( max(1, M), max(1, N), vSize, pSize);
+	allocate(vSize, pSize);
+	t_genPlane( (float)w, (float)h, max(1, M), max(1, N), m_vVerts, m_vTexCd, (int*)m_pPolys);
+	updateRingInfoParallel();
+	updateNormal();
+}
+
+inline void TMesh::initializeCylinder(const double r, const double h, const int M, const int N)
+{
+	int vSize, pSize;
+	t_genCylinderSize( max(3, M), max(1, N), vSize, pSize);
+	allocate(vSize, pSize);
+	t_genCylinder( (float)r, (float)h, max(3, M), max(1, N), m_vVerts, m_vTexCd, (int*)m_pPolys);
+	updateRingInfoParallel();
+	updateNormal();
+}
+
+inline void TMesh::addNoise(const float amp, const float freq, const unsigned int seed = 0)
+{
+#pragma omp parallel for
+	for( int i=0; i < m_vSize; ++i) m_vVerts[i] += amp * t_noiseField3(m_vVerts[i], freq, seed) * m_vNorms[i];
+	updateNormal();
+}
@@ -0,0 +1,390 @@
+#pragma once
+
+#include "tmath.h"
+#include "thalfedge.h"
+#include "tmesh.h"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * vertex / face reordering for memory locality
+ *
+ * Meshes from scanners or from t_MarchingCubes come in arbitrary or slice order,
+ * so one ring traversals (Dijkstra / exp map front, smoothing gathers) jump around memory.
+ *
+ * vertex orders (order[i] : old index of the i-th new vertex)
+ *   VORDER_MORTON  : Morton (z-order) key of the position quantized to 1024^3 in the bounding cube
+ *   VORDER_HILBERT : Hilbert key of the same grid (Skilling's transpose), no jumps between octants
+ *   VORDER_RCM     : reverse Cuthill-McKee on the one ring graph (small bandwidth,
+ *                    BFS from a pseudo peripheral vertex of each connected component)
+ * The keys are sorted with t_radixSortPairs (stable, ties keep the input order).
+ *
+ * face order : Forsyth's linear speed vertex cache optimization (LRU cache of 32 vertices),
+ * consecutive faces share vertices, so per face loops touch few new vertices.
+-------------------------------------------------------------------*/
+
+enum TVertexOrder : int
+{
+	VORDER_NONE    = 0,
+	VORDER_MORTON  = 1,
+	VORDER_HILBERT = 2,
+	VORDER_RCM     = 3
+};
+
+
+
+// positions -> 10 bit grid coordinates of the bounding cube
+inline void t_quantizeVerts(const int vSize, const EVec3f *verts, vector<unsigned int> &q)
+{
+	EVec3f minV( FLT_MAX,  FLT_MAX,  FLT_MAX);
+	EVec3f maxV(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < vSize; ++i)
+	{
+		minV = minV.cwiseMin(verts[i]);
+		maxV = maxV.cwiseMax(verts[i]);
+	}
+	const float ext = (maxV - minV).maxCoeff();
+	const float s   = (ext > 0) ? 1023.0f / ext : 0.0f;
+
+	q.resize(3 * (size_t)vSize);
+#pragma omp parallel for
+	for (int i = 0; i < vSize; ++i)
+		for (int d = 0; d < 3; ++d) q[3 * i + d] = min(1023u, (unsigned int)((verts[i][d] - minV[d]) * s));
+}
+
+
+
+// 10 bits of x -> every third bit of 30
+inline unsigned long long t_spreadBits3(unsigned long long x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x <<  8)) & 0x0300f00f;
+	x = (x | (x <<  4)) & 0x030c30c3;
+	x = (x | (x <<  2)) & 0x09249249;
+	return x;
+}
+
+inline unsigned long long t_mortonKey3(const unsigned int x, const unsigned int y, const unsigned int z)
+{
+	return t_spreadBits3(x) | (t_spreadBits3(y) << 1) | (t_spreadBits3(z) << 2);
+}
+
+// Hilbert index of (x,y,z) on a 2^10 grid (J. Skilling, "Programming the Hilbert curve", 2004)
+inline unsigned long long t_hilbertKey3(unsigned int x, unsigned int y, unsigned int z)
+{
+	const int B = 10;
+	unsigned int X[3] = { x, y, z };
+
+	//inverse undo
+	for (unsigned int Q = 1u << (B - 1); Q > 1; Q >>= 1)
+	{
+		const unsigned int P = Q - 1;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (X[i] & Q) X[0] ^= P;
+			else
+			{
+				const unsigned int t = (X[0] ^ X[i]) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+
+	//gray encode
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	unsigned int t = 0;
+	for (unsigned int Q = 1u << (B - 1); Q > 1; Q >>= 1) if (X[2] & Q) t ^= Q - 1;
+	for (int i = 0; i < 3; ++i) X[i] ^= t;
+
+	//transpose -> key (msb first)
+	unsigned long long key = 0;
+	for (int b = B - 1; b >= 0; --b)
+		for (int i = 0; i < 3; ++i) key = (key << 1) | ((X[i] >> b) & 1);
+	return key;
+}
+
+
+
+// space filling curve order of the vertices (bHilbert : Hilbert, otherwise Morton)
+inline void t_vertexOrderSFC(const int vSize, const EVec3f *verts, const bool bHilbert, vector<int> &order)
+{
+	order.resize(vSize);
+	if (vSize == 0) return;
+
+	vector<unsigned int> q;
+	t_quantizeVerts(vSize, verts, q);
+
+	vector<unsigned long long> keys(vSize), tmpK(vSize);
+	vector<int>                tmpV(vSize);
+#pragma omp parallel for
+	for (int i = 0; i < vSize; ++i)
+	{
+		const unsigned int *c = &q[3 * i];
+		keys [i] = bHilbert ? t_hilbertKey3(c[0], c[1], c[2]) : t_mortonKey3(c[0], c[1], c[2]);
+		order[i] = i;
+	}
+	t_radixSortPairs(vSize, 30, keys.data(), order.data(), tmpK.data(), tmpV.data());
+}
+
+
+
+// reverse Cuthill-McKee order of the one ring graph
+inline void t_vertexOrderRCM(const int vSize, const vector<int> *ringVs, vector<int> &order)
+{
+	order.clear();
+	order.reserve(vSize);
+	if (vSize == 0) return;
+
+	vector<int>  level(vSize, -1); //BFS level of the pseudo peripheral search
+	vector<int>  stamp(vSize, -1); //BFS id of the level
+	vector<char> bDone(vSize, 0 );
+	vector<int>  que;
+	que.reserve(vSize);
+	int bfsId = 0;
+
+	//BFS from s, returns the eccentricity of s and a vertex of minimum degree in the last level
+	auto bfs = [&](const int s, int &last) -> int
+	{
+		++bfsId;
+		que.clear();
+		que.push_back(s);
+		stamp[s] = bfsId;
+		level[s] = 0;
+		for (size_t i = 0; i < que.size(); ++i)
+		{
+			const int v = que[i];
+			for (const auto &w : ringVs[v]) if (stamp[w] != bfsId)
+			{
+				stamp[w] = bfsId;
+				level[w] = level[v] + 1;
+				que.push_back(w);
+			}
+		}
+		const int ecc = level[que.back()];
+		last = que.back();
+		for (size_t i = que.size(); i-- > 0 && level[que[i]] == ecc; )
+			if (ringVs[que[i]].size() < ringVs[last].size()) last = que[i];
+		return ecc;
+	};
+
+	vector<int> nei;
+	for (int v0 = 0; v0 < vSize; ++v0)
+	{
+		if (bDone[v0]) continue;
+
+		//pseudo peripheral vertex (George & Liu)
+		int s = v0, last;
+		int ecc = bfs(s, last);
+		for (int it = 0; it < 8; ++it)
+		{
+			int last2;
+			const int e = bfs(last, last2);
+			if (e <= ecc) break;
+			s   = last;
+			ecc = e;
+			last = last2;
+		}
+
+		//Cuthill-McKee : BFS visiting the neighbors in increasing degree
+		size_t head = order.size();
+		order.push_back(s);
+		bDone[s] = 1;
+		for (; head < order.size(); ++head)
+		{
+			nei.clear();
+			for (const auto &w : ringVs[order[head]]) if (!bDone[w])
+			{
+				bDone[w] = 1;
+				nei.push_back(w);
+			}
+			stable_sort(nei.begin(), nei.end(), [&](const int a, const int b) { return ringVs[a].size() < ringVs[b].size(); });
+			order.insert(order.end(), nei.begin(), nei.end());
+		}
+	}
+	reverse(order.begin(), order.end());
+}
+
+
+
+// Forsyth's vertex cache optimization, order[i] : old index of the i-th new face
+// polys : 3 * pSize vertex indices (< vSize)
+inline void t_faceOrderForsyth(const int vSize, const int pSize, const int *polys, vector<int> &order)
+{
+	const int CACHE = 32, VALENCE_MAX = 32;
+	order.clear();
+	order.reserve(pSize);
+	if (pSize == 0) return;
+
+	//score tables (cache position / remaining valence)
+	float posScore[CACHE], valScore[VALENCE_MAX + 1];
+	for (int i = 0; i < CACHE; ++i) posScore[i] = (i < 3) ? 0.75f : powf(1.0f - (i - 3) / (float)(CACHE - 3), 1.5f);
+	valScore[0] = 0;
+	for (int i = 1; i <= VALENCE_MAX; ++i) valScore[i] = 2.0f / sqrtf((float)i);
+
+	//vertex -> faces (the first vRemain[v] entries are the faces not yet emitted)
+	vector<int> vOfs(vSize + 1, 0), vFaces(3 * (size_t)pSize), vRemain(vSize, 0);
+	for (int i = 0; i < 3 * pSize; ++i) ++vOfs[polys[i] + 1];
+	for (int v = 0; v < vSize; ++v) vOfs[v + 1] += vOfs[v];
+	for (int i = 0; i < 3 * pSize; ++i) vFaces[vOfs[polys[i]] + vRemain[polys[i]]++] = i / 3;
+
+	vector<int>   vCachePos(vSize, -1);
+	vector<float> vScore(vSize);
+	vector<char>  fDone(pSize, 0);
+
+	auto vertexScore = [&](const int v) -> float
+	{
+		if (vRemain[v] == 0) return -1.0f;
+		const float s = (vCachePos[v] < 0) ? 0.0f : posScore[vCachePos[v]];
+		return s + valScore[min(vRemain[v], VALENCE_MAX)];
+	};
+
+	for (int v = 0; v < vSize; ++v) vScore[v] = vertexScore(v);
+
+	int cache[CACHE + 3], cacheN = 0, tmp[CACHE + 3];
+	int best = 0, scan = 0;
+
+	while (best >= 0)
+	{
+		order.push_back(best);
+		fDone[best] = 1;
+		const int *p = &polys[3 * best];
+
+		//remove the face from its vertices
+		for (int k = 0; k < 3; ++k)
+		{
+			const int v = p[k];
+			int *vf = &vFaces[vOfs[v]];
+			for (int j = 0; j < vRemain[v]; ++j) if (vf[j] == best)
+			{
+				swap(vf[j], vf[vRemain[v] - 1]);
+				break;
+			}
+			--vRemain[v];
+		}
+
+		//new cache : the three vertices on top, then the old entries
+		int n = 0;
+		for (int k = 0; k < 3; ++k) tmp[n++] = p[k];
+		for (int i = 0; i < cacheN; ++i) if (cache[i] != p[0] && cache[i] != p[1] && cache[i] != p[2]) tmp[n++] = cache[i];
+		for (int i = 0; i < n; ++i)
+		{
+			cache[i] = tmp[i];
+			vCachePos[tmp[i]] = (i < CACHE) ? i : -1;
+		}
+		cacheN = min(n, CACHE);
+
+		//rescore the vertices of the cache (and the evicted ones) and their faces
+		for (int i = 0; i < n; ++i) vScore[cache[i]] = vertexScore(cache[i]);
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < n; ++i)
+		{
+			const int v = cache[i];
+			for (int j = 0; j < vRemain[v]; ++j)
+			{
+				const int f = vFaces[vOfs[v] + j];
+				const int *q = &polys[3 * f];
+				const float s = vScore[q[0]] + vScore[q[1]] + vScore[q[2]];
+				if (s > bestScore) { bestScore = s; best = f; }
+			}
+		}
+
+		//no candidate in the cache : next face in the input order
+		if (best < 0)
+		{
+			while (scan < pSize && fDone[scan]) ++scan;
+			if (scan < pSize) best = scan;
+		}
+	}
+}
+
+
+
+// average cache miss ratio (misses per face) of a FIFO vertex cache, for diagnostics
+inline float t_faceOrderACMR(const int pSize, const int *polys, const int vSize, const int cacheSize = 16)
+{
+	if (pSize == 0) return 0;
+	vector<int> stampIn(vSize, -cacheSize - 1);
+	int misses = 0;
+	for (int i = 0; i < 3 * pSize; ++i)
+	{
+		if (misses - stampIn[polys[i]] < cacheSize) continue;
+		stampIn[polys[i]] = misses++;
+	}
+	return misses / (float)pSize;
+}
+
+
+
+//TMesh members declared in tmesh.h
+
+inline void TMesh::reorder(TVertexOrder vOrder = VORDER_HILBERT, bool bFaceOrder = true, vector<int> *vNewIdx = 0, vector<int> *pNewIdx = 0)
+{
+	TPROF_SCOPE("TMesh::reorder");
+	vector<int> vOld, pOld; //old index of each new vertex / face
+
+	if(      vOrder == VORDER_MORTON || vOrder == VORDER_HILBERT ) t_vertexOrderSFC(m_vSize, m_vVerts, vOrder == VORDER_HILBERT, vOld);
+	else if( vOrder == VORDER_RCM ) t_vertexOrderRCM(m_vSize, m_vRingVs, vOld);
+	else { vOld.resize(m_vSize); for( int i=0; i < m_vSize; ++i) vOld[i] = i; }
+
+	vector<int> vNew(m_vSize);
+	for( int i=0; i < m_vSize; ++i) vNew[vOld[i]] = i;
+
+	//vertices
+	{
+		EVec3f *Vs = new EVec3f[m_vSize];
+		EVec3f *Ts = new EVec3f[m_vSize];
+		EVec3f *Ns = new EVec3f[m_vSize];
+#pragma omp parallel for
+		for( int i=0; i < m_vSize; ++i)
+		{
+			Vs[i] = m_vVerts[vOld[i]];
+			Ts[i] = m_vTexCd[vOld[i]];
+			Ns[i] = m_vNorms[vOld[i]];
+		}
+		delete[] m_vVerts; m_vVerts = Vs;
+		delete[] m_vTexCd; m_vTexCd = Ts;
+		delete[] m_vNorms; m_vNorms = Ns;
+	}
+
+	//faces (indices renumbered first, the face order depends on the new vertex indices)
+#pragma omp parallel for
+	for( int i=0; i < m_pSize; ++i)
+		for( int k=0; k < 3; ++k) m_pPolys[i].idx[k] = vNew[ m_pPolys[i].idx[k] ];
+
+	if( bFaceOrder ) t_faceOrderForsyth(m_vSize, m_pSize, (const int*)m_pPolys, pOld);
+	else { pOld.resize(m_pSize); for( int i=0; i < m_pSize; ++i) pOld[i] = i; }
+
+	{
+		TPoly  *Ps = new TPoly [m_pSize];
+		EVec3f *Ns = new EVec3f[m_pSize];
+#pragma omp parallel for
+		for( int i=0; i < m_pSize; ++i)
+		{
+			Ps[i] = m_pPolys[pOld[i]];
+			Ns[i] = m_pNorms[pOld[i]];
+		}
+		delete[] m_pPolys; m_pPolys = Ps;
+		delete[] m_pNorms; m_pNorms = Ns;
+	}
+
+	updateRingInfo();
+
+	if( vNewIdx ) vNewIdx->swap(vNew);
+	if( pNewIdx )
+	{
+		pNewIdx->resize(m_pSize);
+		for( int i=0; i < m_pSize; ++i) (*pNewIdx)[pOld[i]] = i;
+	}
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "tmath.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * Laplacian smoothing engine for TMesh
+ *
+ * p_i <- p_i + lambda * ( sum_j w_ij p_j - p_i ),  sum_j w_ij = 1
+ *
+ * SMOOTH_UNIFORM   : w_ij = 1 / |ring(i)|
+ * SMOOTH_COTANGENT : w_ij ~ (cot a_ij + cot b_ij) / 2 (negative cotangents are clamped to 0,
+ *                    recomputed from the current positions at each Smooth() call)
+ * SMOOTH_TAUBIN    : uniform weights, a lambda step followed by a mu step (mu < -lambda)
+ *                    per iteration, which cancels the shrinkage
+ *
+ * The one ring adjacency is stored in CSR (rowPtr / col / w), built once per topology.
+ * The coordinates are copied into SoA arrays (x[], y[], z[]) which are double buffered
+ * and kept as a persistent scratch buffer between calls.
+ * With AVX2, the CSR rows are also stored as slices of 8 rows padded to the longest row
+ * (column major, padding points to a zero dummy vertex), so that one iteration
+ * is a sequence of 8-wide gathers per slice without horizontal sums.
+-------------------------------------------------------------------*/
+
+enum TSmoothMode
+{
+	SMOOTH_UNIFORM   = 0,
+	SMOOTH_COTANGENT = 1,
+	SMOOTH_TAUBIN    = 2
+};
+
+
+
+class TMeshSmoother
+{
+	enum { SL = 8 }; //slice height
+
+	int           m_vSize ;
+
+	//CSR one ring (rows without neighbors have a single self entry)
+	vector<int>   m_rowPtr;
+	vector<int>   m_col   ;
+	vector<float> m_w     ;
+
+	//sliced copy of the CSR (entry k of row r0+l is at m_sOfs[s] + k * SL + l)
+	vector<int>   m_sOfs  ;
+	vector<int>   m_sCol  ;
+	vector<float> m_sW    ;
+
+	//SoA coordinates (double buffered, index m_sN * SL is the zero dummy)
+	int           m_sN    ;
+	vector<float> m_X[2], m_Y[2], m_Z[2];
+
+public:
+	TMeshSmoother()
+	{
+		m_vSize = 0;
+		m_sN    = 0;
+	}
+
+	void clear()
+	{
+		m_vSize = 0;
+		m_sN    = 0;
+		m_rowPtr.clear(); m_col.clear(); m_w.clear();
+		m_sOfs  .clear(); m_sCol.clear(); m_sW.clear();
+		for (int i = 0; i < 2; ++i) { m_X[i].clear(); m_Y[i].clear(); m_Z[i].clear(); }
+	}
+
+	bool isBuilt(const int vSize) const { return m_vSize == vSize && !m_rowPtr.empty(); }
+
+	int          getVSize () const { return m_vSize ; }
+	const int   *getRowPtr() const { return m_rowPtr.data(); }
+	const int   *getCol   () const { return m_col   .data(); }
+	const float *getWeight() const { return m_w     .data(); }
+
+
+
+	// ringVs : sorted one ring vertices of each vertex (TMesh::m_vRingVs)
+	void Build(const int vSize, const vector<int> *ringVs)
+	{
+		clear();
+		m_vSize = vSize;
+		m_sN    = (vSize + SL - 1) / SL;
+
+		m_rowPtr.resize(vSize + 1);
+		m_rowPtr[0] = 0;
+		for (int i = 0; i < vSize; ++i) m_rowPtr[i + 1] = m_rowPtr[i] + max(1, (int)ringVs[i].size());
+
+		m_col.resize(m_rowPtr[vSize]);
+		m_w  .resize(m_rowPtr[vSize]);
+
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			int *c = &m_col[m_rowPtr[i]];
+			if (ringVs[i].empty()) c[0] = i;
+			else for (int k = 0; k < (int)ringVs[i].size(); ++k) c[k] = ringVs[i][k];
+		}
+
+		const int dummy = m_sN * SL;
+#ifdef __AVX2__
+		//slices
+		m_sOfs.resize(m_sN + 1);
+		m_sOfs[0] = 0;
+		for (int s = 0; s < m_sN; ++s)
+		{
+			int len = 0;
+			for (int r = s * SL; r < min(vSize, s * SL + SL); ++r) len = max(len, m_rowPtr[r + 1] - m_rowPtr[r]);
+			m_sOfs[s + 1] = m_sOfs[s] + len * SL;
+		}
+		m_sCol.assign(m_sOfs[m_sN], dummy);
+		m_sW  .assign(m_sOfs[m_sN], 0.0f);
+
+#pragma omp parallel for
+		for (int s = 0; s < m_sN; ++s)
+		{
+			for (int l = 0; l < SL && s * SL + l < vSize; ++l)
+			{
+				const int r = s * SL + l;
+				for (int k = m_rowPtr[r]; k < m_rowPtr[r + 1]; ++k) m_sCol[m_sOfs[s] + (k - m_rowPtr[r]) * SL + l] = m_col[k];
+			}
+		}
+#endif
+
+		for (int i = 0; i < 2; ++i)
+		{
+			m_X[i].assign(dummy + 1, 0.0f);
+			m_Y[i].assign(dummy + 1, 0.0f);
+			m_Z[i].assign(dummy + 1, 0.0f);
+		}
+	}
+
+
+
+	// normalized weights of the current positions
+	void UpdateWeights(const EVec3f *verts, const vector<int> *ringPs, const int *polys, const bool bCotangent)
+	{
+		ComputeWeights(verts, ringPs, polys, bCotangent, true, m_w.data());
+
+#ifdef __AVX2__
+		const int vSize = m_vSize;
+#pragma omp parallel for
+		for (int s = 0; s < m_sN; ++s)
+		{
+			for (int l = 0; l < SL && s * SL + l < vSize; ++l)
+			{
+				const int r = s * SL + l;
+				for (int k = m_rowPtr[r]; k < m_rowPtr[r + 1]; ++k) m_sW[m_sOfs[s] + (k - m_rowPtr[r]) * SL + l] = m_w[k];
+			}
+		}
+#endif
+	}
+
+
+
+	// weights of the CSR entries -> w[rowPtr[vSize]]
+	// uniform : 1, cotangent : (cot a_ij + cot b_ij) / 2 clamped to >= 0 (uniform if all of a row are 0)
+	// bNormalize : each row sums to 1
+	void ComputeWeights(const EVec3f *verts, const vector<int> *ringPs, const int *polys, const bool bCotangent, const bool bNormalize, float *weight) const
+	{
+		const int vSize = m_vSize;
+
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			const int    k0 = m_rowPtr[i], n = m_rowPtr[i + 1] - k0;
+			const int   *c  = &m_col[k0];
+			float       *w  = &weight[k0];
+
+			float sum = 0;
+			if (bCotangent)
+			{
+				for (int k = 0; k < n; ++k) w[k] = 0;
+				for (const auto &pi : ringPs[i])
+				{
+					const int *p = &polys[3 * pi];
+					const int  o = (p[0] == i) ? 0 : (p[1] == i) ? 1 : 2;
+					const int  j = p[(o + 1) % 3], h = p[(o + 2) % 3];
+
+					//edge (i,j) is opposite to h, edge (i,h) is opposite to j
+					w[lower_bound(c, c + n, j) - c] += 0.5f * max(0.0f, cotangent(verts[i], verts[j], verts[h]));
+					w[lower_bound(c, c + n, h) - c] += 0.5f * max(0.0f, cotangent(verts[i], verts[h], verts[j]));
+				}
+				for (int k = 0; k < n; ++k) sum += w[k];
+			}
+
+			if (sum <= 0)
+			{
+				for (int k = 0; k < n; ++k) w[k] = 1.0f;
+				sum = (float)n;
+			}
+			if (bNormalize) for (int k = 0; k < n; ++k) w[k] /= sum;
+		}
+	}
+
+
+
+	// n iterations of p <- p + lambda L p  (and p <- p + mu L p if mu != 0)
+	void Smooth(EVec3f *verts, const int n, const float lambda, const float mu)
+	{
+		const int vSize = m_vSize;
+
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			m_X[0][i] = verts[i][0];
+			m_Y[0][i] = verts[i][1];
+			m_Z[0][i] = verts[i][2];
+		}
+
+		int cur = 0;
+		for (int it = 0; it < n; ++it)
+		{
+			step(cur, lambda); cur = 1 - cur;
+			if (mu != 0) { step(cur, mu); cur = 1 - cur; }
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i) verts[i] << m_X[cur][i], m_Y[cur][i], m_Z[cur][i];
+	}
+
+private:
+	// cotangent of the angle at c in triangle (a,b,c)
+	static float cotangent(const EVec3f &a, const EVec3f &b, const EVec3f &c)
+	{
+		const EVec3f u = a - c, v = b - c;
+		const float  s = u.cross(v).norm();
+		return (s > 0) ? u.dot(v) / s : 0.0f;
+	}
+
+	// buffer src -> buffer 1-src
+	void step(const int src, const float lambda)
+	{
+		const float *X  = m_X[src]    .data(), *Y  = m_Y[src]    .data(), *Z  = m_Z[src]    .data();
+		float       *oX = m_X[1 - src].data(), *oY = m_Y[1 - src].data(), *oZ = m_Z[1 - src].data();
+
+#ifdef __AVX2__
+		const __m256 lm = _mm256_set1_ps(lambda);
+
+#pragma omp parallel for schedule(static)
+		for (int s = 0; s < m_sN; ++s)
+		{
+			__m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+			for (int k = m_sOfs[s]; k < m_sOfs[s + 1]; k += SL)
+			{
+				const __m256i c = _mm256_loadu_si256((const __m256i*)&m_sCol[k]);
+				const __m256  w = _mm256_loadu_ps(&m_sW[k]);
+				sx = _mm256_add_ps(sx, _mm256_mul_ps(w, _mm256_i32gather_ps(X, c, 4)));
+				sy = _mm256_add_ps(sy, _mm256_mul_ps(w, _mm256_i32gather_ps(Y, c, 4)));
+				sz = _mm256_add_ps(sz, _mm256_mul_ps(w, _mm256_i32gather_ps(Z, c, 4)));
+			}
+			const int r = s * SL;
+			const __m256 px = _mm256_loadu_ps(X + r), py = _mm256_loadu_ps(Y + r), pz = _mm256_loadu_ps(Z + r);
+			_mm256_storeu_ps(oX + r, _mm256_add_ps(px, _mm256_mul_ps(lm, _mm256_sub_ps(sx, px))));
+			_mm256_storeu_ps(oY + r, _mm256_add_ps(py, _mm256_mul_ps(lm, _mm256_sub_ps(sy, py))));
+			_mm256_storeu_ps(oZ + r, _mm256_add_ps(pz, _mm256_mul_ps(lm, _mm256_sub_ps(sz, pz))));
+		}
+#else
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < m_vSize; ++i)
+		{
+			float sx = 0, sy = 0, sz = 0;
+			for (int k = m_rowPtr[i]; k < m_rowPtr[i + 1]; ++k)
+			{
+				const int   c = m_col[k];
+				const float w = m_w  [k];
+				sx += w * X[c];
+				sy += w * Y[c];
+				sz += w * Z[c];
+			}
+			oX[i] = X[i] + lambda * (sx - X[i]);
+			oY[i] = Y[i] + lambda * (sy - Y[i]);
+			oZ[i] = Z[i] + lambda * (sz - Z[i]);
+		}
+#endif
+	}
+};
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "tmath.h"
+#include "thalfedge.h"
+#include "tmesh.h"
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * triangle mesh subdivision
+ *
+ * the edges are those of TMeshEdges (thalfedge.h) : the new vertex of an edge is vSize + edge id,
+ * so no hash map is needed while subdividing.
+ *
+ * t_subdivideUniform : every face -> 4 faces (4f .. 4f+3), new vertex of edge e = vSize + e
+ *   SUBDIV_MIDPOINT : new vertices at the edge midpoints, old vertices kept
+ *   SUBDIV_LOOP     : Loop rules (Warren weights), border / non-manifold edges (not two faces)
+ *                     are creases : cubic B-spline rule on the crease, corners are kept
+ *
+ * t_subdivideAdaptiveMark / t_subdivideAdaptive : red-green refinement of a face subset (midpoint)
+ *   the given faces are split into 4 (red), faces with 2 or 3 split edges become red as well,
+ *   faces with one split edge are bisected (green), so the result has no T-junction.
+ *   Face f keeps its index (first child), the other children are appended after pSize,
+ *   so the adjacency of the untouched part of the mesh stays valid (TMesh updates it incrementally).
+ *
+ * texture coordinates are interpolated linearly (edge midpoints).
+-------------------------------------------------------------------*/
+
+enum TSubdivMode : int
+{
+	SUBDIV_MIDPOINT = 0,
+	SUBDIV_LOOP     = 1
+};
+
+
+
+//newVerts / newTexCd : vSize + E.m_eSize, newPolys : 3 * 4 * pSize
+//ringVs : one ring of the old vertices (used by SUBDIV_LOOP)
+inline void t_subdivideUniform(
+	const TSubdivMode   mode    ,
+	const int           vSize   ,
+	const EVec3f       *verts   ,
+	const EVec3f       *texCd   ,
+	const vector<int>  *ringVs  ,
+	const int           pSize   ,
+	const int          *polys   ,
+	const TMeshEdges   &E       ,
+	EVec3f             *newVerts,
+	EVec3f             *newTexCd,
+	int                *newPolys)
+{
+	const bool bLoop = (mode == SUBDIV_LOOP);
+
+	//edge vertices
+#pragma omp parallel for
+	for (int e = 0; e < E.m_eSize; ++e)
+	{
+		const int a = E.m_eVerts[2 * e], b = E.m_eVerts[2 * e + 1];
+		newTexCd[vSize + e] = 0.5f * (texCd[a] + texCd[b]);
+
+		if (bLoop && E.faceNum(e) == 2)
+		{
+			const int c = TMeshEdges::oppVertex(polys, E.m_eHalf[E.m_eOff[e]    ]);
+			const int d = TMeshEdges::oppVertex(polys, E.m_eHalf[E.m_eOff[e] + 1]);
+			newVerts[vSize + e] = 0.375f * (verts[a] + verts[b]) + 0.125f * (verts[c] + verts[d]);
+		}
+		else newVerts[vSize + e] = 0.5f * (verts[a] + verts[b]);
+	}
+
+	//old vertices
+	if (!bLoop)
+	{
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			newVerts[i] = verts[i];
+			newTexCd[i] = texCd[i];
+		}
+	}
+	else
+	{
+		//crease edges (border / non-manifold) : number and sum of the crease neighbors
+		vector<int>    creaseN(vSize, 0);
+		vector<EVec3f> creaseP(vSize, EVec3f(0, 0, 0));
+		for (int e = 0; e < E.m_eSize; ++e)
+		{
+			if (E.faceNum(e) == 2) continue;
+			const int a = E.m_eVerts[2 * e], b = E.m_eVerts[2 * e + 1];
+			++creaseN[a]; creaseP[a] += verts[b];
+			++creaseN[b]; creaseP[b] += verts[a];
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < vSize; ++i)
+		{
+			newTexCd[i] = texCd[i];
+			const int n = (int)ringVs[i].size();
+
+			if (creaseN[i] == 0 && n >= 3)
+			{
+				const float beta = (n == 3) ? 3.0f / 16.0f : 3.0f / (8.0f * n);
+				EVec3f s(0, 0, 0);
+				for (const auto &w : ringVs[i]) s += verts[w];
+				newVerts[i] = (1 - n * beta) * verts[i] + beta * s;
+			}
+			else if (creaseN[i] == 2) newVerts[i] = 0.75f * verts[i] + 0.125f * creaseP[i];
+			else                      newVerts[i] = verts[i];
+		}
+	}
+
+	//faces : (a, ab, ca), (ab, b, bc), (ca, bc, c), (ab, bc, ca)
+#pragma omp parallel for
+	for (int f = 0; f < pSize; ++f)
+	{
+		const int *p  = polys + 3 * f;
+		const int  ab = vSize + E.m_hEdge[3 * f], bc = vSize + E.m_hEdge[3 * f + 1], ca = vSize + E.m_hEdge[3 * f + 2];
+		int *q = newPolys + 12 * (size_t)f;
+		q[0] = p[0]; q[ 1] = ab  ; q[ 2] = ca  ;
+		q[3] = ab  ; q[ 4] = p[1]; q[ 5] = bc  ;
+		q[6] = ca  ; q[ 7] = bc  ; q[ 8] = p[2];
+		q[9] = ab  ; q[10] = bc  ; q[11] = ca  ;
+	}
+}
+
+
+
+//faces : faces to refine
+//flg[f]   : 0 kept, 1 bisected (green), 2 split into 4 (red)
+//eNew[e]  : new vertex index of a split edge (-1 : not split)
+//pChild[f]: index of the first appended child of f (children of f : f, pChild[f], pChild[f]+1, ...)
+//newVSize / newPSize : sizes after refinement
+inline void t_subdivideAdaptiveMark(
+	const int          vSize ,
+	const int          pSize ,
+	const TMeshEdges  &E     ,
+	const vector<int> &faces ,
+	vector<char>      &flg   ,
+	vector<int>       &eNew  ,
+	vector<int>       &pChild,
+	int               &newVSize,
+	int               &newPSize)
+{
+	flg .assign(pSize, 0);
+	eNew.assign(E.m_eSize, -1);
+
+	vector<char> eSplit(E.m_eSize, 0);
+	vector<int>  redQ;
+	for (const auto &f : faces) if (0 <= f && f < pSize && flg[f] != 2) { flg[f] = 2; redQ.push_back(f); }
+
+	//closure : split the edges of red faces, faces with >= 2 split edges become red
+	while (!redQ.empty())
+	{
+		const int f = redQ.back();
+		redQ.pop_back();
+		for (int k = 0; k < 3; ++k)
+		{
+			const int e = E.m_hEdge[3 * f + k];
+			if (eSplit[e]) continue;
+			eSplit[e] = 1;
+
+			for (int i = E.m_eOff[e]; i < E.m_eOff[e + 1]; ++i)
+			{
+				const int g = E.m_eHalf[i] / 3;
+				if (flg[g] == 2) continue;
+				const int n = eSplit[E.m_hEdge[3 * g]] + eSplit[E.m_hEdge[3 * g + 1]] + eSplit[E.m_hEdge[3 * g + 2]];
+				if (n >= 2) { flg[g] = 2; redQ.push_back(g); }
+			}
+		}
+	}
+
+	newVSize = vSize;
+	for (int e = 0; e < E.m_eSize; ++e) if (eSplit[e]) eNew[e] = newVSize++;
+
+	pChild.assign(pSize, -1);
+	newPSize = pSize;
+	for (int f = 0; f < pSize; ++f)
+	{
+		if (flg[f] != 2 && (eSplit[E.m_hEdge[3 * f]] || eSplit[E.m_hEdge[3 * f + 1]] || eSplit[E.m_hEdge[3 * f + 2]])) flg[f] = 1;
+		if (flg[f] == 0) continue;
+		pChild[f]  = newPSize;
+		newPSize  += (flg[f] == 2) ? 3 : 1;
+	}
+}
+
+
+
+//newVerts / newTexCd / newPolys : arrays of newVSize / newPSize whose first vSize / pSize entries
+//already hold the old mesh; the new vertices and the refined faces are written
+inline void t_subdivideAdaptive(
+	const int           pSize   ,
+	const TMeshEdges   &E       ,
+	const vector<char> &flg     ,
+	const vector<int>  &eNew    ,
+	const vector<int>  &pChild  ,
+	EVec3f             *newVerts,
+	EVec3f             *newTexCd,
+	int                *newPolys)
+{
+#pragma omp parallel for
+	for (int e = 0; e < E.m_eSize; ++e)
+	{
+		if (eNew[e] < 0) continue;
+		const int a = E.m_eVerts[2 * e], b = E.m_eVerts[2 * e + 1];
+		newVerts[eNew[e]] = 0.5f * (newVerts[a] + newVerts[b]);
+		newTexCd[eNew[e]] = 0.5f * (newTexCd[a] + newTexCd[b]);
+	}
+
+#pragma omp parallel for
+	for (int f = 0; f < pSize; ++f)
+	{
+		if (flg[f] == 0) continue;
+		int       *p = newPolys + 3 * f;
+		const int  v[3] = { p[0], p[1], p[2] };
+		const int  m[3] = { eNew[E.m_hEdge[3 * f]], eNew[E.m_hEdge[3 * f + 1]], eNew[E.m_hEdge[3 * f + 2]] };
+		int       *q = newPolys + 3 * pChild[f];
+
+		if (flg[f] == 2)
+		{
+			p[0] = m[0]; p[1] = m[1]; p[2] = m[2];
+			q[0] = v[0]; q[1] = m[0]; q[2] = m[2];
+			q[3] = m[0]; q[4] = v[1]; q[5] = m[1];
+			q[6] = m[2]; q[7] = m[1]; q[8] = v[2];
+		}
+		else
+		{
+			const int k = (m[0] >= 0) ? 0 : (m[1] >= 0) ? 1 : 2;
+			p[0] = v[k]  ; p[1] = m[k]        ; p[2] = v[(k + 2) % 3];
+			q[0] = m[k]  ; q[1] = v[(k + 1) % 3]; q[2] = v[(k + 2) % 3];
+		}
+	}
+}
+
+
+
+//TMesh members declared in tmesh.h
+
+inline void TMesh::subdivide(TSubdivMode mode = SUBDIV_LOOP)
+{
+	if( m_pSize == 0 ) return;
+	TPROF_SCOPE("TMesh::subdivide");
+
+	TMeshEdges E;
+	E.Build( m_vSize, m_pSize, (const int*)m_pPolys );
+
+	const int    vSize = m_vSize, pSize = m_pSize;
+	EVec3f      *Vs = m_vVerts, *Ts = m_vTexCd;
+	TPoly       *Ps = m_pPolys;
+	vector<int> *Rv = m_vRingVs;
+	m_vVerts = m_vTexCd = 0; m_pPolys = 0; m_vRingVs = 0;
+
+	allocate( vSize + E.m_eSize, 4 * pSize );
+	t_subdivideUniform( mode, vSize, Vs, Ts, Rv, pSize, (const int*)Ps, E, m_vVerts, m_vTexCd, (int*)m_pPolys );
+	delete[] Vs; delete[] Ts; delete[] Ps; delete[] Rv;
+
+	updateRingInfo();
+	updateNormal();
+}
+
+inline void TMesh::subdivideFaces(const vector<int> &faces)
+{
+	if( m_pSize == 0 || faces.empty() ) return;
+	TPROF_SCOPE("TMesh::subdivideFaces");
+
+	TMeshEdges E;
+	E.Build( m_vSize, m_pSize, (const int*)m_pPolys );
+
+	vector<char> flg;
+	vector<int>  eNew, pChild;
+	int newVSize, newPSize;
+	t_subdivideAdaptiveMark( m_vSize, m_pSize, E, faces, flg, eNew, pChild, newVSize, newPSize );
+
+	const int pSize = m_pSize;
+	resize( newVSize, newPSize );
+	t_subdivideAdaptive( pSize, E, flg, eNew, pChild, m_vVerts, m_vTexCd, (int*)m_pPolys );
+
+	//(vertex, face) of the refined faces and their children
+	vector<char> changed(m_pSize, 0);
+	vector<pair<int,int>> vf;
+	for( int f=0; f < pSize; ++f)
+	{
+		if( flg[f] == 0 ) continue;
+		const int cN = (flg[f] == 2) ? 3 : 1;
+		for( int c = -1; c < cN; ++c)
+		{
+			const int g = (c < 0) ? f : pChild[f] + c;
+			changed[g] = 1;
+			for( int k=0; k < 3; ++k) vf.push_back( make_pair(m_pPolys[g].idx[k], g) );
+		}
+	}
+	sort( vf.begin(), vf.end() );
+
+	vector<int> vStart; //start of each vertex in vf
+	for( int i=0; i < (int)vf.size(); ++i) if( i == 0 || vf[i].first != vf[i-1].first ) vStart.push_back(i);
+	vStart.push_back( (int)vf.size() );
+	const int affN = (int)vStart.size() - 1;
+
+#pragma omp parallel for
+	for( int a=0; a < affN; ++a)
+	{
+		const int v = vf[vStart[a]].first;
+		vector<int> &rPs = m_vRingPs[v], &rVs = m_vRingVs[v];
+		rPs.erase( remove_if( rPs.begin(), rPs.end(), [&](int f){ return changed[f] != 0; }), rPs.end() );
+		for( int i = vStart[a]; i < vStart[a+1]; ++i) rPs.push_back( vf[i].second );
+		sort( rPs.begin(), rPs.end() );
+
+		rVs.clear();
+		for( const auto &f : rPs ) for( int k=0; k < 3; ++k) if( m_pPolys[f].idx[k] != v ) rVs.push_back( m_pPolys[f].idx[k] );
+		sort  (rVs.begin(), rVs.end());
+		rVs.erase( unique(rVs.begin(), rVs.end()), rVs.end());
+	}
+
+#pragma omp parallel for
+	for( int f=0; f < m_pSize; ++f) if( changed[f] )
+	{
+		const int *idx = m_pPolys[f].idx;
+		m_pNorms[f] = ( m_vVerts[ idx[1] ]- m_vVerts[ idx[0] ]).cross( m_vVerts[idx[2]] - m_vVerts[idx[0]] ).normalized();
+	}
+
+#pragma omp parallel for
+	for( int a=0; a < affN; ++a)
+	{
+		const int v = vf[vStart[a]].first;
+		EVec3f n(0,0,0);
+		for( const auto &p : m_vRingPs[v] ) n += m_pNorms[p];
+		m_vNorms[v] = n.normalized();
+	}
+
+	m_smoother.clear();
+	m_fairing .reset();
+	m_hEdges  .clear();
+}
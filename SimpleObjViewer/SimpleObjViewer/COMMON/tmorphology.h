@@ -0,0 +1,507 @@
+#pragma once
+
+#include "tvolume.h"
+#include "tdistancetransform.h"
+
+#include <vector>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * 3D binary morphology with arbitrary radius
+ *
+ * TBitVolume : bit-packed binary mask (64 voxels along x per word)
+ *
+ * t_bitMorpho_dilate / erode / open / close
+ *   - SE_BOX  : (2r+1)^3 cube, separable van Herk / Gil-Werman max/min filter
+ *               O(N) for any radius. y/z passes process 64 x-lines at once on words
+ *   - SE_BALL : Euclidean ball, thresholding squared distance transform
+ *               (t_edt_sqDist3D in tdistancetransform.h, O(N) for any radius)
+ *
+ * voxels outside the volume are treated as background
+ * (same as t_morpho3D_erode in which the volume border is eroded)
+ * all passes are parallelized per line by OpenMP
+-------------------------------------------------------------------*/
+
+enum TMorphoSE
+{
+	SE_BOX  = 0,
+	SE_BALL = 1
+};
+
+
+
+class TBitVolume
+{
+	int m_W, m_H, m_D;
+	int m_WW; //number of 64bit words per row
+	vector<unsigned long long> m_bits;
+
+public:
+	TBitVolume()
+	{
+		m_W = m_H = m_D = m_WW = 0;
+	}
+
+	TBitVolume(const int W, const int H, const int D)
+	{
+		Allocate(W, H, D);
+	}
+
+	void Allocate(const int W, const int H, const int D)
+	{
+		m_W  = W;
+		m_H  = H;
+		m_D  = D;
+		m_WW = (W + 63) / 64;
+		m_bits.assign( (size_t)m_WW * H * D, 0 );
+	}
+
+	int getW () const { return m_W ; }
+	int getH () const { return m_H ; }
+	int getD () const { return m_D ; }
+	int getWW() const { return m_WW; }
+
+	inline unsigned long long*       row(const int y, const int z)       { return &m_bits[ ((size_t)z * m_H + y) * m_WW ]; }
+	inline const unsigned long long* row(const int y, const int z) const { return &m_bits[ ((size_t)z * m_H + y) * m_WW ]; }
+
+	inline bool get(const int x, const int y, const int z) const
+	{
+		return ( row(y, z)[x >> 6] >> (x & 63) ) & 1;
+	}
+
+	inline void set(const int x, const int y, const int z, const bool b)
+	{
+		unsigned long long &w = row(y, z)[x >> 6];
+		if (b) w |=  (1ULL << (x & 63));
+		else   w &= ~(1ULL << (x & 63));
+	}
+
+	// bit = pred( vol[i] )
+	template<class T, class PRED>
+	void Set(const T *vol, const PRED &pred)
+	{
+		const int W = m_W, H = m_H;
+#pragma omp parallel for
+		for (int z = 0; z < m_D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			const T *src = &vol[ (size_t)z * W * H + (size_t)y * W ];
+			unsigned long long *r = row(y, z);
+			for (int wx = 0; wx < m_WW; ++wx)
+			{
+				unsigned long long w = 0;
+				const int xe = min( 64, W - wx * 64 );
+				for (int b = 0; b < xe; ++b) if (pred(src[wx * 64 + b])) w |= (1ULL << b);
+				r[wx] = w;
+			}
+		}
+	}
+
+	// bit = pred( vol.at(x,y,z) )
+	template<class T, class PRED>
+	void Set(const TVolume<T> &vol, const PRED &pred)
+	{
+		const int W = m_W, H = m_H;
+#pragma omp parallel for
+		for (int z = 0; z < m_D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			const T *src = vol.ptr(y, z);
+			unsigned long long *r = row(y, z);
+			for (int wx = 0; wx < m_WW; ++wx)
+			{
+				unsigned long long w = 0;
+				const int xe = min( 64, W - wx * 64 );
+				for (int b = 0; b < xe; ++b) if (pred(src[wx * 64 + b])) w |= (1ULL << b);
+				r[wx] = w;
+			}
+		}
+	}
+
+	void Invert()
+	{
+		const unsigned long long lastMask = (m_W % 64 == 0) ? ~0ULL : ((1ULL << (m_W % 64)) - 1);
+		const int rowN = m_H * m_D;
+#pragma omp parallel for
+		for (int i = 0; i < rowN; ++i)
+		{
+			unsigned long long *r = &m_bits[ (size_t)i * m_WW ];
+			for (int wx = 0; wx < m_WW; ++wx) r[wx] = ~r[wx];
+			r[m_WW - 1] &= lastMask;
+		}
+	}
+};
+
+
+
+// van Herk / Gil-Werman running max(OR)/min(AND) of window [i-r, i+r]
+// line is overwritten by the result, out of range elements are "pad"
+// buf should have 3 * ((n + 2r) / (2r+1) + 1) * (2r+1) elements
+template<class T, class OP>
+inline void t_vanHerkGilWerman1D(const int n, const int r, const T pad, const OP &op, T *line, T *buf)
+{
+	if (r <= 0 || n <= 0) return;
+
+	const int k  = 2 * r + 1;
+	const int Lp = ( (n + 2 * r + k - 1) / k ) * k;
+	T *f = buf, *g = buf + Lp, *h = buf + 2 * Lp;
+
+	for (int i = 0    ; i < r     ; ++i) f[i] = pad;
+	for (int i = 0    ; i < n     ; ++i) f[r + i] = line[i];
+	for (int i = r + n; i < Lp    ; ++i) f[i] = pad;
+
+	for (int i = 0; i < Lp; ++i) g[i] = (i % k == 0) ? f[i] : op( g[i - 1], f[i] );
+	for (int i = Lp - 1; i >= 0; --i) h[i] = (i % k == k - 1) ? f[i] : op( h[i + 1], f[i] );
+
+	for (int i = 0; i < n; ++i) line[i] = op( h[i], g[i + 2 * r] );
+}
+
+
+
+struct TMorphoOpOr
+{
+	template<class T> inline T operator()(const T &a, const T &b) const { return a | b; }
+};
+
+struct TMorphoOpAnd
+{
+	template<class T> inline T operator()(const T &a, const T &b) const { return a & b; }
+};
+
+
+
+// box filter (OR : dilation, AND : erosion) with radius r along x, y, and z
+template<class OP>
+inline void t_bitMorpho_box(TBitVolume &m, const int r, const OP &op)
+{
+	typedef unsigned long long U64;
+	const int W = m.getW(), H = m.getH(), D = m.getD(), WW = m.getWW();
+	if (r <= 0 || W == 0 || H == 0 || D == 0) return;
+
+	const int k = 2 * r + 1;
+	auto bufSize = [&](int n) { return (size_t)3 * ( (n + 2 * r) / k + 1 ) * k; };
+
+	//x : unpack each row to bytes
+#pragma omp parallel
+	{
+		vector<unsigned char> line(W), buf( bufSize(W) );
+#pragma omp for
+		for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			U64 *row = m.row(y, z);
+			for (int x = 0; x < W; ++x) line[x] = (row[x >> 6] >> (x & 63)) & 1;
+
+			t_vanHerkGilWerman1D<unsigned char>( W, r, 0, op, line.data(), buf.data() );
+
+			for (int wx = 0; wx < WW; ++wx) row[wx] = 0;
+			for (int x = 0; x < W; ++x) if (line[x]) row[x >> 6] |= (1ULL << (x & 63));
+		}
+	}
+
+	//y : 64 lines at once
+#pragma omp parallel
+	{
+		vector<U64> line(H), buf( bufSize(H) );
+#pragma omp for
+		for (int z = 0; z < D; ++z)
+		for (int wx = 0; wx < WW; ++wx)
+		{
+			for (int y = 0; y < H; ++y) line[y] = m.row(y, z)[wx];
+			t_vanHerkGilWerman1D<U64>( H, r, 0, op, line.data(), buf.data() );
+			for (int y = 0; y < H; ++y) m.row(y, z)[wx] = line[y];
+		}
+	}
+
+	//z : 64 lines at once
+#pragma omp parallel
+	{
+		vector<U64> line(D), buf( bufSize(D) );
+#pragma omp for
+		for (int y = 0; y < H; ++y)
+		for (int wx = 0; wx < WW; ++wx)
+		{
+			for (int z = 0; z < D; ++z) line[z] = m.row(y, z)[wx];
+			t_vanHerkGilWerman1D<U64>( D, r, 0, op, line.data(), buf.data() );
+			for (int z = 0; z < D; ++z) m.row(y, z)[wx] = line[z];
+		}
+	}
+}
+
+
+
+// ball filter : dilation keeps voxels within r from foreground,
+//               erosion keeps voxels farther than r from background (and from the outside)
+inline void t_bitMorpho_ball(TBitVolume &m, const int r, const bool bDilate)
+{
+	const int W = m.getW(), H = m.getH(), D = m.getD();
+	if (r <= 0 || W == 0 || H == 0 || D == 0) return;
+
+	//sites : foreground for dilation, background + 1 voxel border for erosion
+	const int eW = W + 2, eH = H + 2, eD = D + 2;
+	const size_t eWH = (size_t)eW * eH;
+	vector<float> dist( eWH * eD );
+
+#pragma omp parallel for
+	for (int z = 0; z < eD; ++z)
+	for (int y = 0; y < eH; ++y)
+	{
+		float *d = &dist[ z * eWH + (size_t)y * eW ];
+		for (int x = 0; x < eW; ++x)
+		{
+			bool bIn = 0 < x && x <= W && 0 < y && y <= H && 0 < z && z <= D && m.get(x - 1, y - 1, z - 1);
+			d[x] = ( bDilate ? bIn : !bIn ) ? 0 : FLT_MAX;
+		}
+	}
+
+	t_edt_sqDist3D( eW, eH, eD, EVec3f(1, 1, 1), dist.data() );
+
+	//threshold
+	const float r2 = (float)r * r;
+#pragma omp parallel for
+	for (int z = 1; z <= D; ++z)
+	for (int y = 1; y <= H; ++y)
+	{
+		const float *d = &dist[ z * eWH + (size_t)y * eW ];
+		for (int x = 1; x <= W; ++x) m.set( x - 1, y - 1, z - 1, bDilate ? (d[x] <= r2) : (d[x] > r2) );
+	}
+}
+
+
+
+inline void t_bitMorpho_dilate(TBitVolume &m, const int r, const TMorphoSE se = SE_BOX)
+{
+	if (se == SE_BOX) t_bitMorpho_box (m, r, TMorphoOpOr());
+	else              t_bitMorpho_ball(m, r, true);
+}
+
+inline void t_bitMorpho_erode(TBitVolume &m, const int r, const TMorphoSE se = SE_BOX)
+{
+	if (se == SE_BOX) t_bitMorpho_box (m, r, TMorphoOpAnd());
+	else              t_bitMorpho_ball(m, r, false);
+}
+
+inline void t_bitMorpho_open(TBitVolume &m, const int r, const TMorphoSE se = SE_BOX)
+{
+	t_bitMorpho_erode (m, r, se);
+	t_bitMorpho_dilate(m, r, se);
+}
+
+inline void t_bitMorpho_close(TBitVolume &m, const int r, const TMorphoSE se = SE_BOX)
+{
+	t_bitMorpho_dilate(m, r, se);
+	t_bitMorpho_erode (m, r, se);
+}
+
+
+
+
+/* -----------------------------------------------------------------
+ * morphology on label volumes
+ * voxel value 0:never change, 1:background, 255:foreground
+ * (FillHole : 0:background, 255:foreground)
+-------------------------------------------------------------------*/
+
+//erosion with 6-neighborhood, the volume border is eroded
+template<class T>
+void t_morpho3D_erode(TVolume<T> &v)
+{
+	const int W = v.getW();
+	const int H = v.getH();
+	const int D = v.getD();
+	const ptrdiff_t sy = v.strideY(), sz = v.strideZ();
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x)
+			{
+				if (p[x] != 255) continue;
+
+				if (x == 0 || y == 0 || z == 0 || x == W - 1 || y == H - 1 || z == D - 1 ||
+					p[x - 1] == 1 || p[x - sy] == 1 || p[x - sz] == 1 ||
+					p[x + 1] == 1 || p[x + sy] == 1 || p[x + sz] == 1) p[x] = 2;
+			}
+		}
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x) if (p[x] == 2) p[x] = 1;
+		}
+}
+
+
+
+//dilation with 6-neighborhood
+template<class T>
+void t_morpho3D_dilate(TVolume<T> &v)
+{
+	const int W = v.getW();
+	const int H = v.getH();
+	const int D = v.getD();
+	const ptrdiff_t sy = v.strideY(), sz = v.strideZ();
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x)
+			{
+				if (p[x] != 1) continue;
+
+				if ( (x > 0  && p[x - 1] == 255) || (y > 0  && p[x - sy] == 255) || (z > 0  && p[x - sz] == 255) || 
+					 (x <W-1 && p[x + 1] == 255) || (y <H-1 && p[x + sy] == 255) || (z <D-1 && p[x + sz] == 255) ) p[x] = 2;
+			}
+		}
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x) if (p[x] == 2) p[x] = 255;
+		}
+}
+
+
+
+//erosion with radius r (box or ball structuring element, O(N) for any r)
+//voxels with value 0 are neither eroded nor treated as background
+template<class T>
+void t_morpho3D_erode(TVolume<T> &v, const int r, const TMorphoSE se)
+{
+	const int W = v.getW();
+	const int H = v.getH();
+	const int D = v.getD();
+
+	TBitVolume m( W, H, D );
+	m.Set( v, [](const T a){ return a != 1; } );
+	t_bitMorpho_erode( m, r, se );
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x) if (p[x] == 255 && !m.get(x, y, z)) p[x] = 1;
+		}
+}
+
+
+
+//dilation with radius r (box or ball structuring element, O(N) for any r)
+template<class T>
+void t_morpho3D_dilate(TVolume<T> &v, const int r, const TMorphoSE se)
+{
+	const int W = v.getW();
+	const int H = v.getH();
+	const int D = v.getD();
+
+	TBitVolume m( W, H, D );
+	m.Set( v, [](const T a){ return a == 255; } );
+	t_bitMorpho_dilate( m, r, se );
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x) if (p[x] == 1 && m.get(x, y, z)) p[x] = 255;
+		}
+}
+
+
+
+template<class T>
+void t_morpho3D_open(TVolume<T> &v, const int r, const TMorphoSE se)
+{
+	t_morpho3D_erode ( v, r, se );
+	t_morpho3D_dilate( v, r, se );
+}
+
+template<class T>
+void t_morpho3D_close(TVolume<T> &v, const int r, const TMorphoSE se)
+{
+	t_morpho3D_dilate( v, r, se );
+	t_morpho3D_erode ( v, r, se );
+}
+
+
+
+//voxel value 0: background, 255:foreground
+//background voxels not connected (6-neighborhood) to the volume border become foreground
+//scanline flood fill : visited flags are kept in a bit mask and the stack holds spans (xl,xr,y,z)
+template<class T>
+void t_morpho3D_FillHole(TVolume<T> &v)
+{
+	const int W = v.getW();
+	const int H = v.getH();
+	const int D = v.getD();
+
+	TBitVolume visited( W, H, D );
+	vector<EVec4i> spans;
+
+	//fill the maximal background run containing (x,y,z) and push it as a span
+	auto fillRun = [&]( int x, const int y, const int z )
+	{
+		const T *p = v.ptr(y, z);
+		if( p[x] != 0 || visited.get( x, y, z ) ) return x;
+
+		int xl = x, xr = x;
+		while( xl > 0     && p[xl - 1] == 0 ) --xl;
+		while( xr < W - 1 && p[xr + 1] == 0 ) ++xr;
+		for( int i = xl; i <= xr; ++i ) visited.set( i, y, z, true );
+		spans.push_back( EVec4i( xl, xr, y, z ) );
+		return xr;
+	};
+
+	//seeds : all background voxels on the volume border
+	for (int z = 0; z < D; ++z)
+	for (int y = 0; y < H; ++y)
+	{
+		if ( y == 0 || y == H - 1 || z == 0 || z == D - 1 )
+		{
+			for (int x = 0; x < W; ++x) x = fillRun( x, y, z );
+		}
+		else
+		{
+			fillRun( 0    , y, z );
+			fillRun( W - 1, y, z );
+		}
+	}
+
+	//region growing for background
+	while (!spans.empty())
+	{
+		const EVec4i s = spans.back();
+		spans.pop_back();
+		const int xl = s[0], xr = s[1], y = s[2], z = s[3];
+
+		const int nei[4][2] = { {y - 1, z}, {y + 1, z}, {y, z - 1}, {y, z + 1} };
+		for (int k = 0; k < 4; ++k)
+		{
+			const int ny = nei[k][0], nz = nei[k][1];
+			if (ny < 0 || ny >= H || nz < 0 || nz >= D) continue;
+			for (int x = xl; x <= xr; ++x) x = fillRun( x, ny, nz );
+		}
+	}
+
+#pragma omp parallel for 
+	for (int z = 0; z < D; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			T *p = v.ptr(y, z);
+			for (int x = 0; x < W; ++x) p[x] = visited.get(x, y, z) ? 0 : 255;
+		}
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+
+
+
+/* -----------------------------------------------------------------
+ * compile time switchable instrumentation of the hot paths
+ *
+ * enabled when TPROFILE is defined (CMake : -DSOV_PROFILE=ON), otherwise
+ * every macro expands to nothing and its arguments are not evaluated
+ * (TPROF_COUNT keeps its argument in an unevaluated sizeof so that local counters
+ * stay "used" and are removed by the optimizer).
+ *
+ *   TPROF_SCOPE("name")  : RAII timer of the enclosing scope, accumulated per name
+ *                          (calls, total and max time, thread safe)
+ *   TPROF_COUNT(id, n)   : adds n to the counter id (TProfCounter)
+ *   TPROF_LOG(...)       : diagnostic message, fprintf(stderr, ...)
+ *
+ *   TProfiler::get().Report(stderr) prints all timers and counters, Reset() clears them.
+ *
+ * Counters are atomics : inner loops count into locals and add them once per call.
+-------------------------------------------------------------------*/
+
+enum TProfCounter
+{
+	PROF_HEAP_PUSH     = 0, //priority queue insertions (Dijkstra / exp map)
+	PROF_HEAP_DECREASE = 1, //decrease-key (erase + insert)
+	PROF_VERTS_SETTLED = 2, //vertices popped and fixed
+	PROF_CELLS_VISITED = 3, //marching cubes cells
+	PROF_TRIS_EMITTED  = 4, //marching cubes triangles
+	PROF_QUEUE_GROW    = 5, //TQueue reallocations
+	PROF_CHUNK_FAULT   = 6, //TChunkedMesh chunks read from the file
+	PROF_COUNTER_NUM   = 7
+};
+
+
+
+class TProfiler
+{
+	enum { TIMER_MAX = 256 };
+
+	struct Timer
+	{
+		const char            *name ;
+		std::atomic<long long> calls;
+		std::atomic<long long> ns   ;
+		std::atomic<long long> maxNs;
+	};
+
+	std::mutex             m_mutex;
+	int                    m_timerN;
+	Timer                  m_timers  [TIMER_MAX];
+	std::atomic<long long> m_counters[PROF_COUNTER_NUM];
+
+	TProfiler()
+	{
+		m_timerN = 0;
+		Reset();
+	}
+
+public:
+	static TProfiler &get()
+	{
+		static TProfiler p;
+		return p;
+	}
+
+	static const char *counterName(const int c)
+	{
+		static const char *names[PROF_COUNTER_NUM] = { "heap push", "heap decrease-key", "vertices settled", "cells visited", "triangles emitted", "queue grow", "chunk faults" };
+		return names[c];
+	}
+
+	// timer id of name (registered once per call site)
+	int Register(const char *name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int i = 0; i < m_timerN; ++i) if (strcmp(m_timers[i].name, name) == 0) return i;
+		if (m_timerN == TIMER_MAX) return TIMER_MAX - 1;
+		m_timers[m_timerN].name = name;
+		return m_timerN++;
+	}
+
+	void AddTime(const int id, const long long ns)
+	{
+		Timer &t = m_timers[id];
+		t.calls += 1;
+		t.ns    += ns;
+		long long m = t.maxNs;
+		while (ns > m && !t.maxNs.compare_exchange_weak(m, ns)) {}
+	}
+
+	void Add(const TProfCounter c, const long long n) { m_counters[c] += n; }
+
+	long long getCounter(const TProfCounter c) const { return m_counters[c]; }
+
+	// total time of the timer "name" [ms] (0 if never called)
+	double getTotalMs(const char *name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int i = 0; i < m_timerN; ++i) if (strcmp(m_timers[i].name, name) == 0) return m_timers[i].ns * 1e-6;
+		return 0;
+	}
+
+	void Reset()
+	{
+		for (int i = 0; i < TIMER_MAX; ++i) { m_timers[i].calls = 0; m_timers[i].ns = 0; m_timers[i].maxNs = 0; }
+		for (int i = 0; i < PROF_COUNTER_NUM; ++i) m_counters[i] = 0;
+	}
+
+	void Report(FILE *fp = stderr)
+	{
+#ifndef TPROFILE
+		fprintf(fp, "profiling disabled (build with TPROFILE)\n");
+#else
+		std::lock_guard<std::mutex> lock(m_mutex);
+		fprintf(fp, "%-32s %10s %12s %12s %12s\n", "scope", "calls", "total[ms]", "mean[ms]", "max[ms]");
+		for (int i = 0; i < m_timerN; ++i)
+		{
+			const Timer &t = m_timers[i];
+			if (t.calls == 0) continue;
+			fprintf(fp, "%-32s %10lld %12.3f %12.3f %12.3f\n", t.name, (long long)t.calls, t.ns * 1e-6, t.ns * 1e-6 / t.calls, t.maxNs * 1e-6);
+		}
+		for (int c = 0; c < PROF_COUNTER_NUM; ++c)
+			if (m_counters[c] != 0) fprintf(fp, "%-32s %10lld\n", counterName(c), (long long)m_counters[c]);
+#endif
+	}
+};
+
+
+
+class TProfScope
+{
+	const int m_id;
+	const std::chrono::steady_clock::time_point m_t0;
+
+public:
+	explicit TProfScope(const int id) : m_id(id), m_t0(std::chrono::steady_clock::now()) {}
+	~TProfScope()
+	{
+		TProfiler::get().AddTime(m_id, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_t0).count());
+	}
+};
+
+
+
+#ifdef TPROFILE
+#define TPROF_CAT_(a, b) a##b
+#define TPROF_CAT(a, b)  TPROF_CAT_(a, b)
+#define TPROF_SCOPE(name) \
+	static const int TPROF_CAT(tprofId_, __LINE__) = TProfiler::get().Register(name); \
+	TProfScope TPROF_CAT(tprofScope_, __LINE__)(TPROF_CAT(tprofId_, __LINE__))
+#define TPROF_COUNT(id, n) TProfiler::get().Add((id), (n))
+#define TPROF_LOG(...)     fprintf(stderr, __VA_ARGS__)
+#else
+#define TPROF_SCOPE(name)
+#define TPROF_COUNT(id, n) ((void)sizeof(n))
+#define TPROF_LOG(...)
+#endif
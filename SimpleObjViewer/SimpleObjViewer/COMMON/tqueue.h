@@ -43,6 +43,8 @@
  * 2015/9/7 に再メンテナンス
 -------------------------------------------------------------------*/
 
+#include "tprofile.h"
+
 
 
 #define T_QUEUE_INIT_SIZE 40
@@ -63,14 +65,12 @@ public:
 	//increase_size : 要素数が用意したメモリの上限に達したときに再確保するメモリサイズ (要素数)
 	TQueue( const int init_size = T_QUEUE_INIT_SIZE, const int increase_size = T_QUEUE_ADD_SIZE ) : m_INCREASE_SIZE( max(20,increase_size) )
 	{
-        printf( "TQueue standard constractor\n" );
 		m_size = max( 10, init_size);
 		m_data = new T[ m_size ];
 		m_tail = m_head = 0;
 	}
 
 	TQueue( const TQueue &src) : m_INCREASE_SIZE( src.m_INCREASE_SIZE ) {
-        printf( "TQueue copy constractor\n" );
 		m_size = src.m_size;
 		m_tail = src.m_tail;
 		m_head = src.m_head;
@@ -82,7 +82,6 @@ public:
 	}
 
 	TQueue& operator=(const TQueue& src){
-        printf( "TQeue operator = \n" );
 		delete[] m_data;
 		m_size = src.m_size;
 		m_tail = src.m_tail;
@@ -137,7 +136,7 @@ public:
 private: 
 	inline void increase_size()
 	{
-        printf( "*");
+		TPROF_COUNT(PROF_QUEUE_GROW, 1);
 		T* newData = new T[ m_size + m_INCREASE_SIZE ];
 
 		//head -- m_size-1 をコピー (memcpyは浅いコピーだから使っちゃダメ)
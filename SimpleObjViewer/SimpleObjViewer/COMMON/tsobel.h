@@ -0,0 +1,193 @@
+#pragma once
+
+#include "tvolume.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * 3D sobel filter
+ *
+ * the 27-tap kernel is separable : gx = Dx*Sy*Sz, gy = Sx*Dy*Sz, gz = Sx*Sy*Dz
+ * (S = [1 2 1] smoothing, D = [-1 0 1] derivative).
+ * The volume is processed in tiles of (rows x 1 plane), parallelized over tiles.
+ * For each tile, the z-pass writes A = Sz(vol), B = Dz(vol) into zero padded float rows
+ * (x = -1 and x = W are zero), so the y- and x-passes run without bounds checks.
+ *
+ * TVolume inputs may have ghost layers / padded rows (the ghost voxels are not read).
+ * voxels outside the volume are treated as 0,
+ * and the derivative along an axis is 0 on the two boundary planes of that axis.
+ * res = |g| / 16 , grad = g / 16
+-------------------------------------------------------------------*/
+
+//s = a0 + 2 a1 + a2, d = a2 - a0  (s or d may be null)
+inline void t_sobel3D_smoothDiff(
+	const int n, 
+	const float *a0, const float *a1, const float *a2, 
+	float *s, float *d)
+{
+	int i = 0;
+#ifdef __AVX__
+	const __m256 two = _mm256_set1_ps(2.0f);
+	if (s && d)
+	{
+		for (; i + 8 <= n; i += 8)
+		{
+			const __m256 v0 = _mm256_loadu_ps(a0 + i), v2 = _mm256_loadu_ps(a2 + i);
+			_mm256_storeu_ps(s + i, _mm256_add_ps(_mm256_add_ps(v0, v2), _mm256_mul_ps(two, _mm256_loadu_ps(a1 + i))));
+			_mm256_storeu_ps(d + i, _mm256_sub_ps(v2, v0));
+		}
+	}
+	else if (s)
+	{
+		for (; i + 8 <= n; i += 8)
+		{
+			const __m256 v0 = _mm256_loadu_ps(a0 + i), v2 = _mm256_loadu_ps(a2 + i);
+			_mm256_storeu_ps(s + i, _mm256_add_ps(_mm256_add_ps(v0, v2), _mm256_mul_ps(two, _mm256_loadu_ps(a1 + i))));
+		}
+	}
+	else if (d)
+	{
+		for (; i + 8 <= n; i += 8) _mm256_storeu_ps(d + i, _mm256_sub_ps(_mm256_loadu_ps(a2 + i), _mm256_loadu_ps(a0 + i)));
+	}
+#endif
+	if (s) for (int k = i; k < n; ++k) s[k] = a0[k] + 2 * a1[k] + a2[k];
+	if (d) for (int k = i; k < n; ++k) d[k] = a2[k] - a0[k];
+}
+
+
+
+//res (magnitude) and/or grad (gradient vector) may be null, they should have the same resolution as vol
+template<class T>
+void t_sobel3D_separable(const TVolume<T> &vol, TVolume<T> *res, TVolume<EVec3f> *grad)
+{
+	const int W = vol.getW(), H = vol.getH(), D = vol.getD();
+	const int Wp = W + 2; //padded row length
+
+	//rows per tile : A/B buffers of a tile stay in L2 (about 128KB)
+	const int TY     = max(1, min(H, 16384 / Wp - 2));
+	const int tileY  = (H + TY - 1) / TY;
+	const int tileN  = tileY * D;
+
+#pragma omp parallel
+	{
+		float *A   = new float[(TY + 2) * Wp];
+		float *B   = new float[(TY + 2) * Wp];
+		float *row = new float[3 * W + 8 * Wp];
+		float *r0  = row, *r1 = row + W, *r2 = row + 2 * W;
+		float *SyA = row + 3 * W, *DyA = SyA + Wp, *SyB = DyA + Wp, *zero = SyB + Wp;
+		float *gx  = zero + Wp, *gy = gx + Wp, *gz = gy + Wp;
+		memset(row, 0, sizeof(float) * (3 * W + 8 * Wp));
+
+#pragma omp for schedule(static)
+		for (int tile = 0; tile < tileN; ++tile)
+		{
+			const int z  = tile / tileY;
+			const int y0 = (tile % tileY) * TY, y1 = min(H, y0 + TY);
+
+			//z-pass for rows y0-1 ... y1
+			for (int y = y0 - 1; y <= y1; ++y)
+			{
+				float *a = A + (y - y0 + 1) * Wp, *b = B + (y - y0 + 1) * Wp;
+				a[0] = a[W + 1] = b[0] = b[W + 1] = 0;
+				if (y < 0 || H <= y)
+				{
+					memset(a, 0, sizeof(float) * Wp);
+					memset(b, 0, sizeof(float) * Wp);
+					continue;
+				}
+				const float *p0 = zero + 1, *p2 = zero + 1;
+				if (z > 0    ) { const T *v = vol.ptr(y, z - 1); for (int x = 0; x < W; ++x) r0[x] = (float)v[x]; p0 = r0; }
+				if (z < D - 1) { const T *v = vol.ptr(y, z + 1); for (int x = 0; x < W; ++x) r2[x] = (float)v[x]; p2 = r2; }
+				const T *v = vol.ptr(y, z);
+				for (int x = 0; x < W; ++x) r1[x] = (float)v[x];
+				t_sobel3D_smoothDiff(W, p0, r1, p2, a + 1, b + 1);
+			}
+
+			for (int y = y0; y < y1; ++y)
+			{
+				//y-pass
+				const int k = y - y0 + 1;
+				t_sobel3D_smoothDiff(W, A + (k - 1) * Wp + 1, A + k * Wp + 1, A + (k + 1) * Wp + 1, SyA + 1, DyA + 1);
+				t_sobel3D_smoothDiff(W, B + (k - 1) * Wp + 1, B + k * Wp + 1, B + (k + 1) * Wp + 1, SyB + 1, 0);
+
+				//x-pass (SyA[0], SyA[W+1], ... stay 0)
+				t_sobel3D_smoothDiff(W, SyA, SyA + 1, SyA + 2, 0 , gx);
+				t_sobel3D_smoothDiff(W, DyA, DyA + 1, DyA + 2, gy, 0 );
+				t_sobel3D_smoothDiff(W, SyB, SyB + 1, SyB + 2, gz, 0 );
+
+				//for boundary voxels
+				gx[0] = gx[W - 1] = 0;
+				if (y == 0 || y == H - 1) memset(gy, 0, sizeof(float) * W);
+				if (z == 0 || z == D - 1) memset(gz, 0, sizeof(float) * W);
+
+				if (res)
+				{
+					T *o = res->ptr(y, z);
+					for (int x = 0; x < W; ++x) o[x] = (T)( (T)sqrt((double)gx[x] * gx[x] + gy[x] * gy[x] + gz[x] * gz[x]) / 16.0f );
+				}
+				if (grad)
+				{
+					EVec3f *o = grad->ptr(y, z);
+					for (int x = 0; x < W; ++x) o[x] << gx[x] / 16.0f, gy[x] / 16.0f, gz[x] / 16.0f;
+				}
+			}
+		}
+
+		delete[] A;
+		delete[] B;
+		delete[] row;
+	}
+}
+
+
+
+//res : gradient magnitude
+template<class T>
+void t_sobel3D(const TVolume<T> &vol, TVolume<T> &res)
+{
+	if (res.getRes() != vol.getRes()) res.Allocate(vol.getRes());
+	t_sobel3D_separable<T>(vol, &res, 0);
+}
+
+
+
+//grad : gradient vector (e.g. normals for marching cubes)
+template<class T>
+void t_sobel3D_grad(const TVolume<T> &vol, TVolume<EVec3f> &grad)
+{
+	if (grad.getRes() != vol.getRes()) grad.Allocate(vol.getRes());
+	t_sobel3D_separable<T>(vol, 0, &grad);
+}
+
+
+
+//contiguous W x H x D arrays
+template<class T>
+void t_sobel3D(const int W, const int H, const int D, const T* vol, T* res)
+{
+	TVolume<T> v, r;
+	v.Wrap(W, H, D, (T*)vol);
+	r.Wrap(W, H, D, res);
+	t_sobel3D_separable<T>(v, &r, 0);
+}
+
+template<class T>
+void t_sobel3D_grad(const int W, const int H, const int D, const T* vol, EVec3f* grad)
+{
+	TVolume<T     > v;
+	TVolume<EVec3f> g;
+	v.Wrap(W, H, D, (T*)vol);
+	g.Wrap(W, H, D, grad);
+	t_sobel3D_separable<T>(v, 0, &g);
+}
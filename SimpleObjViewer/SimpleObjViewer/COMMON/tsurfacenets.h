@@ -0,0 +1,241 @@
+#pragma once
+
+#include "tmarchingcubes.h"
+
+#include <vector>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * Surface Nets iso-surface extraction
+ *
+ * Same inputs and the same sampling cell grid as t_MarchingCubes
+ * (cell (cx,cy,cz) samples voxels cx-1..cx, out-of-volume samples are -inf,
+ *  so the surface is closed at the volume boundary).
+ *
+ * One vertex is placed in each cell crossing the iso-surface
+ * (centroid of the edge crossings of the cell) and one quad is generated
+ * for each crossing grid edge by connecting the 4 cells sharing the edge.
+ *
+ * t_SurfaceNetsQuad returns the quad mesh (half the faces of t_MarchingCubes),
+ * t_SurfaceNets splits each quad along its shorter diagonal.
+ * With cellSize = 1 the triangulated mesh has the vertex and triangle counts of
+ * t_MarchingCubes (one vertex per crossing cell ~ one per crossing edge).
+ *
+ * cellSize = s > 1 : cells of s^3 voxels (corners on every s-th voxel of the same grid).
+ * The vertex of a cell is the centroid of the crossings of all voxel edges inside it,
+ * so it stays on the full resolution surface, while vertices and faces drop by about s^2
+ * (s = 2 : 1/4 of t_MarchingCubes). Features thinner than s voxels between
+ * two cell corners are lost (as with any coarser sampling).
+-------------------------------------------------------------------*/
+
+template<class T>
+void t_SurfaceNetsQuad(
+	const EVec3i &vRes  ,
+	const EVec3f &vPitch,
+	const T      *vol   ,
+	const T       Thresh,
+	const int    *minIdx,
+	const int    *maxIdx,
+
+	vector<EVec3f> &Vs,
+	vector<EVec4i> &Qs,
+	const int cellSize = 1
+	)
+{
+	//corner offsets (same order as t_MarchingCubes) and 12 cell edges
+	static const int cornerOfs[8][3] = { {0,0,0}, {1,0,0}, {1,0,1}, {0,0,1}, {0,1,0}, {1,1,0}, {1,1,1}, {0,1,1} };
+	static const int cellEdge[12][2] = { {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6}, {7,6}, {4,7}, {0,4}, {1,5}, {2,6}, {3,7} };
+
+	//volume resolution
+	const int W = vRes[0], H = vRes[1], D = vRes[2], WH = W*H;
+
+	//sampling ROI (same as t_MarchingCubes), then in cells of s^3 voxels
+	const int s = max( 1, cellSize );
+	int cellXs = 0, cellXe = W + 1, cellYs = 0, cellYe = H + 1, cellZs = 0, cellZe = D + 1;
+	if (minIdx != 0 && maxIdx != 0)
+	{
+		cellXs = max( 0, minIdx[0] );  cellXe = min( maxIdx[0] + 2, cellXe );
+		cellYs = max( 0, minIdx[1] );  cellYe = min( maxIdx[1] + 2, cellYe );
+		cellZs = max( 0, minIdx[2] );  cellZe = min( maxIdx[2] + 2, cellZe );
+	}
+	if( cellXs >= cellXe || cellYs >= cellYe || cellZs >= cellZe ) return;
+	cellXs /= s;  cellXe = (cellXe + s - 1) / s;
+	cellYs /= s;  cellYe = (cellYe + s - 1) / s;
+	cellZs /= s;  cellZe = (cellZe + s - 1) / s;
+
+	//voxel value, -inf outside the volume
+	auto sample = [&]( const int x, const int y, const int z ) -> double
+	{
+		return ( x < 0 || y < 0 || z < 0 || x >= W || y >= H || z >= D ) ? -DBL_MAX : (double)vol[x + y * W + (size_t)z * WH];
+	};
+
+	//vertex index of the cells in the previous and current z planes
+	const int rW = cellXe - cellXs, rH = cellYe - cellYs, rWH = rW * rH;
+	int *vtxPrev = new int[rWH];
+	int *vtxCurr = new int[rWH];
+	for (int i = 0; i < rWH; ++i) vtxCurr[i] = -1;
+
+	auto addQuad = [&]( const int a, const int b, const int c, const int d, const bool bFlip )
+	{
+		if( bFlip ) Qs.push_back( EVec4i( a, d, c, b ) );
+		else        Qs.push_back( EVec4i( a, b, c, d ) );
+	};
+
+	for( int cz = cellZs; cz < cellZe; ++cz)
+	{
+		swap( vtxPrev, vtxCurr );
+		for (int i = 0; i < rWH; ++i) vtxCurr[i] = -1;
+
+		for( int cy = cellYs; cy < cellYe; ++cy)
+		{
+			for( int cx = cellXs; cx < cellXe; ++cx)
+			{
+				//sampling 8 points on the cell (same as t_MarchingCubes for s = 1)
+				const int x = cx * s - 1, y = cy * s - 1, z = cz * s - 1;
+				double p[8];
+				if( s == 1 )
+				{
+					const int vI = x + y * W + z*WH;
+					p[0] = (x < 0    || y < 0    || z < 0   ) ? -DBL_MAX : vol[vI           ];
+					p[1] = (x == W-1 || y < 0    || z < 0   ) ? -DBL_MAX : vol[vI + 1       ];
+					p[2] = (x == W-1 || y < 0    || z == D-1) ? -DBL_MAX : vol[vI + 1    +WH];
+					p[3] = (x < 0    || y < 0    || z == D-1) ? -DBL_MAX : vol[vI        +WH];
+					p[4] = (x < 0    || y == H-1 || z < 0   ) ? -DBL_MAX : vol[vI     +W    ];
+					p[5] = (x == W-1 || y == H-1 || z < 0   ) ? -DBL_MAX : vol[vI + 1 +W    ];
+					p[6] = (x == W-1 || y == H-1 || z == D-1) ? -DBL_MAX : vol[vI + 1 +W+ WH];
+					p[7] = (x < 0    || y == H-1 || z == D-1) ? -DBL_MAX : vol[vI     +W+ WH];
+				}
+				else
+				{
+					for( int i = 0; i < 8; ++i ) p[i] = sample( x + s * cornerOfs[i][0], y + s * cornerOfs[i][1], z + s * cornerOfs[i][2] );
+				}
+
+				int caseID = 0;
+				for( int i = 0; i < 8; ++i ) if( p[i] > Thresh ) caseID |= (1 << i);
+				if( caseID == 0 || caseID == 255 ) continue;
+
+				//vertex = centroid of edge crossings (s > 1 : of every voxel edge in the cell)
+				EVec3f pos( 0, 0, 0 );
+				int    n = 0;
+				if( s == 1 )
+				{
+					for( int e = 0; e < 12; ++e )
+					{
+						const int i0 = cellEdge[e][0], i1 = cellEdge[e][1];
+						if( (p[i0] > Thresh) == (p[i1] > Thresh) ) continue;
+						const float t = (float)( (Thresh - p[i0]) / (p[i1] - p[i0]) );
+						pos[0] += cornerOfs[i0][0] + t * (cornerOfs[i1][0] - cornerOfs[i0][0]);
+						pos[1] += cornerOfs[i0][1] + t * (cornerOfs[i1][1] - cornerOfs[i0][1]);
+						pos[2] += cornerOfs[i0][2] + t * (cornerOfs[i1][2] - cornerOfs[i0][2]);
+						++n;
+					}
+				}
+				else
+				{
+					for( int k = 0; k <= s; ++k )
+					for( int j = 0; j <= s; ++j )
+					for( int i = 0; i <= s; ++i )
+					{
+						const double v0 = sample( x + i, y + j, z + k );
+						const bool   b0 = v0 > Thresh;
+						for( int a = 0; a < 3; ++a )
+						{
+							const int i1 = i + (a == 0), j1 = j + (a == 1), k1 = k + (a == 2);
+							if( i1 > s || j1 > s || k1 > s ) continue;
+							const double v1 = sample( x + i1, y + j1, z + k1 );
+							if( b0 == (v1 > Thresh) ) continue;
+							const float t = (float)( (Thresh - v0) / (v1 - v0) );
+							pos += EVec3f( i + t * (i1 - i), j + t * (j1 - j), k + t * (k1 - k) );
+							++n;
+						}
+					}
+				}
+				pos /= (float)n;
+
+				//cell corner 0 is voxel (x,y,z) whose center is at (x+0.5)*pitch
+				const int eI = (cx - cellXs) + (cy - cellYs) * rW;
+				vtxCurr[eI] = (int)Vs.size();
+				Vs.push_back( EVec3f( (x + 0.5f + pos[0]) * vPitch[0],
+				                      (y + 0.5f + pos[1]) * vPitch[1],
+				                      (z + 0.5f + pos[2]) * vPitch[2] ) );
+
+				//quads for the 3 edges starting from corner 0
+				//(all 4 cells sharing the edge have index <= this cell, so they are already computed)
+				const bool in0 = p[0] > Thresh;
+				const bool bX = cy > cellYs && cz > cellZs;
+				const bool bY = cx > cellXs && cz > cellZs;
+				const bool bZ = cx > cellXs && cy > cellYs;
+
+				if( bX && in0 != (p[1] > Thresh) )
+					addQuad( vtxPrev[eI - rW], vtxPrev[eI], vtxCurr[eI], vtxCurr[eI - rW], !in0 );
+				if( bY && in0 != (p[4] > Thresh) )
+					addQuad( vtxPrev[eI - 1 ], vtxCurr[eI - 1], vtxCurr[eI], vtxPrev[eI], !in0 );
+				if( bZ && in0 != (p[3] > Thresh) )
+					addQuad( vtxCurr[eI - 1 - rW], vtxCurr[eI - rW], vtxCurr[eI], vtxCurr[eI - 1], !in0 );
+			}
+		}
+	}
+
+	delete[] vtxPrev;
+	delete[] vtxCurr;
+}
+
+
+
+template<class T>
+void t_SurfaceNets(
+	const EVec3i &vRes  ,
+	const EVec3f &vPitch,
+	const T      *vol   ,
+	const T       Thresh,
+	const int    *minIdx,
+	const int    *maxIdx,
+
+	vector<EVec3f> &Vs,
+	vector<TPoly > &Ps,
+	const int cellSize = 1
+	)
+{
+	vector<EVec4i> Qs;
+	t_SurfaceNetsQuad<T>( vRes, vPitch, vol, Thresh, minIdx, maxIdx, Vs, Qs, cellSize);
+
+	//split along the shorter diagonal
+	Ps.resize( Qs.size() * 2 );
+#pragma omp parallel for
+	for( int i = 0; i < (int)Qs.size(); ++i )
+	{
+		const EVec4i &q = Qs[i];
+		if( (Vs[q[0]] - Vs[q[2]]).squaredNorm() <= (Vs[q[1]] - Vs[q[3]]).squaredNorm() )
+		{
+			Ps[2 * i    ] = TPoly( q[0], q[1], q[2] );
+			Ps[2 * i + 1] = TPoly( q[0], q[2], q[3] );
+		}
+		else
+		{
+			Ps[2 * i    ] = TPoly( q[1], q[2], q[3] );
+			Ps[2 * i + 1] = TPoly( q[1], q[3], q[0] );
+		}
+	}
+}
+
+
+
+template<class T>
+void t_SurfaceNets(
+	const EVec3i &vRes  ,
+	const EVec3f &vPitch,
+	const T      *vol   ,
+	const T       Thresh,
+	const int    *minIdx,
+	const int    *maxIdx,
+	TMesh &mesh,
+	const int cellSize = 1)
+{
+	vector<EVec3f> Vs;
+	vector<TPoly > Ps;
+	t_SurfaceNets<T>( vRes, vPitch, vol, Thresh, minIdx, maxIdx, Vs, Ps, cellSize);
+
+	mesh.initialize(Vs, Ps);
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+#include "tmath.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * TVolume<T> : typed 3D volume without any OpenGL dependency
+ *
+ *  - storage is 64-byte aligned
+ *  - optional ghost layers (g voxels around the volume, x,y,z in [-g, res+g) are accessible)
+ *    and optional row padding (every row starts on a 64-byte boundary)
+ *  - voxel (x,y,z) is at data()[x + y * strideY() + z * strideZ()]
+ *    isContiguous() : no ghost / no row padding, data()[x + y*W + z*W*H]
+ *  - deep copy, move semantics, non-owning view (Wrap) and
+ *    zero-copy memory mapped raw file (MapFile, copy-on-write)
+ *  - forEachBrick : parallel iteration over B^3 bricks
+ *
+ * T should be trivially copyable (memcpy is used)
+-------------------------------------------------------------------*/
+
+template<class T>
+class TVolume
+{
+	enum MEM_TYPE
+	{
+		MEM_NONE = 0,
+		MEM_OWN  = 1, //aligned allocation
+		MEM_VIEW = 2, //external memory
+		MEM_MMAP = 3  //memory mapped file
+	};
+
+	EVec3i   m_res  ;
+	int      m_ghost;
+	int      m_lead ; //number of voxels before x = -g in a row
+	size_t   m_sy   ; //strides (in voxels)
+	size_t   m_sz   ;
+	T       *m_data ; //voxel (0,0,0)
+	void    *m_mem  ;
+	size_t   m_memSize;
+	MEM_TYPE m_memType;
+
+public:
+	~TVolume()
+	{
+		clear();
+	}
+
+	TVolume()
+	{
+		init();
+	}
+
+	TVolume(const int W, const int H, const int D, const int ghost = 0, const bool bPadRows = false)
+	{
+		init();
+		Allocate(W, H, D, ghost, bPadRows);
+	}
+
+	//zero-copy raw file (see MapFile)
+	TVolume(const char *fname, const int W, const int H, const int D, const size_t offset = 0)
+	{
+		init();
+		MapFile(fname, W, H, D, offset);
+	}
+
+	TVolume(const TVolume &src)
+	{
+		init();
+		copy(src);
+	}
+
+	TVolume(TVolume &&src) noexcept
+	{
+		init();
+		swap(src);
+	}
+
+	TVolume &operator=(const TVolume &src)
+	{
+		if (this != &src) copy(src);
+		return *this;
+	}
+
+	TVolume &operator=(TVolume &&src) noexcept
+	{
+		if (this != &src)
+		{
+			clear();
+			swap(src);
+		}
+		return *this;
+	}
+
+	void swap(TVolume &v) noexcept
+	{
+		std::swap(m_res    , v.m_res    );
+		std::swap(m_ghost  , v.m_ghost  );
+		std::swap(m_lead   , v.m_lead   );
+		std::swap(m_sy     , v.m_sy     );
+		std::swap(m_sz     , v.m_sz     );
+		std::swap(m_data   , v.m_data   );
+		std::swap(m_mem    , v.m_mem    );
+		std::swap(m_memSize, v.m_memSize);
+		std::swap(m_memType, v.m_memType);
+	}
+
+
+
+	void clear()
+	{
+		if (m_memType == MEM_OWN) alignedFree(m_mem);
+#ifdef _WIN32
+		if (m_memType == MEM_MMAP) UnmapViewOfFile(m_mem);
+#else
+		if (m_memType == MEM_MMAP) munmap(m_mem, m_memSize);
+#endif
+		init();
+	}
+
+
+
+	// allocate W x H x D voxels (values are not initialized)
+	// ghost    : number of ghost layers around the volume
+	// bPadRows : pad rows so that every row (x = 0) starts on a 64-byte boundary
+	bool Allocate(const int W, const int H, const int D, const int ghost = 0, const bool bPadRows = false)
+	{
+		clear();
+		if (W <= 0 || H <= 0 || D <= 0) return false;
+
+		const int A = (bPadRows && 64 % sizeof(T) == 0) ? (int)(64 / sizeof(T)) : 1;
+		const int g = max(0, ghost);
+
+		m_res   << W, H, D;
+		m_ghost = g;
+		m_lead  = (g + A - 1) / A * A - g;
+		m_sy    = (size_t)(m_lead + g + W + g + A - 1) / A * A;
+		m_sz    = m_sy * (H + 2 * g);
+
+		m_memSize = sizeof(T) * m_sz * (D + 2 * g);
+		m_mem     = alignedAlloc(m_memSize);
+		if (m_mem == 0)
+		{
+			fprintf(stderr, "TVolume::Allocate : failed to allocate %zu bytes\n", m_memSize);
+			init();
+			return false;
+		}
+		m_memType = MEM_OWN;
+		m_data    = (T*)m_mem + m_lead + g + g * m_sy + g * m_sz;
+		return true;
+	}
+
+	bool Allocate(const EVec3i &res, const int ghost = 0, const bool bPadRows = false)
+	{
+		return Allocate(res[0], res[1], res[2], ghost, bPadRows);
+	}
+
+
+
+	// non-owning view of contiguous W x H x D voxels
+	void Wrap(const int W, const int H, const int D, T *ptr)
+	{
+		clear();
+		m_res    << W, H, D;
+		m_sy      = W;
+		m_sz      = (size_t)W * H;
+		m_data    = ptr;
+		m_mem     = ptr;
+		m_memType = MEM_VIEW;
+	}
+
+
+
+	// map a raw file of W x H x D voxels starting at "offset" bytes (zero-copy)
+	// the mapping is copy-on-write : modifications are not written back to the file
+	bool MapFile(const char *fname, const int W, const int H, const int D, const size_t offset = 0)
+	{
+		clear();
+		const size_t dataSize = sizeof(T) * W * H * D;
+		if (dataSize == 0) return false;
+
+#ifdef _WIN32
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		const size_t ofs0 = offset / si.dwAllocationGranularity * si.dwAllocationGranularity;
+
+		HANDLE hFile = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (hFile == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fsize;
+		GetFileSizeEx(hFile, &fsize);
+		if ((size_t)fsize.QuadPart < offset + dataSize) { CloseHandle(hFile); return false; }
+
+		HANDLE hMap = CreateFileMappingA(hFile, 0, PAGE_WRITECOPY, 0, 0, 0);
+		void  *view = hMap ? MapViewOfFile(hMap, FILE_MAP_COPY, (DWORD)((unsigned long long)ofs0 >> 32), (DWORD)(ofs0 & 0xffffffff), offset - ofs0 + dataSize) : 0;
+		//the view keeps the mapping alive
+		if (hMap) CloseHandle(hMap);
+		CloseHandle(hFile);
+		if (view == 0) return false;
+#else
+		const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		const size_t ofs0 = offset / page * page;
+
+		const int fd = open(fname, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (size_t)st.st_size < offset + dataSize) { close(fd); return false; }
+
+		void *view = mmap(0, offset - ofs0 + dataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)ofs0);
+		close(fd);
+		if (view == MAP_FAILED) return false;
+#endif
+		m_res    << W, H, D;
+		m_sy      = W;
+		m_sz      = (size_t)W * H;
+		m_mem     = view;
+		m_memSize = offset - ofs0 + dataSize;
+		m_memType = MEM_MMAP;
+		m_data    = (T*)((char*)view + (offset - ofs0));
+		return true;
+	}
+
+
+
+	//accessors
+	int           getW    () const { return m_res[0]; }
+	int           getH    () const { return m_res[1]; }
+	int           getD    () const { return m_res[2]; }
+	const EVec3i &getRes  () const { return m_res   ; }
+	int           getGhost() const { return m_ghost ; }
+	size_t        getNum  () const { return (size_t)m_res[0] * m_res[1] * m_res[2]; }
+	size_t        strideY () const { return m_sy; }
+	size_t        strideZ () const { return m_sz; }
+	bool          isEmpty () const { return m_data == 0; }
+	bool          isOwner () const { return m_memType == MEM_OWN; }
+	bool          isContiguous() const { return m_sy == (size_t)m_res[0] && m_sz == (size_t)m_res[0] * m_res[1]; }
+
+	T       *data()       { return m_data; }
+	const T *data() const { return m_data; }
+
+	//row (y,z) starting at x = 0
+	T       *ptr(const int y, const int z)       { return m_data + y * (ptrdiff_t)m_sy + z * (ptrdiff_t)m_sz; }
+	const T *ptr(const int y, const int z) const { return m_data + y * (ptrdiff_t)m_sy + z * (ptrdiff_t)m_sz; }
+
+	T       &at(const int x, const int y, const int z)       { return ptr(y, z)[x]; }
+	const T &at(const int x, const int y, const int z) const { return ptr(y, z)[x]; }
+
+	//only for contiguous volumes
+	T       &operator[](const size_t i)       { return m_data[i]; }
+	const T &operator[](const size_t i) const { return m_data[i]; }
+
+
+
+	void Fill(const T v)
+	{
+#pragma omp parallel for
+		for (int z = 0; z < m_res[2]; ++z)
+			for (int y = 0; y < m_res[1]; ++y)
+			{
+				T *row = ptr(y, z);
+				for (int x = 0; x < m_res[0]; ++x) row[x] = v;
+			}
+	}
+
+	// set ghost voxels to v
+	void FillGhost(const T v)
+	{
+		const int g = m_ghost;
+		if (g == 0) return;
+		const int W = m_res[0], H = m_res[1], D = m_res[2];
+
+#pragma omp parallel for
+		for (int z = -g; z < D + g; ++z)
+			for (int y = -g; y < H + g; ++y)
+			{
+				T *row = ptr(y, z);
+				const bool bAll = (z < 0 || z >= D || y < 0 || y >= H);
+				for (int x = -g; x < W + g; ++x) if (bAll || x < 0 || x >= W) row[x] = v;
+			}
+	}
+
+	// copy contiguous W x H x D voxels (same resolution)
+	void Set(const T *src)
+	{
+		const int W = m_res[0], H = m_res[1];
+#pragma omp parallel for
+		for (int z = 0; z < m_res[2]; ++z)
+			for (int y = 0; y < H; ++y) memcpy(ptr(y, z), &src[y * W + (size_t)z * W * H], sizeof(T) * W);
+	}
+
+	// copy to contiguous W x H x D voxels
+	void CopyTo(T *dst) const
+	{
+		const int W = m_res[0], H = m_res[1];
+#pragma omp parallel for
+		for (int z = 0; z < m_res[2]; ++z)
+			for (int y = 0; y < H; ++y) memcpy(&dst[y * W + (size_t)z * W * H], ptr(y, z), sizeof(T) * W);
+	}
+
+
+
+	// call f(bMin, bMax) for each brick [bMin, bMax) of B^3 voxels in parallel
+	template<class FUNC>
+	void forEachBrick(const int B, const FUNC &f) const
+	{
+		const int bW = (m_res[0] + B - 1) / B;
+		const int bH = (m_res[1] + B - 1) / B;
+		const int bD = (m_res[2] + B - 1) / B;
+		const int N  = bW * bH * bD;
+
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < N; ++i)
+		{
+			const int bz = i / (bW * bH), by = (i / bW) % bH, bx = i % bW;
+			const EVec3i bMin(bx * B, by * B, bz * B);
+			const EVec3i bMax(min(m_res[0], bMin[0] + B), min(m_res[1], bMin[1] + B), min(m_res[2], bMin[2] + B));
+			f(bMin, bMax);
+		}
+	}
+
+
+
+private:
+	void init()
+	{
+		m_res    << 0, 0, 0;
+		m_ghost   = 0;
+		m_lead    = 0;
+		m_sy      = 0;
+		m_sz      = 0;
+		m_data    = 0;
+		m_mem     = 0;
+		m_memSize = 0;
+		m_memType = MEM_NONE;
+	}
+
+	//deep copy keeping the ghost / padding layout of src
+	void copy(const TVolume &src)
+	{
+		if (src.m_data == 0) { clear(); return; }
+
+		if (src.m_memType == MEM_OWN)
+		{
+			if (m_memType != MEM_OWN || m_memSize != src.m_memSize)
+			{
+				clear();
+				m_mem = alignedAlloc(src.m_memSize);
+				if (m_mem == 0) return;
+				m_memType = MEM_OWN;
+				m_memSize = src.m_memSize;
+			}
+			memcpy(m_mem, src.m_mem, src.m_memSize);
+			m_res   = src.m_res;
+			m_ghost = src.m_ghost;
+			m_lead  = src.m_lead;
+			m_sy    = src.m_sy;
+			m_sz    = src.m_sz;
+			m_data  = (T*)m_mem + (src.m_data - (T*)src.m_mem);
+		}
+		else
+		{
+			//view or mapped file -> owned contiguous copy
+			if (!Allocate(src.m_res)) return;
+			const int W = m_res[0], H = m_res[1];
+#pragma omp parallel for
+			for (int z = 0; z < m_res[2]; ++z)
+				for (int y = 0; y < H; ++y) memcpy(ptr(y, z), src.ptr(y, z), sizeof(T) * W);
+		}
+	}
+
+	static void *alignedAlloc(const size_t size)
+	{
+#ifdef _WIN32
+		return _aligned_malloc(size, 64);
+#else
+		void *p = 0;
+		return posix_memalign(&p, 64, size) == 0 ? p : 0;
+#endif
+	}
+
+	static void alignedFree(void *p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+};
+
+
+
+template<class T>
+void t_flipVolumeInZ(const int W, const int H, const int D, T* vol)
+{
+	const int WH = W*H;
+
+	T *tmp = new T[WH];
+
+	for (int z = 0; z < D / 2; ++z)
+	{
+		memcpy( tmp                 , &vol[ z       * WH ], sizeof( T ) * WH );
+		memcpy( &vol[ z       * WH ], &vol[ (D-1-z) * WH ], sizeof( T ) * WH );
+		memcpy( &vol[ (D-1-z) * WH ], tmp                 , sizeof( T ) * WH );
+	}
+	delete[] tmp;
+
+}
+
+
+
+template<class T>
+void t_flipVolumeInZ(TVolume<T> &v)
+{
+	const int W = v.getW(), H = v.getH(), D = v.getD();
+
+	T *tmp = new T[W];
+
+	for (int z = 0; z < D / 2; ++z)
+		for (int y = 0; y < H; ++y)
+		{
+			memcpy( tmp           , v.ptr(y, z)        , sizeof( T ) * W );
+			memcpy( v.ptr(y, z)   , v.ptr(y, D - 1 - z), sizeof( T ) * W );
+			memcpy( v.ptr(y, D-1-z), tmp               , sizeof( T ) * W );
+		}
+	delete[] tmp;
+}
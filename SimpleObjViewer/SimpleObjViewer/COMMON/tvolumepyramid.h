@@ -0,0 +1,122 @@
+#pragma once
+
+#include "tvolume.h"
+
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+
+
+/* -----------------------------------------------------------------
+ * volume mip pyramid
+ *
+ * level 0 is the input volume, level l+1 is level l downsampled by 2
+ * (2x2x2 voxels -> 1 voxel, max or mean, parallel over z).
+ * The voxel center of level l+1 is the center of its 2x2x2 children,
+ * so iso-surfaces of every level live in the same world coordinates
+ * with pitch * 2^l.
+-------------------------------------------------------------------*/
+
+enum TPyramidMode
+{
+	PYR_MAX  = 0,
+	PYR_MEAN = 1
+};
+
+
+
+// dst : ceil(W/2) x ceil(H/2) x ceil(D/2)
+// children outside src are ignored
+template<class T>
+void t_downsampleVolume2x(const TVolume<T> &src, TVolume<T> &dst, const TPyramidMode mode)
+{
+	const int W = src.getW(), H = src.getH(), D = src.getD();
+	const int dW = (W + 1) / 2, dH = (H + 1) / 2, dD = (D + 1) / 2;
+	dst.Allocate(dW, dH, dD);
+
+#pragma omp parallel for
+	for (int z = 0; z < dD; ++z)
+		for (int y = 0; y < dH; ++y)
+		{
+			T *o = dst.ptr(y, z);
+			const int z0 = 2 * z, z1 = min(2 * z + 1, D - 1);
+			const int y0 = 2 * y, y1 = min(2 * y + 1, H - 1);
+			const T *r[4] = { src.ptr(y0, z0), src.ptr(y1, z0), src.ptr(y0, z1), src.ptr(y1, z1) };
+			const int n = (1 + (y1 > y0)) * (1 + (z1 > z0));
+
+			for (int x = 0; x < dW; ++x)
+			{
+				const int x0 = 2 * x, x1 = min(2 * x + 1, W - 1);
+				if (mode == PYR_MAX)
+				{
+					T v = r[0][x0];
+					for (int k = 0; k < 4; ++k) v = max(v, max(r[k][x0], r[k][x1]));
+					o[x] = v;
+				}
+				else
+				{
+					double s = 0;
+					for (int k = 0; k < 4; ++k)
+					{
+						if ((k & 1) && y1 == y0) continue;
+						if ((k & 2) && z1 == z0) continue;
+						s += (double)r[k][x0] + (x1 > x0 ? (double)r[k][x1] : 0.0);
+					}
+					o[x] = (T)(s / (n * (1 + (x1 > x0))));
+				}
+			}
+		}
+}
+
+
+
+template<class T>
+class TVolumePyramid
+{
+	const TVolume<T>   *m_base  ; //level 0 (not owned)
+	vector<TVolume<T> > m_coarse; //level 1, 2, ...
+
+public:
+	TVolumePyramid()
+	{
+		m_base = 0;
+	}
+
+	// levels are generated until the coarsest level has at most minRes voxels along its longest axis
+	// vol should be kept alive while the pyramid is used
+	void Build(const TVolume<T> &vol, const TPyramidMode mode = PYR_MAX, const int minRes = 16)
+	{
+		m_base = &vol;
+		m_coarse.clear();
+
+		const TVolume<T> *cur = &vol;
+		while (max(cur->getW(), max(cur->getH(), cur->getD())) > max(1, minRes))
+		{
+			TVolume<T> next;
+			t_downsampleVolume2x(*cur, next, mode);
+			m_coarse.push_back(std::move(next));
+			cur = &m_coarse.back();
+		}
+	}
+
+	void clear()
+	{
+		m_base = 0;
+		m_coarse.clear();
+	}
+
+	int getLevelNum() const { return m_base ? 1 + (int)m_coarse.size() : 0; }
+
+	const TVolume<T> &getLevel(const int l) const { return l == 0 ? *m_base : m_coarse[l - 1]; }
+
+	// voxel pitch of level l
+	EVec3f getPitch(const int l, const EVec3f &pitch0) const { return pitch0 * (float)(1 << l); }
+
+	// the finest level having at most maxVoxNum voxels
+	int getLevelFor(const size_t maxVoxNum) const
+	{
+		for (int l = 0; l < getLevelNum(); ++l) if (getLevel(l).getNum() <= maxVoxNum) return l;
+		return getLevelNum() - 1;
+	}
+};
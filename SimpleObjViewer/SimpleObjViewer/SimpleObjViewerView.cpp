@@ -163,12 +163,16 @@ int CSimpleObjViewerView::OnCreate(LPCREATESTRUCT lpCreateStruct)
 	m_ogl.OnCreate(this);
 	m_ogl.SetCam( EVec3f(0,0,10), EVec3f(0,0,0), EVec3f(0,1,0));
 
+	HWND hWnd = m_hWnd;
+	m_expAsync.Start( m_mesh, [hWnd]() { ::InvalidateRect(hWnd, NULL, FALSE); } );
+
 	return 0;
 }
 
 
 void CSimpleObjViewerView::OnDestroy()
 {
+	m_expAsync.Stop();
 	CView::OnDestroy();
 	m_ogl.OnDestroy();
 
@@ -201,6 +205,23 @@ void CSimpleObjViewerView::OnPaint()
 {
 	CPaintDC dc(this); 
 
+	//newest map completed by the worker (the previous one is drawn until then)
+	if (m_expAsync.Acquire(m_expMap))
+	{
+		float scale = 0.03f;
+		for( auto &p : m_expMap)
+		{
+			p.pos *= scale;
+			p.pos += EVec2f(0.5f, 0.5f);
+
+			if( p.pos[0] < 0.1f) p.pos[0] = 0.1f;
+			if( p.pos[1] < 0.1f) p.pos[1] = 0.1f;
+			if( p.pos[0] > 0.9f) p.pos[0] = 0.9f;
+			if( p.pos[1] > 0.9f) p.pos[1] = 0.9f;
+
+		}
+	}
+
 
 	
 	m_ogl.OnDrawBegin();
@@ -342,22 +363,8 @@ void CSimpleObjViewerView::OnMouseMove(UINT nFlags, CPoint point)
 		m_ogl.GetCursorRay( point , rayP, rayD);
 		if (m_mesh.pickByRay(rayP, rayD, pos, polyIdx))
 		{
-			expnentialMapping( m_mesh, pos, polyIdx, m_expMap);
-
-			float scale = 0.03f;
-			for( auto &p : m_expMap)
-			{
-				p.pos *= scale;
-				p.pos += EVec2f(0.5f, 0.5f);
-
-				if( p.pos[0] < 0.1f) p.pos[0] = 0.1f;
-				if( p.pos[1] < 0.1f) p.pos[1] = 0.1f;
-				if( p.pos[0] > 0.9f) p.pos[0] = 0.9f;
-				if( p.pos[1] > 0.9f) p.pos[1] = 0.9f;
-
-			}
+			m_expAsync.Post( pos, polyIdx );
 		}
-		m_ogl.Redraw();
 	}
 
 
@@ -8,6 +8,7 @@
 #include "./COMMON/tmesh.h"
 #include "./COMMON/OglImage.h"
 #include "expmap.h"
+#include "texpmapasync.h"
 
 
 
@@ -17,6 +18,7 @@ class CSimpleObjViewerView : public CView
 	TMesh			  m_mesh   ;
 	OGLImage2D4       m_texture;
 	vector<ExpMapVtx> m_expMap;
+	TExpMapAsync      m_expAsync; //maps are grown by a worker thread, OnPaint picks up the newest one
 
 	bool m_bL, m_bR, m_bM;
 
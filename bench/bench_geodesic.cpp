@@ -0,0 +1,397 @@
+// accuracy / runtime of the geodesic distance and exp map modes on surfaces with a known log map
+//
+// usage : bench_geodesic [--steps=n] [--reps=n] [--out=file.csv] [--baseline=file.csv] [--tol=t] [--tmp=file.tcm]
+// surfaces (seed : centroid of the face closest to a fixed point, never on a vertex) :
+//   plane    : 2 x 2, M x M quads                        log map = (p - s) in the tangent plane
+//   sphere   : radius 1, geodesic sphere level L          log map = R acos(n_s.n_p) along the great circle
+//   cylinder : radius 0.5, height 4, open, M x 1.27M quads log map = unrolled (arc, dz)
+// the resolution doubles n times (default 5). Errors are measured on the vertices whose exact geodesic
+// distance is below the evaluation radius (away from the border / cut locus) :
+//   dist : |estimated distance - exact| / evaluation radius  (exp map : |pos|, Dijkstra : graph distance)
+//   pos  : |estimated log map - exact| / evaluation radius    (exp map modes only)
+// one CSV line per (mode, surface, resolution) with time and error statistics, for a time vs accuracy
+// Pareto chart; the table on stderr marks the Pareto optimal runs of each surface (*).
+// --baseline : CSV of a previous run; exit code 1 if an error is not finite or if a mean / max error of
+//              any (mode, surface, step) grew by more than the relative tolerance --tol (default 0.01).
+// note that neither mode converges everywhere : Dijkstra has the metrication error of the grid
+// (up to sqrt(2) along the anti diagonal) and the exp map keeps an O(1e-3) bias on the sphere.
+// a new mode is a new entry of "modes" in main; modes on another representation of the mesh (e.g. the
+// compact copy, rebuilt for every surface and step) capture it, keep their result in a captured variable
+// and convert it to ExpMapVtx in toVtx, after the timed repetitions.
+// the _chunked modes grow out of core (TChunkedMesh, chunks of 4096 vertices of the Hilbert ordered mesh, file --tmp)
+// up to maxDist = 1.5 x the evaluation radius (maxDist bounds the path length of the growth, up to sqrt(2) x
+// the geodesic distance on the grids) and read their chunks from the file in every repetition.
+// the _cached modes go through a TExpMapCache (cleared for every surface and step) with the same radius : the
+// seed is snapped to its barycentric cell, the first repetition is a miss and the time (best of --reps) is
+// that of a hit for reps > 1.
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include "expmap.h"
+#include "tmeshgen.h"
+#include "tmeshreorder.h"
+#include "texpmapcache.h"
+
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static string argValue(int argc, char *argv[], const char *key, const string &def)
+{
+	const size_t n = strlen(key);
+	for (int i = 1; i < argc; ++i) if (strncmp(argv[i], key, n) == 0 && argv[i][n] == '=') return string(argv[i] + n + 1);
+	return def;
+}
+
+
+
+enum TSurface { SURF_PLANE, SURF_SPHERE, SURF_CYLINDER };
+
+static const char *surfName(const TSurface s) { return s == SURF_PLANE ? "plane" : s == SURF_SPHERE ? "sphere" : "cylinder"; }
+
+static void genSurface(const TSurface s, const int step, TMesh &mesh)
+{
+	const int M = 16 << step;
+	if      (s == SURF_PLANE ) mesh.initializePlane   (2.0, 2.0, M, M);
+	else if (s == SURF_SPHERE) mesh.initializeGeodesicSphere(1.0, 3 + step);
+	else                       mesh.initializeCylinder(0.5, 4.0, M, (int)(1.27 * M));
+}
+
+//the point the seed face is searched around, and the evaluation radius
+static EVec3f seedTarget(const TSurface s) { return s == SURF_PLANE ? EVec3f(0.01f, 0.02f, 0) : s == SURF_SPHERE ? EVec3f(0.3f, 0.5f, 0.8f).normalized() : EVec3f(0, 0.5f, 0.03f); }
+static float  evalRadius(const TSurface s) { return s == SURF_PLANE ? 0.8f : s == SURF_SPHERE ? (float)(M_PI / 2) : 1.0f; }
+
+
+
+//exact distance and log map of p from the seed s, in the base frame (X,Y) of the exp map
+static void exactLogMap(const TSurface surf, const EVec3f &s, const EVec3f &p, const EVec3f &X, const EVec3f &Y, float &dist, EVec2f &pos)
+{
+	if (surf == SURF_PLANE)
+	{
+		const EVec3f d = p - s;
+		dist = d.norm();
+		pos << d.dot(X), d.dot(Y);
+		return;
+	}
+
+	EVec3f w; //log map in 3D (tangent vector at s of length dist)
+	if (surf == SURF_SPHERE)
+	{
+		const EVec3f ns = s.normalized(), np = p.normalized();
+		dist = acos(max(-1.0f, min(1.0f, ns.dot(np))));
+		const EVec3f t = np - np.dot(ns) * ns;
+		w = (t.norm() > 1e-12f) ? (dist * t.normalized()).eval() : EVec3f(0, 0, 0);
+	}
+	else
+	{
+		const float r = 0.5f;
+		const float phS = atan2(s[1], s[0]), phP = atan2(p[1], p[0]);
+		float dph = phP - phS;
+		if (dph >  (float)M_PI) dph -= 2 * (float)M_PI;
+		if (dph < -(float)M_PI) dph += 2 * (float)M_PI;
+		w = r * dph * EVec3f(-sin(phS), cos(phS), 0) + EVec3f(0, 0, p[2] - s[2]);
+		dist = w.norm();
+	}
+
+	const EVec2f v(w.dot(X), w.dot(Y));
+	pos = (v.norm() > 1e-12f) ? (dist * v.normalized()).eval() : EVec2f(0, 0);
+}
+
+
+
+struct TErrStat
+{
+	int    n;
+	double sum, sum2, maxV;
+	TErrStat() : n(0), sum(0), sum2(0), maxV(0) {}
+	void   Add (const double e) { ++n; sum += e; sum2 += e * e; maxV = max(maxV, e); }
+	double mean() const { return n ? sum / n : 0; }
+	double rms () const { return n ? sqrt(sum2 / n) : 0; }
+};
+
+//ExpMapCompact -> ExpMapVtx (flg 2 : reached)
+static void compactToVtx(const ExpMapCompact &c, vector<ExpMapVtx> &r)
+{
+	r.assign(c.m_dist.size(), ExpMapVtx());
+	for (int i = 0; i < (int)r.size(); ++i)
+	{
+		if (!c.isReached(i)) continue;
+		EVec2f p = c.getPos(i);
+		r[i].Set(2, -1, c.getDist(i), p);
+	}
+}
+
+//ExpMapPaged -> ExpMapVtx (blocks never touched : not reached)
+static void pagedToVtx(const ExpMapPaged &e, const int vSize, vector<ExpMapVtx> &r)
+{
+	r.assign(vSize, ExpMapVtx());
+	const int bits = e.getBlockBits();
+	for (int b = 0; b < e.getBlockNum(); ++b)
+	{
+		const ExpMapVtx *blk = e.getBlock(b);
+		if (blk) copy(blk, blk + min(1 << bits, vSize - (b << bits)), r.begin() + (b << bits));
+	}
+}
+
+
+
+struct TRun
+{
+	string   mode, surf;
+	int      step, vSize, pSize, evalN;
+	double   ms;
+	TErrStat dist, pos;
+	bool     hasPos;
+};
+
+
+
+int main(int argc, char *argv[])
+{
+	const int    steps   = atoi(argValue(argc, argv, "--steps", "5").c_str());
+	const int    reps    = atoi(argValue(argc, argv, "--reps" , "3").c_str());
+	const string outPath =      argValue(argc, argv, "--out"  , "" );
+	const string basePath=      argValue(argc, argv, "--baseline", "");
+	const double tol     = atof(argValue(argc, argv, "--tol"  , "0.01").c_str());
+	const string tmpPath =      argValue(argc, argv, "--tmp"  , "bench_geodesic_tmp.tcm");
+
+	//mode : name, has a log map, body (mesh, seed, seed face, result)
+	struct TMode
+	{
+		const char *name;
+		bool        bPos;
+		bool        bHilbert; //run on the Hilbert reordered mesh (results are mapped back)
+		bool        bChunked; //run on the chunk file of the Hilbert reordered mesh (seed face mapped by Write)
+		function<void(const TMesh&, const EVec3f&, int, vector<ExpMapVtx>&)> body;
+		function<void(const TMesh&, vector<ExpMapVtx>&)>                      toVtx; //not timed, empty : body fills ExpMapVtx
+	};
+	TCompactMesh compact; //16 bit positions, octahedral normals (the result : 16 bit distances, half float uv)
+	TChunkedMesh chunked; //out of core, read from tmpPath
+	TExpMapCache cache  ; //quantized seeds
+	float        localR = 0; //maxDist of the out of core and cached growths
+	bool         bReadOk = true;
+	ExpMapCompact compactRes;
+	ExpMapPaged   pagedRes  ;
+
+	const TMode modes[] = {
+		{ "expnentialMapping"        , true , false, false, [](const TMesh &m, const EVec3f &s, int p, vector<ExpMapVtx> &r) { expnentialMapping(m, s, p, r); }, nullptr },
+		{ "expnentialMapping_hilbert", true , true , false, [](const TMesh &m, const EVec3f &s, int p, vector<ExpMapVtx> &r) { expnentialMapping(m, s, p, r); }, nullptr },
+		{ "DijikstraMapping"         , false, false, false, [](const TMesh &m, const EVec3f &s, int p, vector<ExpMapVtx> &r) { DijikstraMapping (m, s, p, r); }, nullptr },
+		{ "expnentialMapping_compact", true , false, false, [&](const TMesh &, const EVec3f &s, int p, vector<ExpMapVtx> &) { expnentialMapping(compact, s, p, compactRes); },
+			[&](const TMesh &, vector<ExpMapVtx> &r) { compactToVtx(compactRes, r); } },
+		{ "DijikstraMapping_compact" , false, false, false, [&](const TMesh &, const EVec3f &s, int p, vector<ExpMapVtx> &) { DijikstraMapping (compact, s, p, compactRes); },
+			[&](const TMesh &, vector<ExpMapVtx> &r) { compactToVtx(compactRes, r); } },
+		{ "expnentialMapping_chunked", true , true , true , [&](const TMesh &, const EVec3f &s, int p, vector<ExpMapVtx> &) {
+			chunked.dropAll(); bReadOk &= expnentialMapping(chunked, s, p, localR, pagedRes); },
+			[&](const TMesh &m, vector<ExpMapVtx> &r) { pagedToVtx(pagedRes, m.m_vSize, r); } },
+		{ "DijikstraMapping_chunked" , false, true , true , [&](const TMesh &, const EVec3f &s, int p, vector<ExpMapVtx> &) {
+			chunked.dropAll(); bReadOk &= DijikstraMapping (chunked, s, p, localR, pagedRes); },
+			[&](const TMesh &m, vector<ExpMapVtx> &r) { pagedToVtx(pagedRes, m.m_vSize, r); } },
+		{ "expnentialMapping_cached" , true , false, false, [&](const TMesh &m, const EVec3f &s, int p, vector<ExpMapVtx> &r) { cache.Compute(m, s, p, EXPMAP_EXPONENTIAL, localR, r); }, nullptr },
+		{ "DijikstraMapping_cached"  , false, false, false, [&](const TMesh &m, const EVec3f &s, int p, vector<ExpMapVtx> &r) { cache.Compute(m, s, p, EXPMAP_DIJKSTRA   , localR, r); }, nullptr },
+	};
+
+	vector<TRun> runs;
+	fprintf(stderr, "%-26s %-8s %9s %10s %10s %10s %10s %10s %10s\n", "mode", "surface", "verts", "time[ms]", "dMean", "dRms", "dMax", "posMean", "posMax");
+
+	for (const TSurface surf : { SURF_PLANE, SURF_SPHERE, SURF_CYLINDER })
+	{
+		const float evalR = evalRadius(surf);
+		localR = 1.5f * evalR;
+
+		for (int step = 0; step < steps; ++step)
+		{
+			TMesh mesh;
+			genSurface(surf, step, mesh);
+
+			//seed : centroid of the face closest to the target
+			int pIdx = 0;
+			float best = FLT_MAX;
+			for (int i = 0; i < mesh.m_pSize; ++i)
+			{
+				const int *idx = mesh.m_pPolys[i].idx;
+				const float d = ((mesh.m_vVerts[idx[0]] + mesh.m_vVerts[idx[1]] + mesh.m_vVerts[idx[2]]) / 3.0f - seedTarget(surf)).squaredNorm();
+				if (d < best) { best = d; pIdx = i; }
+			}
+			const int   *pi   = mesh.m_pPolys[pIdx].idx;
+			const EVec3f seed = (mesh.m_vVerts[pi[0]] + mesh.m_vVerts[pi[1]] + mesh.m_vVerts[pi[2]]) / 3.0f;
+
+			//exact seed on the surface and the base frame of the exp map (expmap.cpp)
+			EVec3f seedS = seed;
+			if (surf == SURF_SPHERE  ) seedS = seed.normalized();
+			if (surf == SURF_CYLINDER) { EVec2f xy(seed[0], seed[1]); xy = 0.5f * xy.normalized(); seedS << xy[0], xy[1], seed[2]; }
+			const EVec3f N = mesh.m_pNorms[pIdx], Xdir(1, 0, 0);
+			const EVec3f X = (Xdir - Xdir.dot(N) * N).normalized(), Y = N.cross(X);
+
+			vector<float>  exD(mesh.m_vSize);
+			vector<EVec2f> exP(mesh.m_vSize);
+			for (int i = 0; i < mesh.m_vSize; ++i) exactLogMap(surf, seedS, mesh.m_vVerts[i], X, Y, exD[i], exP[i]);
+
+			TMesh reordered;
+			vector<int> vNew, pNew, pChunk;
+			compact.Set(mesh);
+			chunked.Close();
+			cache.clear();
+
+			for (const TMode &mode : modes)
+			{
+				const TMesh *m = &mesh;
+				int seedFace = pIdx;
+				if (mode.bHilbert)
+				{
+					if (reordered.m_vSize == 0)
+					{
+						reordered = mesh;
+						reordered.reorder(VORDER_HILBERT, true, &vNew, &pNew);
+					}
+					m = &reordered;
+					seedFace = pNew[pIdx];
+				}
+				if (mode.bChunked)
+				{
+					if (chunked.m_vSize == 0 && (!TChunkedMesh::Write(tmpPath.c_str(), reordered, 12, &pChunk) || !chunked.Open(tmpPath.c_str())))
+					{
+						fprintf(stderr, "failed to write / open %s\n", tmpPath.c_str());
+						return 1;
+					}
+					seedFace = pChunk[seedFace];
+				}
+
+				vector<ExpMapVtx> res;
+				double ms = DBL_MAX;
+				for (int r = 0; r < max(1, reps); ++r)
+				{
+					auto t0 = std::chrono::steady_clock::now();
+					mode.body(*m, seed, seedFace, res);
+					ms = min(ms, elapsedMs(t0));
+				}
+				if (mode.toVtx) mode.toVtx(*m, res);
+
+				TRun run;
+				run.mode   = mode.name;
+				run.surf   = surfName(surf);
+				run.step   = step;
+				run.vSize  = mesh.m_vSize;
+				run.pSize  = mesh.m_pSize;
+				run.ms     = ms;
+				run.hasPos = mode.bPos;
+				run.evalN  = 0;
+				for (int i = 0; i < mesh.m_vSize; ++i)
+				{
+					if (exD[i] > evalR) continue;
+					const ExpMapVtx &e = res[mode.bHilbert ? vNew[i] : i];
+					const float d = mode.bPos ? e.pos.norm() : e.dist;
+					++run.evalN;
+					run.dist.Add(fabs(d - exD[i]) / evalR);
+					if (mode.bPos) run.pos.Add((e.pos - exP[i]).norm() / evalR);
+				}
+				runs.push_back(run);
+			}
+		}
+	}
+
+	chunked.Close();
+	remove(tmpPath.c_str());
+	if (!bReadOk)
+	{
+		fprintf(stderr, "chunk read failed\n");
+		return 1;
+	}
+
+	//Pareto optimal runs (no other run of the surface is at least as fast and as accurate in mean distance, and better in one)
+	//mean errors closer than float rounding (1e-6 of the evaluation radius) count as equal
+	const double errEps = 1e-6;
+	for (const TRun &r : runs)
+	{
+		bool bPareto = true;
+		for (const TRun &q : runs)
+		{
+			const double qe = q.dist.mean(), re = r.dist.mean();
+			if (&q != &r && q.surf == r.surf && q.ms <= r.ms && qe <= re + errEps && (q.ms < r.ms || qe < re - errEps)) bPareto = false;
+		}
+
+		fprintf(stderr, "%-26s %-8s %9d %10.2f %10.5f %10.5f %10.5f", r.mode.c_str(), r.surf.c_str(), r.vSize, r.ms, r.dist.mean(), r.dist.rms(), r.dist.maxV);
+		if (r.hasPos) fprintf(stderr, " %10.5f %10.5f", r.pos.mean(), r.pos.maxV);
+		else          fprintf(stderr, " %10s %10s", "-", "-");
+		fprintf(stderr, "%s\n", bPareto ? " *" : "");
+	}
+
+	FILE *fp = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open %s\n", outPath.c_str());
+		return 1;
+	}
+	fprintf(fp, "mode,surface,step,vertices,faces,evaluated,time_ms,dist_mean,dist_rms,dist_max,pos_mean,pos_rms,pos_max\n");
+	for (const TRun &r : runs)
+	{
+		fprintf(fp, "%s,%s,%d,%d,%d,%d,%.4f,%.6g,%.6g,%.6g,", r.mode.c_str(), r.surf.c_str(), r.step, r.vSize, r.pSize, r.evalN, r.ms, r.dist.mean(), r.dist.rms(), r.dist.maxV);
+		if (r.hasPos) fprintf(fp, "%.6g,%.6g,%.6g\n", r.pos.mean(), r.pos.rms(), r.pos.maxV);
+		else          fprintf(fp, ",,\n");
+	}
+	if (fp != stdout) fclose(fp);
+
+	if (basePath.empty()) return 0;
+
+	FILE *bf = fopen(basePath.c_str(), "r");
+	if (!bf)
+	{
+		fprintf(stderr, "failed to open %s\n", basePath.c_str());
+		return 1;
+	}
+
+	int failN = 0;
+	for (const TRun &r : runs)
+	{
+		if (!std::isfinite(r.dist.sum) || !std::isfinite(r.pos.sum) || r.evalN == 0)
+		{
+			fprintf(stderr, "FAIL %s %s step %d : invalid error\n", r.mode.c_str(), r.surf.c_str(), r.step);
+			++failN;
+		}
+	}
+
+	//mode,surface,step,vertices,faces,evaluated,time_ms,dist_mean,dist_rms,dist_max,pos_mean,pos_rms,pos_max
+	char buf[1024];
+	while (fgets(buf, sizeof(buf), bf))
+	{
+		char   mode[256], surf[256];
+		int    step, vN, pN, eN;
+		double ms, dMean, dRms, dMax, pMean = 0, pRms = 0, pMax = 0;
+		for (char *c = buf; *c; ++c) if (*c == ',') *c = ' ';
+		if (sscanf(buf, "%255s %255s %d %d %d %d %lf %lf %lf %lf %lf %lf %lf", mode, surf, &step, &vN, &pN, &eN, &ms, &dMean, &dRms, &dMax, &pMean, &pRms, &pMax) < 10) continue;
+
+		for (const TRun &r : runs)
+		{
+			if (r.mode != mode || r.surf != surf || r.step != step) continue;
+			auto worse = [tol](double now, double base) { return now > base * (1 + tol) + 1e-7; };
+			if (worse(r.dist.mean(), dMean) || worse(r.dist.maxV, dMax) || (r.hasPos && (worse(r.pos.mean(), pMean) || worse(r.pos.maxV, pMax))))
+			{
+				fprintf(stderr, "FAIL %s %s step %d : error (dist %g / %g, pos %g / %g) above the baseline (%g / %g, %g / %g)\n",
+					mode, surf, step, r.dist.mean(), r.dist.maxV, r.pos.mean(), r.pos.maxV, dMean, dMax, pMean, pMax);
+				++failN;
+			}
+		}
+	}
+	fclose(bf);
+
+	fprintf(stderr, "%s\n", failN ? "baseline check FAILED" : "baseline check passed");
+	return failN ? 1 : 0;
+}
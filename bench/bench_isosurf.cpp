@@ -0,0 +1,248 @@
+// benchmark : t_MarchingCubes vs t_SurfaceNets (time and mesh size)
+//
+// usage : bench_isosurf [maxRes]
+// synthetic volumes (binary blobs like segmentation masks, smooth scalar field)
+// are generated for resolutions 64, 128, ... maxRes
+// SN2 : t_SurfaceNets with cellSize 2. dist : distance of the vertices of a mesh to the MC surface and
+// of the MC vertices to that mesh, in voxels (mean / max, searched within 2 voxels)
+// MCfull : t_MarchingCubes + TMesh::initialize (the cost of an edit without blocks), MCblk : TMarchingCubesBlocks
+// Initialize + getMesh, MCupd : Update per edit (balls added / carved). After the edits getMesh must have the
+// triangles of t_MarchingCubes and the rings / normals of TMesh::initialize, else "DIFF" (exit code 1)
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include "tmarchingcubes.h"
+#include "tmarchingcubesblocks.h"
+#include "tsurfacenets.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+
+//sum of a few metaballs : binary mask (0/255) or smooth field (0..255)
+static void genVolume(const int N, const bool bBinary, vector<unsigned char> &vol)
+{
+	const EVec3f c[4] = { EVec3f(0.35f, 0.40f, 0.50f), EVec3f(0.65f, 0.55f, 0.45f), EVec3f(0.50f, 0.70f, 0.60f), EVec3f(0.45f, 0.30f, 0.30f) };
+	const float  r[4] = { 0.20f, 0.18f, 0.15f, 0.12f };
+
+	vol.resize( (size_t)N * N * N );
+#pragma omp parallel for
+	for (int z = 0; z < N; ++z)
+	for (int y = 0; y < N; ++y)
+	for (int x = 0; x < N; ++x)
+	{
+		EVec3f p( (x + 0.5f) / N, (y + 0.5f) / N, (z + 0.5f) / N );
+		float f = 0;
+		for (int i = 0; i < 4; ++i) f += r[i] * r[i] / max(1e-6f, (p - c[i]).squaredNorm());
+		f += 0.15f * sin(20 * p[0]) * sin(17 * p[1]) * sin(23 * p[2]);
+
+		const size_t I = x + (size_t)y * N + (size_t)z * N * N;
+		if (bBinary) vol[I] = (f > 1.0f) ? 255 : 0;
+		else         vol[I] = (unsigned char)max(0.0f, min(255.0f, 128.0f * f));
+	}
+}
+
+
+
+//closest point of triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static EVec3f closestOnTriangle(const EVec3f &p, const EVec3f &a, const EVec3f &b, const EVec3f &c)
+{
+	const EVec3f ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+	const EVec3f bp = p - b;
+	const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + (d1 / (d1 - d3)) * ab;
+	const EVec3f cp = p - c;
+	const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + (d2 / (d2 - d6)) * ac;
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+	const float den = 1.0f / (va + vb + vc);
+	return a + ab * (vb * den) + ac * (vc * den);
+}
+
+//mean / max distance (in voxels) of the points Ps to the triangles (Vs, Fs), triangles are bucketed per voxel
+static void surfaceDist(const int N, const vector<EVec3f> &Ps, const vector<EVec3f> &Vs, const vector<TPoly> &Fs, double &mean, double &maxD)
+{
+	const int R = 2, G = N + 2;
+	auto cell = [&](const float v) { return max(0, min(G - 1, (int)floor(v * N) + 1)); };
+	vector<vector<int>> bucket((size_t)G * G * G);
+	for (int f = 0; f < (int)Fs.size(); ++f)
+	{
+		const EVec3f &a = Vs[Fs[f].idx[0]], &b = Vs[Fs[f].idx[1]], &c = Vs[Fs[f].idx[2]];
+		const EVec3f lo = a.cwiseMin(b).cwiseMin(c), hi = a.cwiseMax(b).cwiseMax(c);
+		for (int z = cell(lo[2]); z <= cell(hi[2]); ++z)
+		for (int y = cell(lo[1]); y <= cell(hi[1]); ++y)
+		for (int x = cell(lo[0]); x <= cell(hi[0]); ++x) bucket[x + (size_t)y * G + (size_t)z * G * G].push_back(f);
+	}
+
+	double sum = 0, mx = 0;
+#pragma omp parallel for reduction(+:sum) reduction(max:mx)
+	for (int i = 0; i < (int)Ps.size(); ++i)
+	{
+		const EVec3f &p = Ps[i];
+		const int cx = cell(p[0]), cy = cell(p[1]), cz = cell(p[2]);
+		float d2 = (float)(R * R) / ((float)N * N);
+		for (int z = max(0, cz - R); z <= min(G - 1, cz + R); ++z)
+		for (int y = max(0, cy - R); y <= min(G - 1, cy + R); ++y)
+		for (int x = max(0, cx - R); x <= min(G - 1, cx + R); ++x)
+		for (const int f : bucket[x + (size_t)y * G + (size_t)z * G * G])
+			d2 = min(d2, (p - closestOnTriangle(p, Vs[Fs[f].idx[0]], Vs[Fs[f].idx[1]], Vs[Fs[f].idx[2]])).squaredNorm());
+		const double d = sqrt((double)d2) * N;
+		sum += d;
+		mx = max(mx, d);
+	}
+	mean = Ps.empty() ? 0 : sum / Ps.size();
+	maxD = mx;
+}
+
+
+
+//same triangles (as vertex positions, up to the order of faces and the rotation of each face) and vertex number
+static bool sameSurface(const TMesh &mesh, const vector<EVec3f> &Vs, const vector<TPoly> &Ps)
+{
+	if (mesh.m_vSize != (int)Vs.size() || mesh.m_pSize != (int)Ps.size()) return false;
+
+	auto triangles = [](const EVec3f *V, const TPoly *P, const int pSize)
+	{
+		vector<array<float, 9>> T(pSize);
+		for (int f = 0; f < pSize; ++f)
+		{
+			int s = 0;
+			for (int k = 1; k < 3; ++k)
+			{
+				const EVec3f &a = V[P[f].idx[k]], &b = V[P[f].idx[s]];
+				if (make_tuple(a[0], a[1], a[2]) < make_tuple(b[0], b[1], b[2])) s = k;
+			}
+			for (int k = 0; k < 3; ++k) for (int d = 0; d < 3; ++d) T[f][3 * k + d] = V[P[f].idx[(s + k) % 3]][d];
+		}
+		sort(T.begin(), T.end());
+		return T;
+	};
+	return triangles(mesh.m_vVerts, mesh.m_pPolys, mesh.m_pSize) == triangles(Vs.data(), Ps.data(), (int)Ps.size());
+}
+
+//rings and normals equal to those TMesh::initialize computes for the same arrays
+//(normals bitwise : zero area MC triangles, e.g. at voxels equal to the threshold, have nan normals)
+static bool sameRingsAndNormals(const TMesh &mesh)
+{
+	TMesh ref;
+	ref.initialize(vector<EVec3f>(mesh.m_vVerts, mesh.m_vVerts + mesh.m_vSize), vector<TPoly>(mesh.m_pPolys, mesh.m_pPolys + mesh.m_pSize));
+	for (int i = 0; i < mesh.m_vSize; ++i)
+		if (ref.m_vRingPs[i] != mesh.m_vRingPs[i] || ref.m_vRingVs[i] != mesh.m_vRingVs[i]) return false;
+	return memcmp(ref.m_vNorms, mesh.m_vNorms, sizeof(EVec3f) * mesh.m_vSize) == 0 &&
+	       memcmp(ref.m_pNorms, mesh.m_pNorms, sizeof(EVec3f) * mesh.m_pSize) == 0;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	const int maxRes = (argc > 1) ? atoi(argv[1]) : 256;
+
+	printf("%-8s %-6s %-6s %10s %12s %12s %12s %16s %16s\n", "volume", "res", "method", "time[ms]", "vertices", "triangles", "quads", "dist to MC", "dist from MC");
+	int nFail = 0;
+
+	for (int N = 64; N <= maxRes; N *= 2)
+	{
+		for (int bBinary = 1; bBinary >= 0; --bBinary)
+		{
+			vector<unsigned char> vol;
+			genVolume(N, bBinary != 0, vol);
+			const EVec3i res(N, N, N);
+			const EVec3f pitch(1.0f / N, 1.0f / N, 1.0f / N);
+			const char *name = bBinary ? "binary" : "smooth";
+
+			vector<EVec3f> mcVs, Vs;
+			vector<TPoly > mcPs, Ps;
+			vector<EVec4i> Qs;
+
+			auto t0 = std::chrono::steady_clock::now();
+			t_MarchingCubes<unsigned char>(res, pitch, vol.data(), 128, 0, 0, mcVs, mcPs);
+			double tMC = elapsedMs(t0);
+			printf("%-8s %-6d %-6s %10.2f %12d %12d %12s\n", name, N, "MC", tMC, (int)mcVs.size(), (int)mcPs.size(), "-");
+
+			for (int cellSize = 1; cellSize <= 2; ++cellSize)
+			{
+				Vs.clear(); Ps.clear();
+				t0 = std::chrono::steady_clock::now();
+				t_SurfaceNets<unsigned char>(res, pitch, vol.data(), 128, 0, 0, Vs, Ps, cellSize);
+				double tSN = elapsedMs(t0);
+
+				double toMean, toMax, fromMean, fromMax;
+				surfaceDist(N, Vs, mcVs, mcPs, toMean, toMax);
+				surfaceDist(N, mcVs, Vs, Ps, fromMean, fromMax);
+				printf("%-8s %-6d %-6s %10.2f %12d %12d %12s %7.3f / %6.3f %7.3f / %6.3f\n", name, N, cellSize == 1 ? "SN" : "SN2", tSN,
+					(int)Vs.size(), (int)Ps.size(), "-", toMean, toMax, fromMean, fromMax);
+			}
+
+			Vs.clear();
+			t0 = std::chrono::steady_clock::now();
+			t_SurfaceNetsQuad<unsigned char>(res, pitch, vol.data(), 128, 0, 0, Vs, Qs);
+			double tSQ = elapsedMs(t0);
+			printf("%-8s %-6d %-6s %10.2f %12d %12s %12d\n", name, N, "SNquad", tSQ, (int)Vs.size(), "-", (int)Qs.size());
+
+			t0 = std::chrono::steady_clock::now();
+			{
+				TMesh full;
+				t_MarchingCubes<unsigned char>(res, pitch, vol.data(), 128, 0, 0, full);
+			}
+			printf("%-8s %-6d %-6s %10.2f %12d %12d %12s\n", name, N, "MCfull", elapsedMs(t0), (int)mcVs.size(), (int)mcPs.size(), "-");
+
+			TMarchingCubesBlocks<unsigned char> blocks;
+			t0 = std::chrono::steady_clock::now();
+			blocks.Initialize(res, pitch, vol.data(), 128);
+			const TMesh &mesh = blocks.getMesh();
+			printf("%-8s %-6d %-6s %10.2f %12d %12d %12s\n", name, N, "MCblk", elapsedMs(t0), mesh.m_vSize, mesh.m_pSize, "-");
+
+			//balls of radius N/16 at spread centers, added and carved in turn
+			const int E = 8, R = N / 16;
+			double tUpd = 0;
+			for (int e = 0; e < E; ++e)
+			{
+				const int c[3] = { N / 4 + (e * 37) % (N / 2), N / 4 + (e * 53) % (N / 2), N / 4 + (e * 71) % (N / 2) };
+				const int minIdx[3] = { c[0] - R, c[1] - R, c[2] - R }, maxIdx[3] = { c[0] + R, c[1] + R, c[2] + R };
+				for (int z = minIdx[2]; z <= maxIdx[2]; ++z)
+				for (int y = minIdx[1]; y <= maxIdx[1]; ++y)
+				for (int x = minIdx[0]; x <= maxIdx[0]; ++x)
+					if ((x - c[0]) * (x - c[0]) + (y - c[1]) * (y - c[1]) + (z - c[2]) * (z - c[2]) <= R * R)
+						vol[x + (size_t)y * N + (size_t)z * N * N] = (e % 2) ? 0 : 255;
+
+				t0 = std::chrono::steady_clock::now();
+				blocks.Update(vol.data(), minIdx, maxIdx);
+				tUpd += elapsedMs(t0);
+			}
+
+			mcVs.clear(); mcPs.clear();
+			t_MarchingCubes<unsigned char>(res, pitch, vol.data(), 128, 0, 0, mcVs, mcPs);
+			const bool bSame = sameSurface(mesh, mcVs, mcPs) && sameRingsAndNormals(mesh);
+			if (!bSame) ++nFail;
+			printf("%-8s %-6d %-6s %10.2f %12d %12d %12s %16s\n", name, N, "MCupd", tUpd / E, mesh.m_vSize, mesh.m_pSize, "-", bSame ? "same as MC" : "DIFF");
+		}
+	}
+	return nFail ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+// out-of-core exp map : page cache traffic and memory of TChunkedMesh against the in-core TMesh
+//
+// usage : bench_ooc [--level=L] [--bits=b] [--budget_mb=m] [--tmp=file.tcm]
+// input : geodesic sphere of level L (default 8) with 2% noise, in Hilbert order, written as a chunk file
+// for a few geodesic radii, expnentialMapping / DijikstraMapping on the chunk file are compared with the
+// in-core run : every vertex reached out of core must have exactly the in-core (dist, pos, from).
+// reported : time, chunks read, bytes read and peak resident chunk data (vs the file / TMesh size).
+// pickByRay is checked the same way (same face, only the chunks along the ray are read).
+// last, the chunk file is truncated under the open TChunkedMesh : the growths must report the read failure.
+// exit code 1 on a mismatch.
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include "expmap.h"
+#include "tmeshgen.h"
+#include "tmeshreorder.h"
+
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static string argValue(int argc, char *argv[], const char *key, const string &def)
+{
+	const size_t n = strlen(key);
+	for (int i = 1; i < argc; ++i) if (strncmp(argv[i], key, n) == 0 && argv[i][n] == '=') return string(argv[i] + n + 1);
+	return def;
+}
+
+static size_t meshBytes(const TMesh &m)
+{
+	size_t n = (3 * sizeof(EVec3f) + 2 * sizeof(vector<int>)) * (size_t)m.m_vSize + (sizeof(TPoly) + sizeof(EVec3f)) * (size_t)m.m_pSize;
+	for (int i = 0; i < m.m_vSize; ++i) n += sizeof(int) * (m.m_vRingVs[i].capacity() + m.m_vRingPs[i].capacity());
+	return n;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	const int    level   = atoi(argValue(argc, argv, "--level"    , "8"  ).c_str());
+	const int    bits    = atoi(argValue(argc, argv, "--bits"     , "14" ).c_str());
+	const double budget  = atof(argValue(argc, argv, "--budget_mb", "64" ).c_str());
+	const string tmpPath =      argValue(argc, argv, "--tmp"      , "bench_ooc_tmp.tcm");
+
+	TMesh mesh;
+	mesh.initializeGeodesicSphere(1.0, level);
+	mesh.addNoise(0.02f, 3.0f, 1);
+	mesh.reorder(VORDER_HILBERT, false);
+
+	vector<int> pNew;
+	if (!TChunkedMesh::Write(tmpPath.c_str(), mesh, bits, &pNew)) return 1;
+
+	TChunkedMesh ooc;
+	if (!ooc.Open(tmpPath.c_str(), (size_t)(budget * (1 << 20)))) return 1;
+
+	FILE *fp = fopen(tmpPath.c_str(), "rb");
+	t_fseek64(fp, 0, SEEK_END);
+	const double fileMB = t_ftell64(fp) / 1048576.0;
+	fclose(fp);
+
+	printf("mesh : %d vertices, %d faces, TMesh %.1f MB, chunk file %.1f MB (%d chunks of %d vertices), budget %.0f MB\n",
+		mesh.m_vSize, mesh.m_pSize, meshBytes(mesh) / 1048576.0, fileMB, ooc.m_chunkNum, 1 << bits, budget);
+
+	//seed : picked from outside, checked against the in-core pick
+	const EVec3f rayD = -EVec3f(0.3f, 0.5f, 0.8f).normalized();
+	EVec3f seedA, seedB;
+	int    pA, pB;
+	auto t0 = std::chrono::steady_clock::now();
+	mesh.pickByRay(-3.0f * rayD, rayD, seedA, pA);
+	const double msPickA = elapsedMs(t0);
+	t0 = std::chrono::steady_clock::now();
+	ooc.pickByRay(-3.0f * rayD, rayD, seedB, pB);
+	const double msPickB = elapsedMs(t0);
+
+	bool bOk = pA >= 0 && pB == pNew[pA] && (seedA - seedB).norm() < 1e-6f;
+	printf("%-22s %8s %10s %8s %10s %10s %10s %s\n", "", "radius", "ms", "chunks", "read[MB]", "peak[MB]", "state[MB]", "check");
+	printf("%-22s %8s %10.2f %8lld %10.1f %10.1f %10s %s\n", "pickByRay", "-", msPickB, ooc.getFaultNum(), ooc.getReadBytes() / 1048576.0,
+		ooc.getPeakBytes() / 1048576.0, "-", bOk ? "ok" : "MISMATCH");
+	printf("%-22s %8s %10.2f\n", "pickByRay (in core)", "-", msPickA);
+
+	vector<ExpMapVtx> ref;
+	ExpMapPaged       res;
+	const float radii[3] = { 0.05f, 0.2f, 0.8f };
+
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		t0 = std::chrono::steady_clock::now();
+		if (mode == 0) expnentialMapping(mesh, seedA, pA, ref);
+		else           DijikstraMapping (mesh, seedA, pA, ref);
+		printf("%-22s %8s %10.2f\n", mode == 0 ? "expnentialMapping" : "DijikstraMapping", "in core", elapsedMs(t0));
+
+		for (const float r : radii)
+		{
+			ooc.dropAll();
+			ooc.resetStats();
+			t0 = std::chrono::steady_clock::now();
+			const bool   bRead = (mode == 0) ? expnentialMapping(ooc, seedB, pB, r, res) : DijikstraMapping(ooc, seedB, pB, r, res);
+			const double ms    = elapsedMs(t0);
+			if (!bRead) { fprintf(stderr, "chunk read failed\n"); bOk = false; }
+
+			//reached out of core == in core, and every in-core vertex within r is reached
+			int nBad = 0, nReached = 0;
+			for (int i = 0; i < mesh.m_vSize; ++i)
+			{
+				const ExpMapVtx *b = res.getBlock(i >> bits);
+				const bool bIn = b && b[i & ((1 << bits) - 1)].flg == 2;
+				if (bIn)
+				{
+					const ExpMapVtx &v = b[i & ((1 << bits) - 1)];
+					++nReached;
+					if (v.dist != ref[i].dist || v.from != ref[i].from || (mode == 0 && v.pos != ref[i].pos)) ++nBad;
+				}
+				else if (ref[i].dist <= r) ++nBad;
+			}
+			bOk = bOk && nBad == 0;
+
+			char name[64];
+			sprintf(name, "  %d vertices", nReached);
+			printf("%-22s %8.2f %10.2f %8lld %10.1f %10.1f %10.1f %s\n", name, r, ms, ooc.getFaultNum(), ooc.getReadBytes() / 1048576.0,
+				ooc.getPeakBytes() / 1048576.0, res.getMemorySize() / 1048576.0, nBad == 0 ? "ok" : "MISMATCH");
+		}
+	}
+
+	//read failure : the file is cut at the start of chunk cS = chunkNum - 2 while that chunk is resident and
+	//the budget is minimal (only the pinned and the last read chunk stay). The front then evicts cS while
+	//reading the lower chunks and faults on it again (pivot rings, neighbors or the seed face), for 8 seeds
+	//in cS. The growths must stop (return false) without crashing and every vertex settled before the
+	//failure must have the in-core (dist, pos, from).
+	{
+		const int cS = max(0, ooc.m_chunkNum - 2);
+		vector<int> seeds;
+		for (int p = 0; p < mesh.m_pSize; ++p)
+		{
+			const int *idx = mesh.m_pPolys[p].idx;
+			if (min(idx[0], min(idx[1], idx[2])) >> bits == cS) seeds.push_back(p);
+		}
+
+		//whole file, and the offset of chunk cS (chunk table after "TCM1" and 4 ints, 44 bytes per chunk)
+		long long    cut = 0;
+		vector<char> file((size_t)(fileMB * 1048576.0 + 0.5));
+		fp = fopen(tmpPath.c_str(), "rb");
+		bool bIo = fp && fread(file.data(), 1, file.size(), fp) == file.size() && !seeds.empty();
+		if (bIo) memcpy(&cut, &file[4 + 4 * sizeof(int) + (size_t)cS * 44], sizeof(long long));
+		if (fp) fclose(fp);
+
+		int nSeed = 0, nFailed = 0, nBad = 0;
+		long long nSettled = 0;
+		t0 = std::chrono::steady_clock::now();
+		for (int k = 0; k < 8 && bIo; ++k)
+		{
+			const int    pS = seeds[seeds.size() * k / 8];
+			const int   *idx = mesh.m_pPolys[pS].idx;
+			const EVec3f seedS = (mesh.m_vVerts[idx[0]] + mesh.m_vVerts[idx[1]] + mesh.m_vVerts[idx[2]]) / 3.0f;
+
+			fp = fopen(tmpPath.c_str(), "wb");
+			bIo = fp && fwrite(file.data(), 1, file.size(), fp) == file.size();
+			if (fp) fclose(fp);
+			bIo = bIo && ooc.Open(tmpPath.c_str(), 1);
+			if (!bIo) break;
+			expnentialMapping(ooc, seedS, pNew[pS], radii[0], res);
+			ooc.getVert(idx[0]);
+
+			fp = fopen(tmpPath.c_str(), "wb");
+			bIo = fp && fwrite(file.data(), 1, (size_t)cut, fp) == (size_t)cut;
+			if (fp) fclose(fp);
+
+			for (int mode = 0; mode < 2 && bIo; ++mode)
+			{
+				if (mode == 0) expnentialMapping(mesh, seedS, pS, radii[2], ref);
+				else           DijikstraMapping (mesh, seedS, pS, radii[2], ref);
+				const bool bRead = (mode == 0) ? expnentialMapping(ooc, seedS, pNew[pS], radii[2], res) : DijikstraMapping(ooc, seedS, pNew[pS], radii[2], res);
+				++nSeed;
+				if (!bRead) ++nFailed;
+
+				for (int i = 0; i < mesh.m_vSize; ++i)
+				{
+					const ExpMapVtx *b = res.getBlock(i >> bits);
+					if (!b || b[i & ((1 << bits) - 1)].flg != 2) continue;
+					const ExpMapVtx &v = b[i & ((1 << bits) - 1)];
+					++nSettled;
+					if (ref[i].flg != 2 || v.dist != ref[i].dist || v.from != ref[i].from || (mode == 0 && v.pos != ref[i].pos)) ++nBad;
+				}
+			}
+		}
+		const bool bCutOk = bIo && nSeed == 16 && nFailed == nSeed && nBad == 0;
+		bOk = bOk && bCutOk;
+
+		char name[64];
+		sprintf(name, "cut at chunk %d", cS);
+		printf("%-22s %8.2f %10.2f %8s %10s %10s %10s %s (%d of %d growths reported the failure, %lld vertices settled before it)\n",
+			name, radii[2], elapsedMs(t0), "-", "-", "-", "-", bCutOk ? "ok" : (bIo ? "MISMATCH" : "IO ERROR"), nFailed, nSeed, nSettled);
+	}
+
+	ooc.Close();
+	remove(tmpPath.c_str());
+	return bOk ? 0 : 1;
+}
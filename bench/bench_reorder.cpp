@@ -0,0 +1,179 @@
+// benchmark : TMesh::reorder (vertex / face order) vs Dijkstra, exp map and smoothing throughput
+//
+// usage : bench_reorder [res]
+// a marching cubes mesh of metaballs (res^3 volume, slice order) is tested
+//   input    : as extracted
+//   shuffled : random vertex / face order (like a scanner output)
+// and the shuffled mesh reordered by Morton, Hilbert and RCM (faces : Forsyth).
+// Dijkstra distances are checked against the input order through the returned permutation.
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include "tmarchingcubes.h"
+#include "expmap.h"
+#include "tmeshreorder.h"
+
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+
+//iso-surface of a few metaballs
+static void genMesh(const int N, TMesh &mesh)
+{
+	const EVec3f c[4] = { EVec3f(0.35f, 0.40f, 0.50f), EVec3f(0.65f, 0.55f, 0.45f), EVec3f(0.50f, 0.70f, 0.60f), EVec3f(0.45f, 0.30f, 0.30f) };
+	const float  r[4] = { 0.20f, 0.18f, 0.15f, 0.12f };
+
+	vector<unsigned char> vol((size_t)N * N * N);
+#pragma omp parallel for
+	for (int z = 0; z < N; ++z)
+	for (int y = 0; y < N; ++y)
+	for (int x = 0; x < N; ++x)
+	{
+		EVec3f p( (x + 0.5f) / N, (y + 0.5f) / N, (z + 0.5f) / N );
+		float f = 0;
+		for (int i = 0; i < 4; ++i) f += r[i] * r[i] / max(1e-6f, (p - c[i]).squaredNorm());
+		f += 0.15f * sin(20 * p[0]) * sin(17 * p[1]) * sin(23 * p[2]);
+		vol[x + (size_t)y * N + (size_t)z * N * N] = (unsigned char)max(0.0f, min(255.0f, 128.0f * f));
+	}
+
+	vector<EVec3f> Vs;
+	vector<TPoly > Ps;
+	t_MarchingCubes<unsigned char>(EVec3i(N, N, N), EVec3f(1.0f / N, 1.0f / N, 1.0f / N), vol.data(), 128, 0, 0, Vs, Ps);
+	mesh.initialize(Vs, Ps);
+}
+
+
+
+//random vertex and face order, vNew / pNew : new index of each old vertex / face
+static void shuffleMesh(TMesh &mesh, vector<int> &vNew, vector<int> &pNew)
+{
+	std::mt19937 rng(1234);
+	vector<int> vOld(mesh.m_vSize), pOld(mesh.m_pSize);
+	for (int i = 0; i < mesh.m_vSize; ++i) vOld[i] = i;
+	for (int i = 0; i < mesh.m_pSize; ++i) pOld[i] = i;
+	shuffle(vOld.begin(), vOld.end(), rng);
+	shuffle(pOld.begin(), pOld.end(), rng);
+
+	vNew.resize(mesh.m_vSize);
+	pNew.resize(mesh.m_pSize);
+	for (int i = 0; i < mesh.m_vSize; ++i) vNew[vOld[i]] = i;
+	for (int i = 0; i < mesh.m_pSize; ++i) pNew[pOld[i]] = i;
+
+	vector<EVec3f> Vs(mesh.m_vSize);
+	vector<TPoly > Ps(mesh.m_pSize);
+	for (int i = 0; i < mesh.m_vSize; ++i) Vs[i] = mesh.m_vVerts[vOld[i]];
+	for (int i = 0; i < mesh.m_pSize; ++i)
+	{
+		const int *p = mesh.m_pPolys[pOld[i]].idx;
+		Ps[i] = TPoly(vNew[p[0]], vNew[p[1]], vNew[p[2]]);
+	}
+	mesh.initialize(Vs, Ps);
+}
+
+
+
+//face closest to the center of the bounding box
+static int centerFace(const TMesh &mesh)
+{
+	EVec3f minV, maxV;
+	mesh.getBoundBox(minV, maxV);
+	const EVec3f c = 0.5f * (minV + maxV);
+	int best = 0;
+	float bestD = FLT_MAX;
+	for (int i = 0; i < mesh.m_pSize; ++i)
+	{
+		const float d = (mesh.m_vVerts[mesh.m_pPolys[i].idx[0]] - c).squaredNorm();
+		if (d < bestD) { bestD = d; best = i; }
+	}
+	return best;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	const int N = (argc > 1) ? atoi(argv[1]) : 256;
+
+	TMesh input;
+	genMesh(N, input);
+	const int    f0 = centerFace(input);
+	const EVec3f p0 = input.m_vVerts[input.m_pPolys[f0].idx[0]];
+	printf("res %d : %d vertices, %d faces\n", N, input.m_vSize, input.m_pSize);
+
+	//reference distances (input order)
+	vector<ExpMapVtx> ref;
+	DijikstraMapping(input, p0, f0, ref);
+
+	TMesh shuffled;
+	vector<int> vShuf, pShuf;
+	shuffled.Set(input);
+	shuffleMesh(shuffled, vShuf, pShuf);
+
+	printf("%-9s %10s %8s %12s %12s %14s %9s %6s\n", "order", "reorder[ms]", "ACMR", "dijkstra[ms]", "expmap[ms]", "smooth x10[ms]", "Mvert/s", "check");
+
+	const char        *names [] = { "input", "shuffled", "morton", "hilbert", "rcm" };
+	const TVertexOrder orders[] = { VORDER_NONE, VORDER_NONE, VORDER_MORTON, VORDER_HILBERT, VORDER_RCM };
+
+	for (int t = 0; t < 5; ++t)
+	{
+		TMesh mesh;
+		mesh.Set(t == 0 ? input : shuffled);
+
+		//input index -> index in this mesh
+		vector<int> vMap(input.m_vSize), pMap(input.m_pSize);
+		for (int i = 0; i < input.m_vSize; ++i) vMap[i] = (t == 0) ? i : vShuf[i];
+		for (int i = 0; i < input.m_pSize; ++i) pMap[i] = (t == 0) ? i : pShuf[i];
+
+		double tReorder = 0;
+		if (t >= 2)
+		{
+			vector<int> vNew, pNew;
+			auto t0 = std::chrono::steady_clock::now();
+			mesh.reorder(orders[t], true, &vNew, &pNew);
+			tReorder = elapsedMs(t0);
+			for (int i = 0; i < input.m_vSize; ++i) vMap[i] = vNew[vMap[i]];
+			for (int i = 0; i < input.m_pSize; ++i) pMap[i] = pNew[pMap[i]];
+		}
+		const float acmr = t_faceOrderACMR(mesh.m_pSize, (const int*)mesh.m_pPolys, mesh.m_vSize);
+
+		vector<ExpMapVtx> res;
+		auto t0 = std::chrono::steady_clock::now();
+		DijikstraMapping(mesh, p0, pMap[f0], res);
+		const double tDij = elapsedMs(t0);
+
+		bool bOk = true;
+		for (int i = 0; i < input.m_vSize && bOk; ++i) bOk = fabs(ref[i].dist - res[vMap[i]].dist) <= 1e-5f * max(1.0f, ref[i].dist);
+
+		t0 = std::chrono::steady_clock::now();
+		expnentialMapping(mesh, p0, pMap[f0], res);
+		const double tExp = elapsedMs(t0);
+
+		mesh.smoothing(1, SMOOTH_UNIFORM, 0.5f); //builds the CSR
+		t0 = std::chrono::steady_clock::now();
+		mesh.smoothing(10, SMOOTH_UNIFORM, 0.5f);
+		const double tSm = elapsedMs(t0);
+
+		printf("%-9s %10.1f %8.3f %12.1f %12.1f %14.1f %9.1f %6s\n", names[t], tReorder, acmr, tDij, tExp, tSm,
+			10.0 * mesh.m_vSize / max(1e-9, tSm) / 1000.0, bOk ? "ok" : "DIFF");
+	}
+	return 0;
+}
@@ -0,0 +1,543 @@
+// benchmark suite : mesh loading / connectivity / picking / exp map, marching cubes and morphology
+//
+// usage : bench_suite [--filter=substr] [--min_time=sec] [--max_level=L] [--max_res=N] [--out=file.json]
+// every benchmark runs until min_time (default 0.5 s) is spent in its timed section (at least 3 iterations)
+// inputs are deterministic :
+//   ico<L>    : icosahedron (TMesh::initializeIcosaHedron) subdivided L times, on the unit sphere
+//   noisy<L>  : the same with a radial noise of 2% of the radius
+//   geo<L>    : TMesh::initializeGeodesicSphere (same size as ico<L>, generated in place)
+//   *_compact : the same kernel on TCompactMesh (quantized positions, octahedral normals)
+//   vol<N>    : N^3 metaballs (smooth field 0..255, binary label volume 1/255)
+// checks (exit code 1 if one fails) : TIsoSurfacePreview must end with the t_MarchingCubes mesh of the last threshold
+// the results are written as JSON (same layout as Google Benchmark, time in ms) to stdout or --out,
+// a table is printed to stderr
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#include "tmarchingcubes.h"
+#include "tisosurfacepreview.h"
+#include "tmorphology.h"
+#include "expmap.h"
+#include "tmeshgen.h"
+#include "tmeshsubdiv.h"
+#include "texpmapasync.h"
+
+#include <map>
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+
+class TBenchRunner
+{
+	struct Result
+	{
+		string name;
+		long long iterations;
+		double meanMs, minMs;
+		double bytes, items; //per iteration
+	};
+
+	double         m_minTimeMs;
+	string         m_filter;
+	vector<Result> m_results;
+
+public:
+	TBenchRunner(const double minTimeSec, const string &filter)
+	{
+		m_minTimeMs = 1000.0 * minTimeSec;
+		m_filter    = filter;
+	}
+
+	bool isEnabled(const string &name) const { return m_filter.empty() || name.find(m_filter) != string::npos; }
+
+	// body() runs one iteration and returns the time of its timed section [ms]
+	// bytes / items : processed per iteration (0 : not reported)
+	template<class BODY>
+	void Run(const string &name, BODY body, const double bytes = 0, const double items = 0)
+	{
+		if (!isEnabled(name)) return;
+
+		body(); //warm up
+		Result r;
+		r.name  = name;
+		r.bytes = bytes;
+		r.items = items;
+		r.iterations = 0;
+		r.minMs = DBL_MAX;
+		double sum = 0;
+		while (r.iterations < 3 || sum < m_minTimeMs)
+		{
+			const double t = body();
+			sum    += t;
+			r.minMs = min(r.minMs, t);
+			++r.iterations;
+		}
+		r.meanMs = sum / r.iterations;
+		m_results.push_back(r);
+
+		fprintf(stderr, "%-34s %10lld %12.3f %12.3f", name.c_str(), r.iterations, r.meanMs, r.minMs);
+		if (bytes > 0) fprintf(stderr, " %10.1f MB/s", bytes / r.meanMs / 1000.0);
+		if (items > 0) fprintf(stderr, " %10.2f M/s" , items / r.meanMs / 1000.0);
+		fprintf(stderr, "\n");
+	}
+
+	void WriteJson(FILE *fp) const
+	{
+		char date[64];
+		const time_t now = time(0);
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+		fprintf(fp, "{\n  \"context\": {\n");
+		fprintf(fp, "    \"date\": \"%s\",\n", date);
+		fprintf(fp, "    \"num_threads\": %d,\n", omp_get_max_threads());
+#ifdef __AVX2__
+		fprintf(fp, "    \"avx2\": true,\n");
+#else
+		fprintf(fp, "    \"avx2\": false,\n");
+#endif
+		fprintf(fp, "    \"time_unit\": \"ms\"\n  },\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < m_results.size(); ++i)
+		{
+			const Result &r = m_results[i];
+			fprintf(fp, "    {\n");
+			fprintf(fp, "      \"name\": \"%s\",\n", r.name.c_str());
+			fprintf(fp, "      \"iterations\": %lld,\n", r.iterations);
+			fprintf(fp, "      \"real_time\": %.6f,\n", r.meanMs);
+			fprintf(fp, "      \"min_time\": %.6f,\n", r.minMs);
+			if (r.bytes > 0) fprintf(fp, "      \"bytes_per_second\": %.1f,\n", r.bytes / r.meanMs * 1000.0);
+			if (r.items > 0) fprintf(fp, "      \"items_per_second\": %.1f,\n", r.items / r.meanMs * 1000.0);
+			fprintf(fp, "      \"time_unit\": \"ms\"\n");
+			fprintf(fp, "    }%s\n", (i + 1 < m_results.size()) ? "," : "");
+		}
+		fprintf(fp, "  ]\n}\n");
+	}
+};
+
+
+
+//icosahedron subdivided "level" times (each triangle -> 4), vertices on the unit sphere
+//noise > 0 : radius 1 + noise * (deterministic pseudo random value in [-1,1])
+static void genIcoSphere(const int level, const float noise, TMesh &mesh)
+{
+	TMesh ico;
+	ico.initializeIcosaHedron(1.0);
+	vector<EVec3f> Vs(ico.m_vVerts, ico.m_vVerts + ico.m_vSize);
+	vector<TPoly > Ps(ico.m_pPolys, ico.m_pPolys + ico.m_pSize);
+
+	for (int l = 0; l < level; ++l)
+	{
+		map<pair<int, int>, int> mid;
+		auto midpoint = [&](int a, int b) -> int
+		{
+			if (a > b) swap(a, b);
+			auto it = mid.find(make_pair(a, b));
+			if (it != mid.end()) return it->second;
+			Vs.push_back((0.5f * (Vs[a] + Vs[b])).normalized());
+			mid[make_pair(a, b)] = (int)Vs.size() - 1;
+			return (int)Vs.size() - 1;
+		};
+
+		vector<TPoly> newPs;
+		newPs.reserve(Ps.size() * 4);
+		for (const auto &p : Ps)
+		{
+			const int a = p.idx[0], b = p.idx[1], c = p.idx[2];
+			const int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			newPs.push_back(TPoly(a, ab, ca));
+			newPs.push_back(TPoly(ab, b, bc));
+			newPs.push_back(TPoly(ca, bc, c));
+			newPs.push_back(TPoly(ab, bc, ca));
+		}
+		Ps.swap(newPs);
+	}
+
+	for (auto &v : Vs) v.normalize();
+	if (noise > 0)
+	{
+		unsigned int s = 12345;
+		for (auto &v : Vs)
+		{
+			s = s * 1664525u + 1013904223u;
+			v *= 1.0f + noise * ((s >> 8) / (float)(1 << 24) * 2.0f - 1.0f);
+		}
+	}
+	mesh.initialize(Vs, Ps);
+}
+
+
+
+//sum of a few metaballs : binary label volume (1/255) or smooth field (0..255)
+static void genVolume(const int N, const bool bBinary, TVolume<unsigned char> &vol)
+{
+	const EVec3f c[4] = { EVec3f(0.35f, 0.40f, 0.50f), EVec3f(0.65f, 0.55f, 0.45f), EVec3f(0.50f, 0.70f, 0.60f), EVec3f(0.45f, 0.30f, 0.30f) };
+	const float  r[4] = { 0.20f, 0.18f, 0.15f, 0.12f };
+
+	vol.Allocate(N, N, N);
+#pragma omp parallel for
+	for (int z = 0; z < N; ++z)
+	for (int y = 0; y < N; ++y)
+	for (int x = 0; x < N; ++x)
+	{
+		EVec3f p( (x + 0.5f) / N, (y + 0.5f) / N, (z + 0.5f) / N );
+		float f = 0;
+		for (int i = 0; i < 4; ++i) f += r[i] * r[i] / max(1e-6f, (p - c[i]).squaredNorm());
+		f += 0.15f * sin(20 * p[0]) * sin(17 * p[1]) * sin(23 * p[2]);
+
+		if (bBinary) vol.at(x, y, z) = (f > 1.0f) ? 255 : 1;
+		else         vol.at(x, y, z) = (unsigned char)max(0.0f, min(255.0f, 128.0f * f));
+	}
+}
+
+
+
+static string argValue(int argc, char *argv[], const char *key, const string &def)
+{
+	const size_t n = strlen(key);
+	for (int i = 1; i < argc; ++i) if (strncmp(argv[i], key, n) == 0 && argv[i][n] == '=') return string(argv[i] + n + 1);
+	return def;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	const double minTime  = atof(argValue(argc, argv, "--min_time" , "0.5").c_str());
+	const int    maxLevel = atoi(argValue(argc, argv, "--max_level", "7"  ).c_str());
+	const int    maxRes   = atoi(argValue(argc, argv, "--max_res"  , "256").c_str());
+	const string filter   =      argValue(argc, argv, "--filter"   , ""   );
+	const string outPath  =      argValue(argc, argv, "--out"      , ""   );
+
+	TBenchRunner bench(minTime, filter);
+	fprintf(stderr, "%-34s %10s %12s %12s\n", "benchmark", "iterations", "mean[ms]", "min[ms]");
+
+	char name[256];
+	int  nFail = 0;
+
+	//meshes
+	for (int L = 3; L <= maxLevel; L += 2)
+	{
+		TMesh ico, noisy;
+		genIcoSphere(L, 0.00f, ico  );
+		genIcoSphere(L, 0.02f, noisy);
+		const int F = ico.m_pSize, V = ico.m_vSize;
+
+		//parametric generator : arrays only, and with the connectivity / normals
+		sprintf(name, "t_genGeodesicSphere/geo%d", L);
+		if (bench.isEnabled(name))
+		{
+			vector<EVec3f> Vs(V), Ts(V);
+			vector<int>    Ps(3 * F);
+			bench.Run(name, [&]()
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				t_genGeodesicSphere(1.0f, L, Vs.data(), Ts.data(), Ps.data());
+				return elapsedMs(t0);
+			}, 0, F);
+		}
+
+		sprintf(name, "initializeGeodesicSphere/geo%d", L);
+		bench.Run(name, [&]()
+		{
+			TMesh m;
+			auto t0 = std::chrono::steady_clock::now();
+			m.initializeGeodesicSphere(1.0, L);
+			return elapsedMs(t0);
+		}, 0, F);
+
+		//obj loader (MB/s of the file)
+		sprintf(name, "load_obj/ico%d", L);
+		if (bench.isEnabled(name))
+		{
+			const string path = "bench_suite_tmp.obj";
+			ico.exportObjNoTexCd(path.c_str());
+			FILE *fp = fopen(path.c_str(), "rb");
+			fseek(fp, 0, SEEK_END);
+			const double bytes = (double)ftell(fp);
+			fclose(fp);
+
+			bench.Run(name, [&]()
+			{
+				TMesh m;
+				auto t0 = std::chrono::steady_clock::now();
+				m.initialize(path.c_str());
+				return elapsedMs(t0);
+			}, bytes);
+			remove(path.c_str());
+		}
+
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			sprintf(name, "subdivide_%s/ico%d", mode == 0 ? "midpoint" : "loop", L);
+			bench.Run(name, [&]()
+			{
+				TMesh m(ico);
+				auto t0 = std::chrono::steady_clock::now();
+				m.subdivide((TSubdivMode)mode);
+				return elapsedMs(t0);
+			}, 0, F);
+		}
+
+		sprintf(name, "updateRingInfo/ico%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			ico.updateRingInfo();
+			return elapsedMs(t0);
+		}, 0, F);
+
+		sprintf(name, "updateNormal/ico%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			ico.updateNormal();
+			return elapsedMs(t0);
+		}, 0, F);
+
+		//rays from outside toward the center (deterministic directions)
+		sprintf(name, "pickByRay/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			static int k = 0;
+			const float th = 0.7f * (k % 97), ph = 0.3f * (k % 89);
+			++k;
+			const EVec3f d(cos(th) * sin(ph), sin(th) * sin(ph), cos(ph));
+			EVec3f pos;
+			int    pIdx;
+			auto t0 = std::chrono::steady_clock::now();
+			noisy.pickByRay(3.0f * d, -d, pos, pIdx);
+			return elapsedMs(t0);
+		}, 0, F);
+
+		//seed : center of face 0
+		const int   *p0   = noisy.m_pPolys[0].idx;
+		const EVec3f seed = (noisy.m_vVerts[p0[0]] + noisy.m_vVerts[p0[1]] + noisy.m_vVerts[p0[2]]) / 3.0f;
+		vector<ExpMapVtx> expMap;
+
+		sprintf(name, "expnentialMapping/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			expnentialMapping(noisy, seed, 0, expMap);
+			return elapsedMs(t0);
+		}, 0, V);
+
+		sprintf(name, "DijikstraMapping/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			DijikstraMapping(noisy, seed, 0, expMap);
+			return elapsedMs(t0);
+		}, 0, V);
+
+		//result cache : a miss (growth + encoding) and a hit (decoding only)
+		for (int r = 0; r < 2; ++r)
+		{
+			const float  radius = (r == 0) ? FLT_MAX : 0.3f;
+			const string suffix = (r == 0) ? "" : "_r0.3";
+			sprintf(name, "TExpMapCache_miss%s/noisy%d", suffix.c_str(), L);
+			bench.Run(name, [&]()
+			{
+				TExpMapCache cache;
+				auto t0 = std::chrono::steady_clock::now();
+				cache.Compute(noisy, seed, 0, EXPMAP_EXPONENTIAL, radius, expMap);
+				return elapsedMs(t0);
+			}, 0, V);
+
+			sprintf(name, "TExpMapCache_hit%s/noisy%d", suffix.c_str(), L);
+			if (bench.isEnabled(name))
+			{
+				TExpMapCache cache;
+				cache.Compute(noisy, seed, 0, EXPMAP_EXPONENTIAL, radius, expMap);
+				bench.Run(name, [&]()
+				{
+					auto t0 = std::chrono::steady_clock::now();
+					cache.Compute(noisy, seed, 0, EXPMAP_EXPONENTIAL, radius, expMap);
+					return elapsedMs(t0);
+				}, 0, V);
+			}
+		}
+
+		//drag : 8 seeds posted back to back (as mouse moves do), time until the map of the last one is acquired
+		//the superseded seeds are dropped or canceled, so this stays close to one growth instead of 8
+		sprintf(name, "TExpMapAsync_drag8/noisy%d", L);
+		if (bench.isEnabled(name))
+		{
+			TExpMapAsync async(0); //no cache : every seed is grown
+			int nStale = 0;
+			async.Start(noisy);
+			bench.Run(name, [&]()
+			{
+				static int k = 0;
+				long long idPost = 0, idGot = -1;
+				auto t0 = std::chrono::steady_clock::now();
+				for (int i = 0; i < 8; ++i, ++k)
+				{
+					const int    pi = (k * 7919) % noisy.m_pSize;
+					const int   *p  = noisy.m_pPolys[pi].idx;
+					idPost = async.Post((noisy.m_vVerts[p[0]] + noisy.m_vVerts[p[1]] + noisy.m_vVerts[p[2]]) / 3.0f, pi);
+				}
+				async.WaitIdle();
+				if (!async.Acquire(expMap, &idGot) || idGot != idPost) ++nStale;
+				return elapsedMs(t0);
+			}, 0, V);
+			async.Stop();
+			if (nStale) fprintf(stderr, "  %d runs did not end with the map of the last seed\n", nStale);
+		}
+
+		//the same on the compact (quantized) copy
+		TCompactMesh  compact(noisy);
+		ExpMapCompact expMapC;
+
+		sprintf(name, "pickByRay_compact/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			static int k = 0;
+			const float th = 0.7f * (k % 97), ph = 0.3f * (k % 89);
+			++k;
+			const EVec3f d(cos(th) * sin(ph), sin(th) * sin(ph), cos(ph));
+			EVec3f pos;
+			int    pIdx;
+			auto t0 = std::chrono::steady_clock::now();
+			compact.pickByRay(3.0f * d, -d, pos, pIdx);
+			return elapsedMs(t0);
+		}, 0, F);
+
+		sprintf(name, "expnentialMapping_compact/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			expnentialMapping(compact, seed, 0, expMapC);
+			return elapsedMs(t0);
+		}, 0, V);
+
+		sprintf(name, "DijikstraMapping_compact/noisy%d", L);
+		bench.Run(name, [&]()
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			DijikstraMapping(compact, seed, 0, expMapC);
+			return elapsedMs(t0);
+		}, 0, V);
+	}
+
+	//volumes
+	for (int N = 64; N <= maxRes; N *= 2)
+	{
+		TVolume<unsigned char> field, label;
+		genVolume(N, false, field);
+		genVolume(N, true , label);
+		const double voxN = (double)N * N * N;
+
+		sprintf(name, "t_MarchingCubes/vol%d", N);
+		bench.Run(name, [&]()
+		{
+			vector<EVec3f> Vs;
+			vector<TPoly > Ps;
+			auto t0 = std::chrono::steady_clock::now();
+			t_MarchingCubes<unsigned char>(field.getRes(), EVec3f(1.0f / N, 1.0f / N, 1.0f / N), field.data(), 128, 0, 0, Vs, Ps);
+			return elapsedMs(t0);
+		}, voxN, voxN);
+
+		//slider drag : 8 thresholds posted back to back, time until the level 0 mesh of the last one is fetched
+		sprintf(name, "TIsoSurfacePreview_drag8/vol%d", N);
+		if (bench.isEnabled(name))
+		{
+			const EVec3f pitch(1.0f / N, 1.0f / N, 1.0f / N);
+			TIsoSurfacePreview<unsigned char> iso;
+			iso.SetVolume(field, pitch);
+			vector<EVec3f> Vs, mcVs;
+			vector<TPoly > Ps, mcPs;
+			int nWrong = 0;
+			bench.Run(name, [&]()
+			{
+				static int k = 0;
+				unsigned char th = 0;
+				int level = -1;
+				auto t0 = std::chrono::steady_clock::now();
+				for (int i = 0; i < 8; ++i, ++k) iso.SetThresh(th = (unsigned char)(96 + (k * 5) % 64));
+				while (iso.isRefining()) std::this_thread::yield();
+				const bool   bGot = iso.FetchMesh(Vs, Ps, &level);
+				const double t    = elapsedMs(t0);
+
+				mcVs.clear(); mcPs.clear();
+				t_MarchingCubes<unsigned char>(field.getRes(), pitch, field.data(), th, 0, 0, mcVs, mcPs);
+				if (!bGot || level != 0 || Vs.size() != mcVs.size() || Ps.size() != mcPs.size() ||
+					memcmp(Vs.data(), mcVs.data(), sizeof(EVec3f) * Vs.size()) != 0 ||
+					memcmp(Ps.data(), mcPs.data(), sizeof(TPoly ) * Ps.size()) != 0) ++nWrong;
+				return t;
+			}, voxN, voxN);
+			if (nWrong)
+			{
+				fprintf(stderr, "  %d runs did not end with the t_MarchingCubes mesh of the last threshold\n", nWrong);
+				++nFail;
+			}
+		}
+
+		sprintf(name, "t_morpho3D_erode/vol%d", N);
+		bench.Run(name, [&]()
+		{
+			TVolume<unsigned char> v(label);
+			auto t0 = std::chrono::steady_clock::now();
+			t_morpho3D_erode(v);
+			return elapsedMs(t0);
+		}, voxN, voxN);
+
+		sprintf(name, "t_morpho3D_dilate/vol%d", N);
+		bench.Run(name, [&]()
+		{
+			TVolume<unsigned char> v(label);
+			auto t0 = std::chrono::steady_clock::now();
+			t_morpho3D_dilate(v);
+			return elapsedMs(t0);
+		}, voxN, voxN);
+
+		TBitVolume bits(N, N, N);
+		bits.Set(label, [](const unsigned char v) { return v == 255; });
+
+		for (int se = 0; se < 2; ++se)
+		{
+			sprintf(name, "t_bitMorpho_dilate_%s_r4/vol%d", se == 0 ? "box" : "ball", N);
+			bench.Run(name, [&]()
+			{
+				TBitVolume b(bits);
+				auto t0 = std::chrono::steady_clock::now();
+				t_bitMorpho_dilate(b, 4, (TMorphoSE)se);
+				return elapsedMs(t0);
+			}, voxN, voxN);
+		}
+	}
+
+	if (outPath.empty()) bench.WriteJson(stdout);
+	else
+	{
+		FILE *fp = fopen(outPath.c_str(), "w");
+		if (!fp)
+		{
+			fprintf(stderr, "failed to open %s\n", outPath.c_str());
+			return 1;
+		}
+		bench.WriteJson(fp);
+		fclose(fp);
+	}
+	return nFail ? 1 : 0;
+}
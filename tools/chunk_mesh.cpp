@@ -0,0 +1,77 @@
+// chunk_mesh : converts a mesh into the out-of-core chunk file of TChunkedMesh (COMMON/tmeshchunked.h)
+//
+// usage : chunk_mesh mesh.obj out.tcm [-bits b] [-noreorder]
+//   -bits b      : 2^b vertices per chunk (default 16)
+//   -noreorder   : keep the vertex order of the input (otherwise Hilbert order, see TMesh::reorder)
+// the conversion itself loads the whole mesh; the chunk file is then used with a bounded page cache.
+
+#include "stdafx.h"
+#include "tmeshchunked.h"
+#include "tmeshreorder.h"
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage : chunk_mesh mesh.obj out.tcm [-bits b] [-noreorder]\n");
+		return 1;
+	}
+
+	int  bits     = 16;
+	bool bReorder = true;
+	for (int i = 3; i < argc; ++i)
+	{
+		const string a = argv[i];
+		if      (a == "-bits" && i + 1 < argc) bits = atoi(argv[++i]);
+		else if (a == "-noreorder") bReorder = false;
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (bits < 8 || 24 < bits)
+	{
+		fprintf(stderr, "-bits must be in [8, 24]\n");
+		return 1;
+	}
+
+	TMesh mesh;
+	auto t0 = std::chrono::steady_clock::now();
+	if (!mesh.initialize(argv[1]) || mesh.m_pSize == 0)
+	{
+		fprintf(stderr, "failed to load %s\n", argv[1]);
+		return 1;
+	}
+	printf("load    : %d vertices, %d faces, %.1f ms\n", mesh.m_vSize, mesh.m_pSize, elapsedMs(t0));
+
+	if (bReorder)
+	{
+		t0 = std::chrono::steady_clock::now();
+		mesh.reorder(VORDER_HILBERT, false);
+		printf("reorder : %.1f ms\n", elapsedMs(t0));
+	}
+
+	t0 = std::chrono::steady_clock::now();
+	if (!TChunkedMesh::Write(argv[2], mesh, bits))
+	{
+		fprintf(stderr, "failed to write %s\n", argv[2]);
+		return 1;
+	}
+	printf("write   : %d chunks of %d vertices, %.1f ms\n", (mesh.m_vSize + (1 << bits) - 1) >> bits, 1 << bits, elapsedMs(t0));
+	return 0;
+}
@@ -0,0 +1,211 @@
+// expmap_cli : exponential map of a mesh without GUI (batch jobs / profiling)
+//
+// usage : expmap_cli mesh.obj seeds.txt outPrefix [-scale s] [-binary] [-dijkstra] [-reorder] [-profile]
+//   seeds.txt  : one seed "x y z" per line ('#' : comment), moved to the closest point of the mesh
+//   outPrefix  : outPrefix_000.obj, outPrefix_001.obj, ... one file per seed
+//   -scale s   : texture coordinate = s * (exp map position) + (0.5, 0.5)  (default 0.03, as the viewer)
+//   -binary    : binary little endian PLY (x y z u v dist per vertex) instead of OBJ
+//   -dijkstra  : graph distance only (DijikstraMapping), u = v = 0.5
+//   -reorder   : reorder the mesh for memory locality after loading (TMesh::reorder),
+//                the output is written in the new order
+//   -profile   : print the scoped timers and counters at exit (build with -DSOV_PROFILE=ON)
+
+#include "stdafx.h"
+#include "expmap.h"
+#include "tmeshreorder.h"
+#include "tprofile.h"
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+
+
+static double elapsedMs(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+
+// closest point to p on triangle (a,b,c) (Ericson, Real-Time Collision Detection 5.1.5)
+static EVec3f closestPointOnTriangle(const EVec3f &p, const EVec3f &a, const EVec3f &b, const EVec3f &c)
+{
+	const EVec3f ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+
+	const EVec3f bp = p - b;
+	const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + d1 / (d1 - d3) * ab;
+
+	const EVec3f cp = p - c;
+	const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + d2 / (d2 - d6) * ac;
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+
+	const float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// closest point on the mesh, returns the face index (-1 if the mesh has no face)
+static int closestFace(const TMesh &mesh, const EVec3f &p, EVec3f &pos)
+{
+	int   best  = -1;
+	float bestD = FLT_MAX;
+	for (int i = 0; i < mesh.m_pSize; ++i)
+	{
+		const int   *idx = mesh.m_pPolys[i].idx;
+		const EVec3f q   = closestPointOnTriangle(p, mesh.m_vVerts[idx[0]], mesh.m_vVerts[idx[1]], mesh.m_vVerts[idx[2]]);
+		const float  d   = (q - p).squaredNorm();
+		if (d < bestD)
+		{
+			bestD = d;
+			best  = i;
+			pos   = q;
+		}
+	}
+	return best;
+}
+
+
+
+static bool loadSeeds(const char *fname, vector<EVec3f> &seeds)
+{
+	FILE *fp = fopen(fname, "r");
+	if (!fp) return false;
+
+	char buf[512];
+	while (fgets(buf, 511, fp))
+	{
+		if (buf[0] == '#') continue;
+		float x, y, z;
+		if (sscanf(buf, "%f %f %f", &x, &y, &z) == 3) seeds.push_back(EVec3f(x, y, z));
+	}
+	fclose(fp);
+	return true;
+}
+
+
+
+static bool exportPlyBinary(const char *fname, const TMesh &mesh, const vector<ExpMapVtx> &expMap)
+{
+	FILE *fp = fopen(fname, "wb");
+	if (!fp) return false;
+
+	fprintf(fp, "ply\nformat binary_little_endian 1.0\ncomment exported from expmap_cli\n");
+	fprintf(fp, "element vertex %d\n", mesh.m_vSize);
+	fprintf(fp, "property float x\nproperty float y\nproperty float z\n");
+	fprintf(fp, "property float u\nproperty float v\nproperty float dist\n");
+	fprintf(fp, "element face %d\n", mesh.m_pSize);
+	fprintf(fp, "property list uchar int vertex_indices\nend_header\n");
+
+	for (int i = 0; i < mesh.m_vSize; ++i)
+	{
+		const float d = (expMap[i].flg == 2) ? expMap[i].dist : -1.0f;
+		const float v[6] = { mesh.m_vVerts[i][0], mesh.m_vVerts[i][1], mesh.m_vVerts[i][2], mesh.m_vTexCd[i][0], mesh.m_vTexCd[i][1], d };
+		fwrite(v, sizeof(float), 6, fp);
+	}
+	for (int i = 0; i < mesh.m_pSize; ++i)
+	{
+		const unsigned char n = 3;
+		fwrite(&n, 1, 1, fp);
+		fwrite(mesh.m_pPolys[i].idx, sizeof(int), 3, fp);
+	}
+	fclose(fp);
+	return true;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage : expmap_cli mesh.obj seeds.txt outPrefix [-scale s] [-binary] [-dijkstra] [-reorder] [-profile]\n");
+		return 1;
+	}
+
+	float scale     = 0.03f;
+	bool  bBinary   = false;
+	bool  bDijkstra = false;
+	bool  bReorder  = false;
+	bool  bProfile  = false;
+	for (int i = 4; i < argc; ++i)
+	{
+		const string a = argv[i];
+		if      (a == "-scale" && i + 1 < argc) scale = (float)atof(argv[++i]);
+		else if (a == "-binary"  ) bBinary   = true;
+		else if (a == "-dijkstra") bDijkstra = true;
+		else if (a == "-reorder" ) bReorder  = true;
+		else if (a == "-profile" ) bProfile  = true;
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	TMesh mesh;
+	auto t0 = std::chrono::steady_clock::now();
+	if (!mesh.initialize(argv[1]) || mesh.m_pSize == 0)
+	{
+		fprintf(stderr, "failed to load %s\n", argv[1]);
+		return 1;
+	}
+	printf("load    : %d vertices, %d faces, %.1f ms\n", mesh.m_vSize, mesh.m_pSize, elapsedMs(t0));
+
+	if (bReorder)
+	{
+		t0 = std::chrono::steady_clock::now();
+		mesh.reorder();
+		printf("reorder : %.1f ms\n", elapsedMs(t0));
+	}
+
+	vector<EVec3f> seeds;
+	if (!loadSeeds(argv[2], seeds) || seeds.empty())
+	{
+		fprintf(stderr, "no seed in %s\n", argv[2]);
+		return 1;
+	}
+
+	vector<ExpMapVtx> expMap;
+	for (int k = 0; k < (int)seeds.size(); ++k)
+	{
+		EVec3f pos;
+		const int pIdx = closestFace(mesh, seeds[k], pos);
+
+		t0 = std::chrono::steady_clock::now();
+		if (bDijkstra) DijikstraMapping (mesh, pos, pIdx, expMap);
+		else           expnentialMapping(mesh, pos, pIdx, expMap);
+		const double t = elapsedMs(t0);
+
+		for (int i = 0; i < mesh.m_vSize; ++i)
+		{
+			const EVec2f uv = scale * expMap[i].pos + EVec2f(0.5f, 0.5f);
+			mesh.m_vTexCd[i] << uv[0], uv[1], 0;
+		}
+
+		char fname[1024];
+		sprintf(fname, "%s_%03d.%s", argv[3], k, bBinary ? "ply" : "obj");
+		const bool bOk = bBinary ? exportPlyBinary(fname, mesh, expMap) : mesh.exportObj(fname);
+		if (!bOk)
+		{
+			fprintf(stderr, "failed to write %s\n", fname);
+			return 1;
+		}
+		printf("seed %3d : face %d, %s %.1f ms -> %s\n", k, pIdx, bDijkstra ? "dijkstra" : "expmap", t, fname);
+	}
+
+	if (bProfile) TProfiler::get().Report(stdout);
+	return 0;
+}
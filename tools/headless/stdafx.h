@@ -0,0 +1,20 @@
+#pragma once
+
+// replacement of the MFC precompiled header (SimpleObjViewer/stdafx.h)
+// for the headless library build (CMakeLists.txt), where TMESH_NO_GL is defined
+
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif